@@ -0,0 +1,413 @@
+#include "AssetPack.h"
+#include "Hash.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include <zlib.h>
+
+namespace {
+	const char MAGIC[4] = { 'M', 'S', 'P', 'K' };
+	const uint32_t VERSION = 1;
+	const size_t ALIGNMENT = 16;
+
+	const uint32_t STORED = 0;
+	const uint32_t ZLIB = 1;
+
+	struct FileHeader {
+		char magic[4];
+		uint32_t version;
+		uint64_t tableOffset;
+		uint32_t entryCount;
+		uint32_t reserved;
+	};
+
+	/**
+	 * @brief A table of contents entry, followed in the file by its path relative to the packed directory.
+	 */
+	struct EntryHeader {
+		uint64_t offset;
+		uint64_t storedSize;
+		uint64_t size;
+		uint32_t compression;
+		uint32_t crc;
+		uint32_t pathLength;
+		uint32_t reserved;
+	};
+
+	/**
+	 * @brief A table of contents entry, and whether its checksum has been verified by an earlier read.
+	 */
+	struct PackedEntry {
+		EntryHeader header;
+		mutable std::atomic<bool> verified{ false };
+
+		explicit PackedEntry(const EntryHeader& header) : header(header) {}
+	};
+
+	/**
+	 * @brief A mapped pack file and its table of contents, keyed by generic relative path.
+	 */
+	struct MountedPack {
+		MappedFile file;
+		std::filesystem::path root;
+		// The pack file's last write time when it was mapped.
+		int64_t modifiedTime;
+		std::unordered_map<std::string, PackedEntry> entries;
+	};
+
+	// zlib takes lengths as uInt, which is 32 bits even where size_t is not, so larger buffers are fed in pieces.
+	const size_t ZLIB_CHUNK = size_t(1) << 30;
+
+	uint32_t checksum(const uint8_t* data, size_t size) {
+		uLong crc = crc32(0, nullptr, 0);
+		for (size_t done = 0; done < size;) {
+			uInt length = static_cast<uInt>(std::min(size - done, ZLIB_CHUNK));
+			crc = crc32(crc, data + done, length);
+			done += length;
+		}
+		return static_cast<uint32_t>(crc);
+	}
+
+	/**
+	 * @brief Inflates a zlib stream into a buffer of exactly its uncompressed size.
+	 * @return false if the stream is corrupt or does not fill the buffer exactly.
+	 */
+	bool inflateEntry(const uint8_t* stored, size_t storedSize, uint8_t* out, size_t size) {
+		z_stream stream{};
+		if (inflateInit(&stream) != Z_OK) {
+			return false;
+		}
+		size_t consumed = 0;
+		size_t produced = 0;
+		int result = Z_OK;
+		while (result == Z_OK) {
+			stream.next_in = const_cast<Bytef*>(stored + consumed);
+			stream.avail_in = static_cast<uInt>(std::min(storedSize - consumed, ZLIB_CHUNK));
+			stream.next_out = out + produced;
+			stream.avail_out = static_cast<uInt>(std::min(size - produced, ZLIB_CHUNK));
+			uInt inputBefore = stream.avail_in;
+			uInt outputBefore = stream.avail_out;
+			result = inflate(&stream, Z_NO_FLUSH);
+			consumed += inputBefore - stream.avail_in;
+			produced += outputBefore - stream.avail_out;
+		}
+		inflateEnd(&stream);
+		return result == Z_STREAM_END && produced == size;
+	}
+
+	/**
+	 * @brief Deflates data into out, giving up once the output would reach limit bytes.
+	 * @return false if the data does not compress to fewer than limit bytes.
+	 */
+	bool deflateEntry(const uint8_t* data, size_t size, size_t limit, std::vector<uint8_t>& out) {
+		z_stream stream{};
+		if (deflateInit(&stream, Z_BEST_COMPRESSION) != Z_OK) {
+			return false;
+		}
+		out.resize(limit);
+		size_t consumed = 0;
+		size_t produced = 0;
+		int result = Z_OK;
+		while (result == Z_OK && produced < limit) {
+			stream.next_in = const_cast<Bytef*>(data + consumed);
+			stream.avail_in = static_cast<uInt>(std::min(size - consumed, ZLIB_CHUNK));
+			stream.next_out = out.data() + produced;
+			stream.avail_out = static_cast<uInt>(std::min(limit - produced, ZLIB_CHUNK));
+			bool last = consumed + stream.avail_in == size;
+			uInt inputBefore = stream.avail_in;
+			uInt outputBefore = stream.avail_out;
+			result = deflate(&stream, last ? Z_FINISH : Z_NO_FLUSH);
+			consumed += inputBefore - stream.avail_in;
+			produced += outputBefore - stream.avail_out;
+		}
+		deflateEnd(&stream);
+		if (result != Z_STREAM_END || produced >= limit) {
+			return false;
+		}
+		out.resize(produced);
+		return true;
+	}
+
+	std::mutex mountMutex;
+	std::shared_ptr<const MountedPack> mounted;
+
+	/**
+	 * @brief Bytes added with addMemory. Their owner keeps the storage alive; once it is gone, so is the entry.
+	 */
+	struct MemoryEntry {
+		const uint8_t* data;
+		size_t size;
+		std::weak_ptr<const void> storage;
+	};
+
+	// Keyed by normalized generic path.
+	std::mutex memoryMutex;
+	std::unordered_map<std::string, MemoryEntry> memoryEntries;
+
+	std::shared_ptr<const MountedPack> currentPack() {
+		std::lock_guard<std::mutex> lock(mountMutex);
+		return mounted;
+	}
+
+	/**
+	 * @brief The path's absolute, normalized form. Unlike canonical paths this needs no filesystem access,
+	 * so looking up packed assets never touches the packed directory.
+	 */
+	std::filesystem::path normalized(const std::filesystem::path& path) {
+		std::error_code error;
+		auto absolute = std::filesystem::absolute(path, error);
+		return (error ? path : absolute).lexically_normal();
+	}
+
+	/**
+	 * @brief The bytes added under a path, if their owner is still alive. Entries whose owner is gone are
+	 * dropped. The caller must hold memoryMutex.
+	 */
+	std::optional<AssetBytes> findMemory(const std::filesystem::path& path) {
+		if (memoryEntries.empty()) {
+			return std::nullopt;
+		}
+		auto entry = memoryEntries.find(normalized(path).generic_string());
+		if (entry == memoryEntries.end()) {
+			return std::nullopt;
+		}
+		auto storage = entry->second.storage.lock();
+		if (storage == nullptr) {
+			memoryEntries.erase(entry);
+			return std::nullopt;
+		}
+		return AssetBytes{ entry->second.data, entry->second.size, std::move(storage) };
+	}
+
+	/**
+	 * @brief The pack entry for a path, if the path is inside the pack's root and the pack has it.
+	 */
+	const PackedEntry* findEntry(const MountedPack& pack, const std::filesystem::path& path) {
+		auto relative = normalized(path).lexically_relative(pack.root);
+		if (relative.empty() || *relative.begin() == "..") {
+			return nullptr;
+		}
+		auto entry = pack.entries.find(relative.generic_string());
+		return entry == pack.entries.end() ? nullptr : &entry->second;
+	}
+}
+
+bool AssetPack::mount(const std::string& packPath, const std::filesystem::path& root) {
+	auto pack = std::make_shared<MountedPack>();
+	if (!pack->file.open(packPath) || pack->file.size() < sizeof(FileHeader)) {
+		return false;
+	}
+	FileHeader header;
+	std::memcpy(&header, pack->file.data(), sizeof(header));
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION) {
+		std::cerr << "Ignoring " << packPath << ": not a version " << VERSION << " asset pack" << std::endl;
+		return false;
+	}
+
+	size_t position = header.tableOffset;
+	for (uint32_t i = 0; i < header.entryCount; i++) {
+		EntryHeader entry;
+		if (position > pack->file.size() || pack->file.size() - position < sizeof(entry)) {
+			std::cerr << "Ignoring " << packPath << ": truncated table of contents" << std::endl;
+			return false;
+		}
+		std::memcpy(&entry, pack->file.data() + position, sizeof(entry));
+		position += sizeof(entry);
+		if (pack->file.size() - position < entry.pathLength || entry.offset > pack->file.size()
+			|| pack->file.size() - entry.offset < entry.storedSize) {
+			std::cerr << "Ignoring " << packPath << ": entry out of bounds" << std::endl;
+			return false;
+		}
+		std::string path(reinterpret_cast<const char*>(pack->file.data() + position), entry.pathLength);
+		position += entry.pathLength;
+		pack->entries.emplace(std::piecewise_construct, std::forward_as_tuple(std::move(path)), std::forward_as_tuple(entry));
+	}
+	pack->root = normalized(root);
+	std::error_code error;
+	auto time = std::filesystem::last_write_time(packPath, error);
+	pack->modifiedTime = error ? -1 : static_cast<int64_t>(time.time_since_epoch().count());
+
+	std::cout << "Mounted " << packPath << " (" << pack->entries.size() << " entries) over " << root << std::endl;
+	std::lock_guard<std::mutex> lock(mountMutex);
+	mounted = std::move(pack);
+	return true;
+}
+
+void AssetPack::unmount() {
+	std::lock_guard<std::mutex> lock(mountMutex);
+	mounted = nullptr;
+}
+
+void AssetPack::addMemory(const std::filesystem::path& path, const AssetBytes& bytes) {
+	std::lock_guard<std::mutex> lock(memoryMutex);
+	for (auto it = memoryEntries.begin(); it != memoryEntries.end();) {
+		if (it->second.storage.expired()) {
+			it = memoryEntries.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+	memoryEntries[normalized(path).generic_string()] = MemoryEntry{ bytes.data, bytes.size, bytes.storage };
+}
+
+void AssetPack::removeMemory(const std::filesystem::path& path) {
+	std::lock_guard<std::mutex> lock(memoryMutex);
+	memoryEntries.erase(normalized(path).generic_string());
+}
+
+bool AssetPack::contains(const std::filesystem::path& path) {
+	{
+		std::lock_guard<std::mutex> lock(memoryMutex);
+		if (findMemory(path)) {
+			return true;
+		}
+	}
+	auto pack = currentPack();
+	return pack != nullptr && findEntry(*pack, path) != nullptr;
+}
+
+std::optional<PackedEntryState> AssetPack::packedState(const std::filesystem::path& path) {
+	{
+		std::lock_guard<std::mutex> lock(memoryMutex);
+		if (findMemory(path)) {
+			return std::nullopt;
+		}
+	}
+	auto pack = currentPack();
+	const PackedEntry* packed = pack == nullptr ? nullptr : findEntry(*pack, path);
+	if (packed == nullptr) {
+		return std::nullopt;
+	}
+	uint64_t stamp = fnv1a64(&pack->modifiedTime, sizeof(pack->modifiedTime));
+	stamp = fnv1a64(&packed->header.offset, sizeof(packed->header.offset), stamp);
+	stamp = fnv1a64(&packed->header.crc, sizeof(packed->header.crc), stamp);
+	return PackedEntryState{ packed->header.size, stamp };
+}
+
+std::optional<AssetBytes> AssetPack::open(const std::filesystem::path& path) {
+	{
+		std::lock_guard<std::mutex> lock(memoryMutex);
+		auto memory = findMemory(path);
+		if (memory) {
+			return memory;
+		}
+	}
+	auto pack = currentPack();
+	const PackedEntry* packed = pack == nullptr ? nullptr : findEntry(*pack, path);
+	if (packed == nullptr) {
+		auto file = std::make_shared<MappedFile>();
+		if (!file->open(path.string())) {
+			return std::nullopt;
+		}
+		return AssetBytes{ file->data(), file->size(), file };
+	}
+
+	const EntryHeader* entry = &packed->header;
+	const uint8_t* stored = pack->file.data() + entry->offset;
+	AssetBytes asset;
+	if (entry->compression == STORED && entry->storedSize == entry->size) {
+		// Raw entries are served from the mapping, which the asset keeps alive past an unmount.
+		asset = AssetBytes{ stored, entry->size, pack };
+	}
+	else if (entry->compression == ZLIB) {
+		auto inflated = std::make_shared<std::vector<uint8_t>>(entry->size);
+		if (!inflateEntry(stored, entry->storedSize, inflated->data(), inflated->size())) {
+			std::cerr << "Corrupt asset pack entry " << path << std::endl;
+			return std::nullopt;
+		}
+		asset = AssetBytes{ inflated->data(), inflated->size(), inflated };
+	}
+	else {
+		std::cerr << "Unknown compression for asset pack entry " << path << std::endl;
+		return std::nullopt;
+	}
+
+	// Each entry is checked once, on its first read, so mounting and later reads never scan the pack.
+	if (!packed->verified.load(std::memory_order_relaxed)) {
+		if (checksum(asset.data, asset.size) != entry->crc) {
+			std::cerr << "Checksum mismatch for asset pack entry " << path << std::endl;
+			return std::nullopt;
+		}
+		packed->verified.store(true, std::memory_order_relaxed);
+	}
+	return asset;
+}
+
+void AssetPack::build(const std::filesystem::path& directory, const std::string& packPath) {
+	// Entries are sorted by path, so the files of one model sit next to each other in the pack.
+	std::vector<std::filesystem::path> files;
+	for (auto& item : std::filesystem::recursive_directory_iterator(directory)) {
+		if (item.is_regular_file()) {
+			files.push_back(item.path());
+		}
+	}
+	std::sort(files.begin(), files.end());
+
+	std::ofstream out(packPath, std::ios::binary | std::ios::trunc);
+	if (!out) {
+		throw std::runtime_error("Could not create asset pack " + packPath);
+	}
+	FileHeader header{};
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.entryCount = static_cast<uint32_t>(files.size());
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	std::vector<std::pair<std::string, EntryHeader>> table;
+	uint64_t position = sizeof(header);
+	uint64_t totalSize = 0;
+	for (auto& path : files) {
+		MappedFile source;
+		if (!source.open(path.string())) {
+			throw std::runtime_error("Could not read " + path.string());
+		}
+		EntryHeader entry{};
+		entry.size = source.size();
+		entry.crc = checksum(source.data(), source.size());
+
+		// Compress each entry on its own, keeping the compressed form only if it saves at least an eighth.
+		std::vector<uint8_t> compressed;
+		const uint8_t* data = source.data();
+		entry.storedSize = entry.size;
+		entry.compression = STORED;
+		if (source.size() > 0 && deflateEntry(source.data(), source.size(), entry.size - entry.size / 8, compressed)) {
+			data = compressed.data();
+			entry.storedSize = compressed.size();
+			entry.compression = ZLIB;
+		}
+
+		uint64_t padding = (ALIGNMENT - position % ALIGNMENT) % ALIGNMENT;
+		const char zeros[ALIGNMENT] = {};
+		out.write(zeros, padding);
+		entry.offset = position + padding;
+		out.write(reinterpret_cast<const char*>(data), entry.storedSize);
+		position = entry.offset + entry.storedSize;
+		totalSize += entry.size;
+
+		auto relative = path.lexically_relative(directory).generic_string();
+		entry.pathLength = static_cast<uint32_t>(relative.size());
+		table.push_back({ relative, entry });
+	}
+
+	header.tableOffset = position;
+	for (auto& item : table) {
+		out.write(reinterpret_cast<const char*>(&item.second), sizeof(item.second));
+		out.write(item.first.data(), item.first.size());
+	}
+	out.seekp(0);
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	if (!out) {
+		throw std::runtime_error("Could not write asset pack " + packPath);
+	}
+	std::cout << "Packed " << files.size() << " files (" << totalSize << " bytes) from " << directory << " into "
+		<< packPath << " (" << header.tableOffset << " bytes of data)" << std::endl;
+}
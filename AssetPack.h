@@ -0,0 +1,88 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+
+/**
+ * @brief The contents of an asset file. The bytes stay valid as long as the AssetBytes, or a copy of
+ * it, is alive.
+ */
+struct AssetBytes {
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+	std::shared_ptr<const void> storage;
+};
+
+/**
+ * @brief What can be learned about a pack entry without reading it: its size, and a stamp that
+ * changes whenever the entry may have.
+ */
+struct PackedEntryState {
+	uint64_t size;
+	uint64_t stamp;
+};
+
+/**
+ * @brief A single-file archive of a directory of assets, with a table of contents for random access
+ * to any entry. Each entry is stored zlib-compressed, or raw when compression does not pay off, as
+ * it does not for PNG and JPEG images.
+ *
+ * Mounting a pack over a directory makes open() serve any path inside that directory from the pack,
+ * so loaders keep using their usual paths. The pack file is mapped once, and uncompressed entries
+ * are read straight out of the mapping. Bytes that are already in memory, such as textures embedded
+ * in a model file, can be served under virtual paths the same way.
+ */
+class AssetPack {
+public:
+	/**
+	 * @brief Mounts the pack file so that it serves paths under the given directory, replacing any
+	 * pack that was mounted before.
+	 * @return false if the file is missing or is not a valid pack.
+	 */
+	static bool mount(const std::string& packPath, const std::filesystem::path& root);
+
+	/**
+	 * @brief Unmounts the current pack. Assets already read from it stay valid.
+	 */
+	static void unmount();
+
+	/**
+	 * @brief Serves the bytes under the given virtual path, replacing any bytes added under it before,
+	 * for as long as their owner keeps the bytes' storage alive. The pack holds no reference to the
+	 * storage itself, so the bytes are freed with the model they belong to.
+	 */
+	static void addMemory(const std::filesystem::path& path, const AssetBytes& bytes);
+
+	/**
+	 * @brief Stops serving the bytes added under the given virtual path, if any.
+	 */
+	static void removeMemory(const std::filesystem::path& path);
+
+	/**
+	 * @brief True if the mounted pack has an entry for the path, or bytes were added under it.
+	 */
+	static bool contains(const std::filesystem::path& path);
+
+	/**
+	 * @brief The state of the mounted pack's entry for a path, from its table of contents alone. The
+	 * stamp combines the pack file's last write time when it was mounted with the entry's offset and
+	 * checksum, so it changes whenever the pack is rebuilt with a different entry.
+	 * @return nullopt if the path is served from memory, or is not in the mounted pack.
+	 */
+	static std::optional<PackedEntryState> packedState(const std::filesystem::path& path);
+
+	/**
+	 * @brief Reads an asset from memory, then the mounted pack, or maps it from disk if neither has it.
+	 * @return nullopt if the asset is in none of those places, or its pack entry is corrupt.
+	 */
+	static std::optional<AssetBytes> open(const std::filesystem::path& path);
+
+	/**
+	 * @brief Packs every file under the given directory into a new pack file.
+	 * @throws std::runtime_error if a file cannot be read or the pack cannot be written.
+	 */
+	static void build(const std::filesystem::path& directory, const std::string& packPath);
+};
@@ -0,0 +1,25 @@
+/**
+Packs a directory of assets into a single asset pack file, which the renderer mounts over the
+directory at startup.
+
+Usage: asset_packer <directory> <pack file>
+*/
+
+#include "AssetPack.h"
+#include <iostream>
+#include <stdexcept>
+
+int main(int argc, char* argv[]) {
+	if (argc != 3) {
+		std::cerr << "Usage: " << argv[0] << " <directory> <pack file>" << std::endl;
+		return 1;
+	}
+	try {
+		AssetPack::build(argv[1], argv[2]);
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
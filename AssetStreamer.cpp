@@ -0,0 +1,182 @@
+#include "AssetStreamer.h"
+#include "AssetPack.h"
+#include "AssimpImport.h"
+#include "ModelRegistry.h"
+#include "TextureCache.h"
+#include "TextureLoader.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <iostream>
+#include <optional>
+#include <unordered_map>
+
+AssetStreamer::AssetStreamer(const std::string& placeholderPath)
+	: m_placeholderPath(placeholderPath), m_start(std::chrono::steady_clock::now()), m_sharedTextures(0), m_savedBytes(0),
+	m_reportedFinish(true) {
+}
+
+const std::shared_ptr<TextureHandle>& AssetStreamer::placeholder() {
+	if (m_placeholder == nullptr) {
+		StbImage image;
+		image.loadFromFile(m_placeholderPath);
+		m_placeholder = std::make_shared<TextureHandle>(Texture::uploadImage(image), Texture::imageBytes(image));
+	}
+	return m_placeholder;
+}
+
+Object3D AssetStreamer::load(const std::string& path, bool flipTextureCoords, ImportProfile profile,
+	const HierarchyOptions& hierarchy, float weldEpsilon) {
+	// Instances of a model that is already registered share its geometry. A model is registered once
+	// it has finished streaming in, since its uploads are dropped if this streamer is destroyed first.
+	uint64_t options = assimpImportFlags(flipTextureCoords, profile) | (uint64_t(hierarchy.registryKey()) << 32);
+	auto instance = ModelRegistry::find(path, options, weldEpsilon);
+	if (instance) {
+		return std::move(*instance);
+	}
+	ImportedModel imported = assimpImport(path, flipTextureCoords, profile, true, weldEpsilon);
+	simplifyHierarchy(imported, hierarchy);
+	auto uploads = std::make_shared<char>();
+	Object3D model = queue(imported, uploads);
+	m_registrations.push_back({ path, options, weldEpsilon, model, uploads });
+	return model;
+}
+
+Object3D AssetStreamer::load(const ImportedModel& imported) {
+	return queue(imported, nullptr);
+}
+
+Object3D AssetStreamer::queue(const ImportedModel& imported, const std::shared_ptr<const void>& uploads) {
+	auto start = std::chrono::steady_clock::now();
+	if (isFinished()) {
+		m_start = start;
+		m_sharedTextures = 0;
+		m_savedBytes = 0;
+	}
+	m_reportedFinish = false;
+
+	// Every texture path gets its own handle per usage, bound to the placeholder until its pixels are
+	// decoded. The handle goes into the TextureCache right away, so other models share it while it streams.
+	std::unordered_map<std::filesystem::path, std::shared_ptr<TextureHandle>, PathHash> handles;
+	ThreadPool& pool = ThreadPool::shared();
+	BlockFormatSupport support = Texture::blockFormatSupport();
+	auto handleFor = [&](const TextureRef& ref) {
+		auto key = loadedTextureKey(ref);
+		auto existing = handles.find(key);
+		if (existing != handles.end()) {
+			return existing->second;
+		}
+		const std::string& path = ref.path;
+		TextureUsage usage = textureUsage(ref.samplerName);
+		auto handle = TextureCache::find(path, usage);
+		if (handle != nullptr) {
+			// A texture another model queued here is one of this model's uploads too.
+			auto pending = std::find_if(m_textures.begin(), m_textures.end(),
+				[&](const PendingTexture& texture) { return texture.handle == handle; });
+			if (pending != m_textures.end()) {
+				pending->models.push_back(uploads);
+			}
+			handles.insert(std::make_pair(key, handle));
+			return handle;
+		}
+		handle = std::make_shared<TextureHandle>();
+		handle->placeholder = placeholder();
+		handles.insert(std::make_pair(key, handle));
+		TextureCache::insert(path, usage, handle);
+		// The task holds the model's storage until it has opened the file, which may be embedded in it.
+		m_textures.push_back({ handle, usage, pool.submit([path, usage, support, storage = imported.storage]() {
+			auto file = AssetPack::open(path);
+			uint64_t fileHash = file ? fileContentHash(file->data, file->size) : 0;
+			GpuTexture texture = prepareTexture(path, file, fileHash, usage, support);
+			uint64_t pixelHash = textureContentHash(texture);
+			return std::make_pair(std::move(texture), pixelHash);
+		}), { uploads } });
+		return handle;
+	};
+
+	// Nodes that reference the same mesh share one streamed geometry.
+	std::vector<std::optional<Mesh3D>> built(imported.model.meshes.size());
+	Object3D root = buildHierarchy(imported.model, 0, [&](uint32_t meshIndex) {
+		if (built[meshIndex]) {
+			return *built[meshIndex];
+		}
+		const MeshView& mesh = imported.model.meshes[meshIndex];
+		std::vector<Texture> textures;
+		for (auto& ref : mesh.textures) {
+			textures.push_back(Texture{ handleFor(ref), ref.samplerName });
+		}
+		auto geometry = std::make_shared<MeshGeometry>();
+		m_meshes.push_back({ geometry, mesh, imported.storage, uploads });
+		built[meshIndex].emplace(geometry, std::move(textures));
+		return *built[meshIndex];
+	});
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	std::cout << "Built streaming hierarchy in " << elapsed.count() << " ms; " << m_meshes.size()
+		<< " meshes and " << m_textures.size() << " textures queued" << std::endl;
+	return root;
+}
+
+void AssetStreamer::update(std::chrono::microseconds budget) {
+	auto deadline = std::chrono::steady_clock::now() + budget;
+
+	// Textures are swapped in as soon as a worker has decoded them, in whatever order they finish.
+	for (auto it = m_textures.begin(); it != m_textures.end() && std::chrono::steady_clock::now() < deadline;) {
+		if (it->image.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+			auto decoded = it->image.get();
+			const GpuTexture& texture = decoded.first;
+			auto identical = !texture.valid() ? nullptr : TextureCache::findContent(decoded.second, it->usage);
+			if (identical != nullptr) {
+				it->handle->placeholder = identical;
+				m_sharedTextures++;
+				m_savedBytes += identical->bytes;
+			}
+			else {
+				it->handle->id = Texture::uploadTexture(texture);
+				it->handle->bytes = Texture::textureBytes(texture);
+				it->handle->twoChannel = Texture::isTwoChannel(texture);
+				it->handle->placeholder = nullptr;
+				if (texture.valid()) {
+					TextureCache::insertContent(decoded.second, it->usage, it->handle);
+				}
+			}
+			it = m_textures.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+
+	bool uploadedAny = false;
+	while (!m_meshes.empty() && (!uploadedAny || std::chrono::steady_clock::now() < deadline)) {
+		PendingMesh& pending = m_meshes.front();
+		pending.geometry->upload(pending.mesh.vertices, pending.mesh.vertexCount,
+			pending.mesh.faces, pending.mesh.faceCount, pending.mesh.lods, pending.mesh.meshlets);
+		m_meshes.pop_front();
+		uploadedAny = true;
+	}
+
+	// Models whose last upload is done are complete, and safe to share.
+	for (auto it = m_registrations.begin(); it != m_registrations.end();) {
+		if (it->uploads.expired()) {
+			ModelRegistry::insert(it->path, it->importFlags, it->prototype, it->weldEpsilon);
+			it = m_registrations.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+
+	if (isFinished() && !m_reportedFinish) {
+		m_reportedFinish = true;
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - m_start;
+		std::cout << "Finished streaming assets in " << elapsed.count() << " ms" << std::endl;
+		if (m_sharedTextures > 0) {
+			std::cout << "Shared " << m_sharedTextures << " textures with identical images, saving "
+				<< m_savedBytes / (1024.0 * 1024.0) << " MB of VRAM" << std::endl;
+		}
+	}
+}
+
+bool AssetStreamer::isFinished() const {
+	return m_meshes.empty() && m_textures.empty();
+}
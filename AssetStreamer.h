@@ -0,0 +1,109 @@
+#pragma once
+#include <chrono>
+#include <deque>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include "AssimpImport.h"
+#include "ModelData.h"
+#include "Object3D.h"
+#include "Texture.h"
+
+/**
+ * @brief Loads models in streaming mode: load() returns a model's full Object3D hierarchy right away,
+ * and the model's meshes and textures are sent to the GPU over later calls to update(). Until a
+ * texture's pixels arrive, its meshes are drawn with a placeholder texture; meshes whose geometry
+ * has not been uploaded yet draw nothing. A decoded image whose pixels match a resident texture is
+ * not uploaded again: its handle keeps the resident texture as its placeholder for good.
+ * Models loaded by path are registered with the ModelRegistry only once all their uploads are done,
+ * so a streamer destroyed with uploads still queued never leaves the registry a model that draws nothing.
+ */
+class AssetStreamer {
+private:
+	/**
+	 * @brief A mesh whose geometry is waiting to be uploaded, and the model storage it points into.
+	 */
+	struct PendingMesh {
+		std::shared_ptr<MeshGeometry> geometry;
+		MeshView mesh;
+		std::shared_ptr<const void> storage;
+		// The uploads token of the model it belongs to (see PendingRegistration).
+		std::shared_ptr<const void> model;
+	};
+
+	/**
+	 * @brief A texture being prepared on the ThreadPool (see prepareTexture) for the given usage, and
+	 * the handle its meshes are bound to.
+	 */
+	struct PendingTexture {
+		std::shared_ptr<TextureHandle> handle;
+		TextureUsage usage;
+		std::future<std::pair<GpuTexture, uint64_t>> image;
+		// The uploads tokens of every model bound to it.
+		std::vector<std::shared_ptr<const void>> models;
+	};
+
+	/**
+	 * @brief A model to register with the ModelRegistry once each of its queued uploads, which
+	 * share ownership of its uploads token, is done and has let the token go.
+	 */
+	struct PendingRegistration {
+		std::string path;
+		uint64_t importFlags;
+		float weldEpsilon;
+		Object3D prototype;
+		std::weak_ptr<const void> uploads;
+	};
+
+	std::deque<PendingMesh> m_meshes;
+	std::vector<PendingTexture> m_textures;
+	std::vector<PendingRegistration> m_registrations;
+	std::shared_ptr<TextureHandle> m_placeholder;
+	std::string m_placeholderPath;
+	std::chrono::steady_clock::time_point m_start;
+	// Textures that turned out identical to a resident one, and the VRAM sharing it saved.
+	size_t m_sharedTextures;
+	size_t m_savedBytes;
+	bool m_reportedFinish;
+
+	const std::shared_ptr<TextureHandle>& placeholder();
+
+	/**
+	 * @brief Builds the hierarchy of an imported model and queues its uploads, each of which holds
+	 * the given uploads token, if any, until it is done.
+	 */
+	Object3D queue(const ImportedModel& imported, const std::shared_ptr<const void>& uploads);
+
+public:
+	/**
+	 * @brief Constructs a streamer that binds the image at the given path in place of textures that
+	 * have not finished loading.
+	 */
+	explicit AssetStreamer(const std::string& placeholderPath = "../models/missing_texture-sml.png");
+
+	/**
+	 * @brief Builds the hierarchy of a model imported with Assimp under the given profile and weld
+	 * epsilon (see assimpLoad), queueing its meshes and textures to be streamed in by update().
+	 */
+	Object3D load(const std::string& path, bool flipTextureCoords, ImportProfile profile = ImportProfile::MaxQuality,
+		const HierarchyOptions& hierarchy = {}, float weldEpsilon = 0);
+
+	/**
+	 * @brief Builds the hierarchy of an already-imported model, queueing its meshes and textures.
+	 */
+	Object3D load(const ImportedModel& imported);
+
+	/**
+	 * @brief Uploads decoded textures and pending meshes until the time budget is spent, and registers
+	 * the models whose uploads are all done. Must be called on the thread that owns the OpenGL
+	 * context, typically once per frame. At least one mesh is uploaded per call, so streaming always
+	 * makes progress.
+	 */
+	void update(std::chrono::microseconds budget);
+
+	/**
+	 * @brief True once every queued mesh and texture is on the GPU.
+	 */
+	bool isFinished() const;
+};
@@ -1,22 +1,41 @@
 #include "AssimpImport.h"
+#include "MappedIOSystem.h"
+#include "MaterialPacker.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "ModelRegistry.h"
+#include "TextureLoader.h"
+#include "ThreadPool.h"
+#include <cctype>
+#include <chrono>
 #include <iostream>
+#include <assimp/DefaultLogger.hpp>
 #include <assimp/Importer.hpp>
+#include <assimp/LogStream.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include <filesystem>
+#include <optional>
 #include <unordered_map>
 #include <algorithm>
 
 const size_t FLOATS_PER_VERTEX = 3;
 const size_t VERTICES_PER_FACE = 3;
 
-std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, const std::string& typeName, const std::filesystem::path& modelPath,
-	std::unordered_map<std::filesystem::path, Texture, PathHash>& loadedTextures) {
-	std::vector<Texture> textures;
+std::vector<TextureRef> loadMaterialTextures(aiMaterial* mat, aiTextureType type, const std::string& typeName,
+	const std::filesystem::path& modelPath, const aiScene* scene) {
+	std::vector<TextureRef> textures;
 	for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
 	{
 		aiString name;
 		mat->GetTexture(type, i, &name);
+		// Textures embedded in the model file are named "*index", or by the file they came from.
+		const aiTexture* embedded = scene == nullptr ? nullptr : scene->GetEmbeddedTexture(name.C_Str());
+		if (embedded != nullptr) {
+			auto index = std::find(scene->mTextures, scene->mTextures + scene->mNumTextures, embedded) - scene->mTextures;
+			textures.push_back({ embeddedTexturePath(modelPath, static_cast<uint32_t>(index)), typeName });
+			continue;
+		}
         std::string correctedPath = name.C_Str();
         std::replace(correctedPath.begin(), correctedPath.end(), '\\', '/');
 
@@ -35,24 +54,13 @@ std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, c
         }
 
         std::filesystem::path texPath = modelPath.parent_path() / correctedPath;
-
-		auto existing = loadedTextures.find(texPath);
-		if (existing != loadedTextures.end()) {
-			textures.push_back(existing->second);
-		}
-		else {
-			StbImage image;
-			image.loadFromFile(texPath.string());
-			Texture tex = Texture::loadImage(image, typeName);
-			textures.push_back(tex);
-			loadedTextures.insert(std::make_pair(texPath, tex));
-		}
+		textures.push_back({ texPath.string(), typeName });
 	}
 	return textures;
 }
 
-Mesh3D fromAssimpMesh(const aiMesh* mesh, const aiScene* scene, const std::filesystem::path& modelPath,
-	std::unordered_map<std::filesystem::path, Texture,PathHash>& loadedTextures) {
+MeshData fromAssimpMesh(const aiMesh* mesh, const aiScene* scene, const std::filesystem::path& modelPath,
+	float weldEpsilon, WeldStats* weld) {
 	std::vector<Vertex3D> vertices;
 
 	for (size_t i = 0; i < mesh->mNumVertices; i++) {
@@ -77,109 +85,360 @@ Mesh3D fromAssimpMesh(const aiMesh* mesh, const aiScene* scene, const std::files
 		faces.push_back(mesh->mFaces[i].mIndices[2]);
 	}
 
-	std::vector<Texture> textures = {};
+	std::vector<TextureRef> textures = {};
 	if (mesh->mMaterialIndex >= 0)
 	{
 		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-		std::vector<Texture> diffuseMaps = loadMaterialTextures(material,
-			aiTextureType_DIFFUSE, "baseTexture", modelPath, loadedTextures);
+		std::vector<TextureRef> diffuseMaps = loadMaterialTextures(material,
+			aiTextureType_DIFFUSE, "baseTexture", modelPath, scene);
 		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-		std::vector<Texture> specularMaps = loadMaterialTextures(material,
-			aiTextureType_SPECULAR, "specMap", modelPath, loadedTextures);
+		std::vector<TextureRef> specularMaps = loadMaterialTextures(material,
+			aiTextureType_SPECULAR, "specMap", modelPath, scene);
 		textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-		std::vector<Texture> normalMaps = loadMaterialTextures(material,
-			aiTextureType_HEIGHT, "normalMap", modelPath, loadedTextures);
+		std::vector<TextureRef> normalMaps = loadMaterialTextures(material,
+			aiTextureType_HEIGHT, "normalMap", modelPath, scene);
 		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
 		normalMaps = loadMaterialTextures(material,
-			aiTextureType_NORMALS, "normalMap", modelPath, loadedTextures);
+			aiTextureType_NORMALS, "normalMap", modelPath, scene);
 		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+		// Single-channel PBR maps, which packMaterialMaps folds into the specular map's texture.
+		std::vector<TextureRef> roughnessMaps = loadMaterialTextures(material,
+			aiTextureType_DIFFUSE_ROUGHNESS, "roughnessMap", modelPath, scene);
+		textures.insert(textures.end(), roughnessMaps.begin(), roughnessMaps.end());
+		std::vector<TextureRef> metallicMaps = loadMaterialTextures(material,
+			aiTextureType_METALNESS, "metallicMap", modelPath, scene);
+		textures.insert(textures.end(), metallicMaps.begin(), metallicMaps.end());
 	}
 
-	auto m = Mesh3D(std::move(vertices), std::move(faces), std::move(textures));
-	return m;
+	// Assimp only joins vertices when asked to, and never ones whose normals or coordinates were
+	// dropped above; welding here catches both before the mesh is uploaded.
+	MeshData data{ std::move(vertices), std::move(faces), std::move(textures) };
+	WeldStats stats = weldVertices(data, weldEpsilon);
+	if (weld) { *weld = stats; }
+	return data;
 }
 
 
 
-Object3D assimpLoad(const std::string& path, bool flipTextureCoords) {
-	Assimp::Importer importer;
+namespace {
+	/**
+	 * @brief Copies an embedded texture out of its scene as an image file. Compressed images (PNG,
+	 * JPEG, and so on) are copied as they are; raw texels get a TGA header, since aiTexel's blue,
+	 * green, red, alpha order is TGA's own, so both load like any other texture file.
+	 * @return nullopt for raw textures wider or taller than TGA allows.
+	 */
+	std::optional<AssetBytes> copyEmbeddedTexture(const aiTexture* texture) {
+		auto bytes = std::make_shared<std::vector<uint8_t>>();
+		auto data = reinterpret_cast<const uint8_t*>(texture->pcData);
+		if (texture->mHeight == 0) {
+			bytes->assign(data, data + texture->mWidth);
+		}
+		else {
+			if (texture->mWidth > 0xffff || texture->mHeight > 0xffff) {
+				return std::nullopt;
+			}
+			// Uncompressed true-colour, 32 bits per pixel, 8 of them alpha, with the origin at the top left.
+			uint8_t header[18] = {};
+			header[2] = 2;
+			header[12] = texture->mWidth & 0xff;
+			header[13] = texture->mWidth >> 8;
+			header[14] = texture->mHeight & 0xff;
+			header[15] = texture->mHeight >> 8;
+			header[16] = 32;
+			header[17] = 0x28;
+			bytes->assign(header, header + sizeof(header));
+			bytes->insert(bytes->end(), data, data + size_t(texture->mWidth) * texture->mHeight * sizeof(aiTexel));
+		}
+		return AssetBytes{ bytes->data(), bytes->size(), bytes };
+	}
 
-	auto options = aiProcessPreset_TargetRealtime_MaxQuality;
-	if (flipTextureCoords) { options |= aiProcess_FlipUVs; }
-	const aiScene* scene = importer.ReadFile(path, options);
+	/**
+	 * @brief The time one Assimp post-processing step took.
+	 */
+	struct PostProcessTiming {
+		std::string step;
+		double milliseconds;
+	};
 
-	// If the import failed, report it
-	if (nullptr == scene) { throw std::runtime_error("Error loading assimp file "); }
-	else {
+	/**
+	 * @brief The post-processing steps of the import running on one thread, in the order they ran.
+	 */
+	struct ImportTimings {
+		std::chrono::steady_clock::time_point start;
+		std::chrono::steady_clock::time_point firstStep;
+		std::vector<PostProcessTiming> steps;
+		std::string openStep;
+		std::chrono::steady_clock::time_point openedAt;
+
+		void closeStep(std::chrono::steady_clock::time_point now) {
+			if (!openStep.empty()) {
+				std::chrono::duration<double, std::milli> elapsed = now - openedAt;
+				steps.push_back({ openStep, elapsed.count() });
+				openStep.clear();
+			}
+		}
+	};
+
+	thread_local ImportTimings* currentTimings = nullptr;
+
+	/**
+	 * @brief Times post-processing steps from the "<Step> begin" and "<Step> finished" debug messages
+	 * that each step logs. Only imports on threads with currentTimings set are recorded.
+	 */
+	class StepTimingStream : public Assimp::LogStream {
+	public:
+		void write(const char* message) override {
+			ImportTimings* timings = currentTimings;
+			if (timings == nullptr) {
+				return;
+			}
+			auto now = std::chrono::steady_clock::now();
+			// Messages arrive as "Debug, T<thread>: <text>\n".
+			std::string text(message);
+			auto prefix = text.find(": ");
+			if (prefix != std::string::npos) {
+				text.erase(0, prefix + 2);
+			}
+			while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back()))) {
+				text.pop_back();
+			}
+
+			const std::string BEGIN = " begin";
+			if (text.size() > BEGIN.size() && text.compare(text.size() - BEGIN.size(), BEGIN.size(), BEGIN) == 0) {
+				timings->closeStep(now);
+				if (timings->steps.empty()) {
+					timings->firstStep = now;
+				}
+				timings->openStep = text.substr(0, text.size() - BEGIN.size());
+				timings->openedAt = now;
+			}
+			else if (!timings->openStep.empty() && text.rfind(timings->openStep, 0) == 0
+				&& (text.find("finished") != std::string::npos || text.find("skipped") != std::string::npos)) {
+				timings->closeStep(now);
+			}
+		}
+	};
 
+	/**
+	 * @brief Creates Assimp's logger, which only ever writes to the StepTimingStream, the first time
+	 * an import is timed.
+	 */
+	void installStepTimingStream() {
+		static bool installed = [] {
+			Assimp::DefaultLogger::create(nullptr, Assimp::Logger::DEBUGGING, 0);
+			Assimp::DefaultLogger::get()->attachStream(new StepTimingStream(), Assimp::Logger::Debugging);
+			return true;
+		}();
+		(void)installed;
 	}
-	/*auto* mesh = scene->mMeshes[0];
-	std::vector<std::pair<std::string, sf::Image>> textures;
+}
 
-	if (scene->HasMaterials()) {
+const char* importProfileName(ImportProfile profile) {
+	switch (profile) {
+	case ImportProfile::Fast:
+		return "fast";
+	case ImportProfile::Balanced:
+		return "balanced";
+	default:
+		return "max-quality";
+	}
+}
 
-		auto* material = scene->mMaterials[mesh->mMaterialIndex];
-		aiString name;
-		material->Get(AI_MATKEY_NAME, name);
+/**
+ * @brief The Assimp post-processing flags that models are imported with under the given profile.
+ */
+uint32_t assimpImportFlags(bool flipTextureCoords, ImportProfile profile) {
+	uint32_t options = aiProcessPreset_TargetRealtime_MaxQuality;
+	if (profile == ImportProfile::Fast) {
+		// fromAssimpMesh's hashing weld is much cheaper than JoinIdenticalVertices' spatial sort.
+		options = aiProcess_Triangulate | aiProcess_GenNormals | aiProcess_SortByPType;
+	}
+	else if (profile == ImportProfile::Balanced) {
+		options = aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals
+			| aiProcess_SortByPType | aiProcess_GenUVCoords | aiProcess_ImproveCacheLocality | aiProcess_FindInvalidData;
+	}
+	if (flipTextureCoords) { options |= aiProcess_FlipUVs; }
+	return options;
+}
 
-		material->GetTexture(aiTextureType_DIFFUSE, 0, &name);
+Object3D assimpLoad(const std::string& path, bool flipTextureCoords, ImportProfile profile,
+	const HierarchyOptions& hierarchy, float weldEpsilon) {
+	// A model that was already loaded shares its meshes and textures with the new instance.
+	uint64_t options = assimpImportFlags(flipTextureCoords, profile) | (uint64_t(hierarchy.registryKey()) << 32);
+	auto instance = ModelRegistry::find(path, options, weldEpsilon);
+	if (instance) {
+		return std::move(*instance);
+	}
 
-		std::filesystem::path modelPath = path;
-		std::filesystem::path texPath = modelPath.parent_path() / name.C_Str();
-		sf::Image diffuse;
-		diffuse.loadFromFile(texPath.string());
-		textures.emplace_back(std::make_pair(std::string("diffuse"), std::move(diffuse)));
+	ImportedModel imported = assimpImport(path, flipTextureCoords, profile, true, weldEpsilon);
+	simplifyHierarchy(imported, hierarchy);
+	std::unordered_map<std::filesystem::path, Texture, PathHash> loadedTextures;
+	loadModelTextures(imported.model, loadedTextures);
+	Object3D model = buildObject3D(imported.model, 0, loadedTextures);
+	ModelRegistry::insert(path, options, model, weldEpsilon);
+	return model;
+}
 
-		if (!material->GetTexture(aiTextureType_HEIGHT, 0, &name)) {
-			std::filesystem::path texPath = modelPath.parent_path() / name.C_Str();
-			sf::Image normal;
-			normal.loadFromFile(texPath.string());
-			textures.emplace_back(std::make_pair(std::string("normalMap"), std::move(normal)));
-		}
-		if (!material->GetTexture(aiTextureType_SPECULAR, 0, &name)) {
-			std::filesystem::path texPath = modelPath.parent_path() / name.C_Str();
-			sf::Image specular;
-			specular.loadFromFile(texPath.string());
-			textures.emplace_back(std::make_pair(std::string("specMap"), std::move(specular)));
+/**
+ * @brief Loads the converted form of a model, without touching the GPU. A warm start maps the
+ * model straight out of the mesh cache, skipping Assimp; otherwise the model is imported with
+ * Assimp and written to the cache for next time. With useMeshCache false, the cache is bypassed entirely.
+ * Imports log the time spent reading the file and in each post-processing step.
+ */
+ImportedModel assimpImport(const std::string& path, bool flipTextureCoords, ImportProfile profile, bool useMeshCache,
+	float weldEpsilon) {
+	auto options = assimpImportFlags(flipTextureCoords, profile);
+
+	auto key = useMeshCache ? MeshCache::makeKey(path, options, weldEpsilon) : std::nullopt;
+	if (key) {
+		auto cached = MeshCache::load(*key);
+		if (cached) {
+			auto storage = std::make_shared<CachedModel>(std::move(*cached));
+			return ImportedModel{ storage->model, storage };
 		}
-	}*/
-	//auto ret = Object3D(std::make_shared<Mesh3D>(fromAssimpMesh(scene->mMeshes[0], scene, textures)));
-	std::vector<Mesh3D> meshes;
-	std::unordered_map<std::filesystem::path, Texture, PathHash> loadedTextures;
-	auto ret = processAssimpNode(scene->mRootNode, scene, std::filesystem::path(path), loadedTextures);
+	}
+
+	installStepTimingStream();
+	ImportTimings timings;
+	timings.start = std::chrono::steady_clock::now();
+	currentTimings = &timings;
+	Assimp::Importer importer;
+	// The importer takes ownership of the IOSystem, and reads the model and its external files through it.
+	auto* files = new MappedIOSystem();
+	importer.SetIOHandler(files);
+	const aiScene* scene = importer.ReadFile(path, options);
+	currentTimings = nullptr;
+
+	// If the import failed, report it
+	if (nullptr == scene) { throw std::runtime_error("Error loading assimp file "); }
+
+	auto end = std::chrono::steady_clock::now();
+	timings.closeStep(end);
+	std::chrono::duration<double, std::milli> total = end - timings.start;
+	std::chrono::duration<double, std::milli> read = (timings.steps.empty() ? end : timings.firstStep) - timings.start;
+	std::cout << "Imported " << path << " with the " << importProfileName(profile) << " profile in "
+		<< total.count() << " ms (reading " << read.count() << " ms)" << std::endl;
+	for (auto& step : timings.steps) {
+		std::cout << "  " << step.step << ": " << step.milliseconds << " ms" << std::endl;
+	}
 
 	// aiNode -> Object3D. the aiNode's mTransformation -> Object3D.m_baseTransform.
 	// The list of meshes in aiNode -> Model3D.
-	return ret;
+	auto storage = std::make_shared<ModelData>(convertAssimpScene(scene, std::filesystem::path(path), weldEpsilon));
+	if (key) {
+		MeshCache::store(*key, *storage, files->openedPaths());
+	}
+	return ImportedModel{ storage->view(), storage };
 }
 
-Object3D processAssimpNode(aiNode* node, const aiScene* scene,
-	const std::filesystem::path& modelPath,
-	std::unordered_map<std::filesystem::path, Texture, PathHash>& loadedTextures) {
+/**
+ * @brief Converts every mesh of an Assimp scene to CPU-side vertices and faces, and flattens the
+ * scene's node hierarchy into a ModelData. Meshes are independent of each other, so they are
+ * converted concurrently; each lands in the slot of its scene mesh index, so the result does not
+ * depend on thread scheduling.
+ */
+ModelData convertAssimpScene(const aiScene* scene, const std::filesystem::path& modelPath, float weldEpsilon) {
+	ModelData model;
+	// Embedded textures are copied out of the scene before Assimp frees it, and are decoded from
+	// memory by the texture loaders' workers like any file.
+	for (unsigned t = 0; t < scene->mNumTextures; t++) {
+		auto bytes = copyEmbeddedTexture(scene->mTextures[t]);
+		if (!bytes) {
+			std::cerr << "Skipping embedded texture " << t << " of " << modelPath << ": too large for TGA" << std::endl;
+			continue;
+		}
+		EmbeddedTexture embedded{ embeddedTexturePath(modelPath, t), *bytes };
+		AssetPack::addMemory(embedded.path, embedded.bytes);
+		model.embeddedTextures.push_back(std::move(embedded));
+	}
+	model.meshes.resize(scene->mNumMeshes);
+	std::vector<WeldStats> welds(scene->mNumMeshes);
+	std::vector<std::pair<CacheStats, CacheStats>> caches(scene->mNumMeshes);
+	ThreadPool::shared().parallelFor(scene->mNumMeshes, [&](size_t i) {
+		model.meshes[i] = fromAssimpMesh(scene->mMeshes[i], scene, modelPath, weldEpsilon, &welds[i]);
+		caches[i] = optimizeMesh(model.meshes[i]);
+		buildMeshlets(model.meshes[i]);
+		optimizeVertexFetch(model.meshes[i]);
+		generateLods(model.meshes[i]);
+	});
 
-	// Load the aiNode's meshes.
-	std::vector<Mesh3D> meshes;
-	for (auto i = 0; i < node->mNumMeshes; i++) {
-		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		meshes.emplace_back(fromAssimpMesh(mesh, scene, modelPath, loadedTextures));
+	WeldStats weld;
+	for (auto& stats : welds) { weld += stats; }
+	if (weld.indexCount > 0) {
+		double savedKb = double(weld.verticesBefore - weld.verticesAfter) * sizeof(Vertex3D) / 1024.0;
+		std::cout << "Welded " << weld.verticesBefore << " vertices into " << weld.verticesAfter
+			<< ", saving " << savedKb << " KB of VRAM; post-transform cache hit rate "
+			<< 100.0 * (1.0 - double(weld.cacheMissesBefore) / weld.indexCount) << "% -> "
+			<< 100.0 * (1.0 - double(weld.cacheMissesAfter) / weld.indexCount) << "%" << std::endl;
+	}
+	for (size_t i = 0; i < caches.size(); i++) {
+		std::cout << "Mesh " << i << " (" << scene->mMeshes[i]->mName.C_Str() << "): ACMR "
+			<< caches[i].first.acmr << " -> " << caches[i].second.acmr << ", ATVR "
+			<< caches[i].first.atvr << " -> " << caches[i].second.atvr << std::endl;
+	}
+	size_t baseTriangles = 0;
+	size_t lodTriangles = 0;
+	size_t levels = 0;
+	size_t meshlets = 0;
+	for (auto& mesh : model.meshes) {
+		baseTriangles += mesh.baseFaceCount() / 3;
+		lodTriangles += (mesh.faces.size() - mesh.baseFaceCount()) / 3;
+		levels += mesh.lods.empty() ? 0 : mesh.lods.size() - 1;
+		meshlets += mesh.meshlets.size();
+	}
+	if (meshlets > 0) {
+		std::cout << "Clustered the large meshes into " << meshlets << " meshlets" << std::endl;
 	}
+	if (levels > 0) {
+		std::cout << "Built " << levels << " levels of detail, adding " << lodTriangles << " triangles to "
+			<< baseTriangles << std::endl;
+	}
+	packMaterialMaps(model, modelPath);
 
-	std::vector<Texture> textures;
-	for (auto& p : loadedTextures) {
-		textures.push_back(p.second);
+	// Nodes that animation channels, bones, cameras, or lights refer to by name move at runtime.
+	std::unordered_set<std::string> animatedNodes;
+	for (unsigned a = 0; a < scene->mNumAnimations; a++) {
+		for (unsigned c = 0; c < scene->mAnimations[a]->mNumChannels; c++) {
+			animatedNodes.insert(scene->mAnimations[a]->mChannels[c]->mNodeName.C_Str());
+		}
+	}
+	for (unsigned m = 0; m < scene->mNumMeshes; m++) {
+		for (unsigned b = 0; b < scene->mMeshes[m]->mNumBones; b++) {
+			animatedNodes.insert(scene->mMeshes[m]->mBones[b]->mName.C_Str());
+		}
+	}
+	for (unsigned c = 0; c < scene->mNumCameras; c++) {
+		animatedNodes.insert(scene->mCameras[c]->mName.C_Str());
 	}
-	glm::mat4 baseTransform;
+	for (unsigned l = 0; l < scene->mNumLights; l++) {
+		animatedNodes.insert(scene->mLights[l]->mName.C_Str());
+	}
+	processAssimpNode(scene->mRootNode, model, animatedNodes);
+	return model;
+}
+
+/**
+ * @brief Appends the given node and its descendants to the model's node list.
+ * @return the index of the node in the list.
+ */
+uint32_t processAssimpNode(aiNode* node, ModelData& model, const std::unordered_set<std::string>& animatedNodes) {
+	uint32_t index = static_cast<uint32_t>(model.nodes.size());
+	model.nodes.emplace_back();
+
+	NodeData data;
+	data.name = node->mName.C_Str();
+	data.animated = animatedNodes.count(data.name) > 0;
+	// The aiNode's meshes are indices into the scene's mesh list, which is converted in the same order.
+	data.meshes.assign(node->mMeshes, node->mMeshes + node->mNumMeshes);
 	for (auto i = 0; i < 4; i++) {
 		for (auto j = 0; j < 4; j++) {
-			baseTransform[i][j] = node->mTransformation[j][i];
+			data.baseTransform[i][j] = node->mTransformation[j][i];
 		}
 	}
-	auto parent = Object3D(std::move(meshes), baseTransform);
 
 	for (auto i = 0; i < node->mNumChildren; i++) {
-		Object3D child = processAssimpNode(node->mChildren[i], scene, modelPath, loadedTextures);
-		parent.addChild(std::move(child));
+		data.children.push_back(processAssimpNode(node->mChildren[i], model, animatedNodes));
 	}
-
-	return parent;
+	model.nodes[index] = std::move(data);
+	return index;
 }
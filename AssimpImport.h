@@ -1,21 +1,46 @@
 #pragma once
 #include "Mesh3D.h"
 #include "Object3D.h"
-#include <unordered_map>
+#include "ModelData.h"
+#include "MeshOptimizer.h"
 #include <assimp/scene.h>
+#include <unordered_set>
 
-struct PathHash {
-    std::size_t operator()(const std::filesystem::path& p) const {
-        return std::hash<std::string>{}(p.string());
-    }
+/**
+ * @brief Named sets of Assimp post-processing steps, trading import time for mesh quality.
+ */
+enum class ImportProfile {
+	// Triangulates and fills in missing normals: only what fromAssimpMesh reads. Vertices are
+	// welded by fromAssimpMesh rather than Assimp.
+	Fast,
+	// Fast, with smooth normals, generated texture coordinates, and vertex cache ordering.
+	Balanced,
+	// Assimp's aiProcessPreset_TargetRealtime_MaxQuality, including tangents and degenerate removal.
+	MaxQuality
 };
 
-Mesh3D fromAssimpMesh(const aiMesh* mesh, const aiScene* scene, const std::filesystem::path& modelPath,
-	std::unordered_map<std::filesystem::path, Texture>& loadedTextures);
-Object3D assimpLoad(const std::string& path, bool flipTextureCoords);
-Object3D processAssimpNode(aiNode* node, const aiScene* scene,
-	const std::filesystem::path& modelPath,
-	std::unordered_map<std::filesystem::path, Texture, PathHash>& textures);
-std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, const std::string& typeName,
-	const std::filesystem::path& modelPath,
-	std::unordered_map<std::filesystem::path, Texture, PathHash>& loadedTextures);
\ No newline at end of file
+const char* importProfileName(ImportProfile profile);
+
+/**
+ * @brief Converts one Assimp mesh, welding its duplicate vertices (see weldVertices) before returning it.
+ * @param weld if given, receives the weld's before-and-after vertex counts and cache misses.
+ */
+MeshData fromAssimpMesh(const aiMesh* mesh, const aiScene* scene, const std::filesystem::path& modelPath,
+	float weldEpsilon = 0, WeldStats* weld = nullptr);
+/**
+ * @brief Loads a model with Assimp, welding vertices within weldEpsilon of each other (see weldVertices).
+ * Loads with different epsilons are cached and registered apart.
+ */
+Object3D assimpLoad(const std::string& path, bool flipTextureCoords, ImportProfile profile = ImportProfile::MaxQuality,
+	const HierarchyOptions& hierarchy = {}, float weldEpsilon = 0);
+uint32_t assimpImportFlags(bool flipTextureCoords, ImportProfile profile = ImportProfile::MaxQuality);
+ImportedModel assimpImport(const std::string& path, bool flipTextureCoords,
+	ImportProfile profile = ImportProfile::MaxQuality, bool useMeshCache = true, float weldEpsilon = 0);
+ModelData convertAssimpScene(const aiScene* scene, const std::filesystem::path& modelPath, float weldEpsilon = 0);
+uint32_t processAssimpNode(aiNode* node, ModelData& model, const std::unordered_set<std::string>& animatedNodes);
+/**
+ * @brief The texture references of one type in a material. References to textures embedded in the
+ * scene become their virtual paths (see embeddedTexturePath), if the scene is given.
+ */
+std::vector<TextureRef> loadMaterialTextures(aiMaterial* mat, aiTextureType type, const std::string& typeName,
+	const std::filesystem::path& modelPath, const aiScene* scene = nullptr);
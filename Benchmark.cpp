@@ -0,0 +1,60 @@
+#include "Benchmark.h"
+#include "AssimpImport.h"
+#include "GltfImport.h"
+#include "TextureLoader.h"
+#include <chrono>
+#include <functional>
+#include <iostream>
+
+namespace {
+	/**
+	 * @brief Runs the given load repeatedly and returns the fastest time, in milliseconds. glFinish
+	 * makes sure every upload has really reached the GPU before the clock stops.
+	 */
+	double bestOf(int iterations, const std::function<void()>& load) {
+		double best = 0;
+		for (auto i = 0; i < iterations; i++) {
+			auto start = std::chrono::steady_clock::now();
+			load();
+			glFinish();
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			if (i == 0 || elapsed.count() < best) {
+				best = elapsed.count();
+			}
+		}
+		return best;
+	}
+}
+
+void benchmarkGltf(const std::string& path, int iterations) {
+	// The Assimp path imports with the fewest Assimp steps, but convertAssimpScene still runs every
+	// mesh pass on the result, which the native path leaves out.
+	auto loadWithAssimp = [&]() {
+		ImportedModel imported = assimpImport(path, true, ImportProfile::Fast, false);
+		std::unordered_map<std::filesystem::path, Texture, PathHash> loadedTextures;
+		loadModelTextures(imported.model, loadedTextures);
+		return buildObject3D(imported.model, 0, loadedTextures);
+	};
+
+	// Warm the texture cache with both paths' textures; the objects keep them resident, so neither
+	// timed path decodes or uploads a texture.
+	Object3D warmNative = gltfLoadDirect(path, true);
+	Object3D warmAssimp = loadWithAssimp();
+
+	double native = bestOf(iterations, [&]() {
+		Object3D model = gltfLoadDirect(path, true);
+	});
+	double assimp = bestOf(iterations, [&]() {
+		Object3D model = loadWithAssimp();
+	});
+	double assimpImportOnly = bestOf(iterations, [&]() {
+		ImportedModel imported = assimpImport(path, true, ImportProfile::Fast, false);
+	});
+
+	std::cout << "glTF benchmark for " << path << " (best of " << iterations << ", textures already resident):" << std::endl
+		<< "  native glTF path: " << native << " ms (parse, Tipsify, upload)" << std::endl
+		<< "  Assimp path:      " << assimp << " ms (fast profile, weld, Tipsify, overdraw and vertex fetch"
+		<< " order, meshlets, LODs, upload)" << std::endl
+		<< "    import only:    " << assimpImportOnly << " ms" << std::endl
+		<< "  Assimp / native:  " << assimp / native << "x, including the mesh passes only Assimp runs" << std::endl;
+}
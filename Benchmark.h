@@ -0,0 +1,12 @@
+#pragma once
+#include <string>
+
+/**
+ * @brief Times loading a glTF model through the native fast path and through Assimp (bypassing the
+ * mesh cache), and prints the results. Both paths' textures are loaded once beforehand, so both hit
+ * the TextureCache and the timings cover geometry only. The paths do not run the same mesh passes:
+ * the native path only reorders for the vertex cache, while Assimp imports also weld and build
+ * meshlets and LODs, so the Assimp import's own time is printed apart from its upload. Requires an
+ * OpenGL context.
+ */
+void benchmarkGltf(const std::string& path, int iterations = 5);
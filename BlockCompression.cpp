@@ -0,0 +1,555 @@
+#include "BlockCompression.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+	/**
+	 * @brief A 4x4 block of RGBA texels, row by row.
+	 */
+	struct Block {
+		uint8_t texels[16][4];
+	};
+
+	/**
+	 * @brief Copies the block at the given block coordinates out of an image, repeating the edge
+	 * texels where the block overhangs it.
+	 */
+	void loadBlock(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t bx, uint32_t by, Block& block) {
+		for (uint32_t y = 0; y < 4; y++) {
+			uint32_t sy = std::min(by * 4 + y, height - 1);
+			for (uint32_t x = 0; x < 4; x++) {
+				uint32_t sx = std::min(bx * 4 + x, width - 1);
+				memcpy(block.texels[y * 4 + x], rgba + (size_t(sy) * width + sx) * 4, 4);
+			}
+		}
+	}
+
+	/**
+	 * @brief Writes the fields of a compressed block, least significant bit first.
+	 */
+	class BitWriter {
+	private:
+		uint8_t* m_out;
+		size_t m_bit;
+
+	public:
+		BitWriter(uint8_t* out, size_t bytes) : m_out(out), m_bit(0) {
+			memset(out, 0, bytes);
+		}
+
+		void write(uint32_t value, uint32_t bits) {
+			for (uint32_t i = 0; i < bits; i++, m_bit++) {
+				if ((value >> i) & 1) {
+					m_out[m_bit >> 3] |= uint8_t(1 << (m_bit & 7));
+				}
+			}
+		}
+	};
+
+	/**
+	 * @brief The mean of the block's first N channels, and the direction along which they vary the
+	 * most: the principal eigenvector of their covariance, by power iteration.
+	 * @return false if every texel is the same, so there is no such direction.
+	 */
+	template <int N>
+	bool principalAxis(const Block& block, float mean[N], float axis[N]) {
+		for (int c = 0; c < N; c++) {
+			mean[c] = 0;
+			for (int i = 0; i < 16; i++) {
+				mean[c] += block.texels[i][c];
+			}
+			mean[c] /= 16;
+		}
+		float covariance[N][N] = {};
+		for (int i = 0; i < 16; i++) {
+			float d[N];
+			for (int c = 0; c < N; c++) {
+				d[c] = block.texels[i][c] - mean[c];
+			}
+			for (int a = 0; a < N; a++) {
+				for (int b = 0; b < N; b++) {
+					covariance[a][b] += d[a] * d[b];
+				}
+			}
+		}
+
+		// Start from the column of the channel that varies most, which always lies in the covariance's range.
+		int widest = 0;
+		for (int c = 1; c < N; c++) {
+			if (covariance[c][c] > covariance[widest][widest]) {
+				widest = c;
+			}
+		}
+		if (covariance[widest][widest] <= 0) {
+			return false;
+		}
+		for (int c = 0; c < N; c++) {
+			axis[c] = covariance[widest][c];
+		}
+		for (int iteration = 0; iteration < 8; iteration++) {
+			float next[N] = {};
+			float largest = 0;
+			for (int a = 0; a < N; a++) {
+				for (int b = 0; b < N; b++) {
+					next[a] += covariance[a][b] * axis[b];
+				}
+				largest = std::max(largest, std::abs(next[a]));
+			}
+			if (largest == 0) {
+				break;
+			}
+			for (int c = 0; c < N; c++) {
+				axis[c] = next[c] / largest;
+			}
+		}
+		float length = 0;
+		for (int c = 0; c < N; c++) {
+			length += axis[c] * axis[c];
+		}
+		length = std::sqrt(length);
+		for (int c = 0; c < N; c++) {
+			axis[c] /= length;
+		}
+		return true;
+	}
+
+	/**
+	 * @brief The ends of the block's principal axis: the points on it nearest the texels at either
+	 * extreme, pulled in by the given fraction of its length.
+	 */
+	template <int N>
+	bool axisEndpoints(const Block& block, float inset, float e0[N], float e1[N]) {
+		float mean[N], axis[N];
+		if (!principalAxis<N>(block, mean, axis)) {
+			for (int c = 0; c < N; c++) {
+				e0[c] = e1[c] = mean[c];
+			}
+			return false;
+		}
+		float lowest = 0, highest = 0;
+		for (int i = 0; i < 16; i++) {
+			float t = 0;
+			for (int c = 0; c < N; c++) {
+				t += (block.texels[i][c] - mean[c]) * axis[c];
+			}
+			lowest = std::min(lowest, t);
+			highest = std::max(highest, t);
+		}
+		float pull = (highest - lowest) * inset;
+		for (int c = 0; c < N; c++) {
+			e0[c] = mean[c] + axis[c] * (lowest + pull);
+			e1[c] = mean[c] + axis[c] * (highest - pull);
+		}
+		return true;
+	}
+
+	/**
+	 * @brief The endpoints that best fit the block in the least-squares sense, given how far each
+	 * texel lies from the first endpoint towards the second.
+	 * @return false if every texel has the same weight, which leaves the endpoints undetermined.
+	 */
+	template <int N>
+	bool fitEndpoints(const Block& block, const float weights[16], float e0[N], float e1[N]) {
+		float aa = 0, ab = 0, bb = 0;
+		float ax[N] = {}, bx[N] = {};
+		for (int i = 0; i < 16; i++) {
+			float a = 1 - weights[i], b = weights[i];
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (int c = 0; c < N; c++) {
+				ax[c] += a * block.texels[i][c];
+				bx[c] += b * block.texels[i][c];
+			}
+		}
+		float determinant = aa * bb - ab * ab;
+		if (determinant < 1e-6f) {
+			return false;
+		}
+		for (int c = 0; c < N; c++) {
+			e0[c] = std::clamp((ax[c] * bb - bx[c] * ab) / determinant, 0.0f, 255.0f);
+			e1[c] = std::clamp((bx[c] * aa - ax[c] * ab) / determinant, 0.0f, 255.0f);
+		}
+		return true;
+	}
+
+	uint16_t to565(const float color[3]) {
+		auto quantize = [](float value, int levels) {
+			return static_cast<uint16_t>(std::clamp(std::lround(value * levels / 255.0f), 0L, long(levels)));
+		};
+		return uint16_t(quantize(color[0], 31) << 11 | quantize(color[1], 63) << 5 | quantize(color[2], 31));
+	}
+
+	void from565(uint16_t packed, int color[3]) {
+		int r = packed >> 11, g = (packed >> 5) & 63, b = packed & 31;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+	}
+
+	/**
+	 * @brief Picks the nearest colour of a four-colour BC1 palette for each texel.
+	 * @return the total squared error.
+	 */
+	uint32_t colorIndices(const Block& block, uint16_t c0, uint16_t c1, uint8_t indices[16]) {
+		int palette[4][3];
+		from565(c0, palette[0]);
+		from565(c1, palette[1]);
+		for (int c = 0; c < 3; c++) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+		}
+		uint32_t total = 0;
+		for (int i = 0; i < 16; i++) {
+			uint32_t best = UINT32_MAX;
+			for (uint8_t p = 0; p < 4; p++) {
+				uint32_t error = 0;
+				for (int c = 0; c < 3; c++) {
+					int d = block.texels[i][c] - palette[p][c];
+					error += d * d;
+				}
+				if (error < best) {
+					best = error;
+					indices[i] = p;
+				}
+			}
+			total += best;
+		}
+		return total;
+	}
+
+	/**
+	 * @brief Encodes the RGB channels of a block as BC1 colour, in four-colour mode (as BC3 always is).
+	 */
+	void encodeColor(const Block& block, uint8_t out[8]) {
+		float e0[3], e1[3];
+		axisEndpoints<3>(block, 1.0f / 16, e0, e1);
+		uint16_t c0 = to565(e1), c1 = to565(e0);
+		uint8_t indices[16];
+		uint32_t error = colorIndices(block, c0, c1, indices);
+
+		// One round of least-squares refinement, kept only if it helps. Palette entries 0 to 3 lie
+		// 0, 1, 1/3, and 2/3 of the way from c0 to c1.
+		const float WEIGHTS[4] = { 0, 1, 1.0f / 3, 2.0f / 3 };
+		float weights[16];
+		for (int i = 0; i < 16; i++) {
+			weights[i] = WEIGHTS[indices[i]];
+		}
+		if (c0 != c1 && fitEndpoints<3>(block, weights, e0, e1)) {
+			uint16_t r0 = to565(e0), r1 = to565(e1);
+			uint8_t refined[16];
+			uint32_t refinedError = colorIndices(block, r0, r1, refined);
+			if (refinedError < error) {
+				c0 = r0;
+				c1 = r1;
+				memcpy(indices, refined, sizeof(refined));
+			}
+		}
+
+		// Four-colour mode needs c0 > c1. Swapping the endpoints swaps entries 0 and 1, and 2 and 3.
+		if (c0 < c1) {
+			std::swap(c0, c1);
+			for (auto& index : indices) {
+				index ^= 1;
+			}
+		}
+		else if (c0 == c1) {
+			memset(indices, 0, sizeof(indices));
+		}
+		BitWriter writer(out, 8);
+		writer.write(c0, 16);
+		writer.write(c1, 16);
+		for (auto index : indices) {
+			writer.write(index, 2);
+		}
+	}
+
+	/**
+	 * @brief Encodes one channel of a block as BC4, with eight values interpolated between its
+	 * lowest and highest.
+	 */
+	void encodeChannel(const Block& block, int channel, uint8_t out[8]) {
+		int low = 255, high = 0;
+		for (int i = 0; i < 16; i++) {
+			low = std::min(low, int(block.texels[i][channel]));
+			high = std::max(high, int(block.texels[i][channel]));
+		}
+		BitWriter writer(out, 8);
+		writer.write(high, 8);
+		writer.write(low, 8);
+		if (high == low) {
+			return;
+		}
+		// Entries 0 and 1 are the endpoints; 2 to 7 step from the first to the second.
+		int palette[8] = { high, low };
+		for (int p = 2; p < 8; p++) {
+			palette[p] = ((8 - p) * high + (p - 1) * low) / 7;
+		}
+		for (int i = 0; i < 16; i++) {
+			int value = block.texels[i][channel];
+			uint32_t best = 0;
+			for (uint32_t p = 1; p < 8; p++) {
+				if (std::abs(palette[p] - value) < std::abs(palette[best] - value)) {
+					best = p;
+				}
+			}
+			writer.write(best, 3);
+		}
+	}
+
+	// BC7's interpolation weights for 4-bit indices, out of 64.
+	const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	/**
+	 * @brief Quantizes an RGBA endpoint to BC7 mode 6's 7 bits per channel plus a shared low bit,
+	 * choosing whichever low bit lands nearer.
+	 */
+	void quantizeBC7Endpoint(const float endpoint[4], int quantized[4], int& lowBit) {
+		float bestError = INFINITY;
+		for (int p = 0; p < 2; p++) {
+			int candidate[4];
+			float error = 0;
+			for (int c = 0; c < 4; c++) {
+				candidate[c] = std::clamp(int(std::lround((endpoint[c] - p) / 2)), 0, 127);
+				float d = float(candidate[c] * 2 + p) - endpoint[c];
+				error += d * d;
+			}
+			if (error < bestError) {
+				bestError = error;
+				lowBit = p;
+				memcpy(quantized, candidate, sizeof(candidate));
+			}
+		}
+	}
+
+	/**
+	 * @brief Picks the nearest of the 16 colours between two BC7 mode 6 endpoints for each texel.
+	 * @return the total squared error.
+	 */
+	uint32_t bc7Indices(const Block& block, const int q0[4], int p0, const int q1[4], int p1, uint8_t indices[16]) {
+		int palette[16][4];
+		for (int c = 0; c < 4; c++) {
+			int e0 = q0[c] * 2 + p0, e1 = q1[c] * 2 + p1;
+			for (int p = 0; p < 16; p++) {
+				palette[p][c] = ((64 - BC7_WEIGHTS[p]) * e0 + BC7_WEIGHTS[p] * e1 + 32) >> 6;
+			}
+		}
+		uint32_t total = 0;
+		for (int i = 0; i < 16; i++) {
+			uint32_t best = UINT32_MAX;
+			for (uint8_t p = 0; p < 16; p++) {
+				uint32_t error = 0;
+				for (int c = 0; c < 4; c++) {
+					int d = block.texels[i][c] - palette[p][c];
+					error += d * d;
+				}
+				if (error < best) {
+					best = error;
+					indices[i] = p;
+				}
+			}
+			total += best;
+		}
+		return total;
+	}
+
+	/**
+	 * @brief Encodes a block in BC7 mode 6: one pair of RGBA endpoints and 16 colours between them.
+	 */
+	void encodeBC7(const Block& block, uint8_t out[16]) {
+		float e0[4], e1[4];
+		axisEndpoints<4>(block, 0, e0, e1);
+		int q0[4], q1[4], p0, p1;
+		quantizeBC7Endpoint(e0, q0, p0);
+		quantizeBC7Endpoint(e1, q1, p1);
+		uint8_t indices[16];
+		uint32_t error = bc7Indices(block, q0, p0, q1, p1, indices);
+
+		float weights[16];
+		for (int i = 0; i < 16; i++) {
+			weights[i] = BC7_WEIGHTS[indices[i]] / 64.0f;
+		}
+		if (error > 0 && fitEndpoints<4>(block, weights, e0, e1)) {
+			int r0[4], r1[4], s0, s1;
+			quantizeBC7Endpoint(e0, r0, s0);
+			quantizeBC7Endpoint(e1, r1, s1);
+			uint8_t refined[16];
+			if (bc7Indices(block, r0, s0, r1, s1, refined) < error) {
+				memcpy(q0, r0, sizeof(r0));
+				memcpy(q1, r1, sizeof(r1));
+				p0 = s0;
+				p1 = s1;
+				memcpy(indices, refined, sizeof(refined));
+			}
+		}
+
+		// The first texel's index is stored without its high bit, which must be clear; swapping the
+		// endpoints mirrors every index.
+		if (indices[0] & 8) {
+			std::swap(q0, q1);
+			std::swap(p0, p1);
+			for (auto& index : indices) {
+				index = 15 - index;
+			}
+		}
+		BitWriter writer(out, 16);
+		// Mode 6 is six zero bits and a one.
+		writer.write(1 << 6, 7);
+		for (int c = 0; c < 4; c++) {
+			writer.write(q0[c], 7);
+			writer.write(q1[c], 7);
+		}
+		writer.write(p0, 1);
+		writer.write(p1, 1);
+		writer.write(indices[0], 3);
+		for (int i = 1; i < 16; i++) {
+			writer.write(indices[i], 4);
+		}
+	}
+}
+
+bool BlockFormatSupport::supports(BlockFormat format) const {
+	switch (format) {
+	case BlockFormat::RGBA8: return true;
+	case BlockFormat::BC1: return bc1;
+	case BlockFormat::BC3: return bc3;
+	case BlockFormat::BC4: return bc4;
+	case BlockFormat::BC5: return bc5;
+	case BlockFormat::BC7: return bc7;
+	}
+	return false;
+}
+
+size_t GpuTexture::bytes() const {
+	size_t total = 0;
+	for (auto& level : levels) {
+		total += level.size;
+	}
+	return total;
+}
+
+const char* blockFormatName(BlockFormat format) {
+	switch (format) {
+	case BlockFormat::RGBA8: return "RGBA8";
+	case BlockFormat::BC1: return "BC1";
+	case BlockFormat::BC3: return "BC3";
+	case BlockFormat::BC4: return "BC4";
+	case BlockFormat::BC5: return "BC5";
+	case BlockFormat::BC7: return "BC7";
+	}
+	return "unknown";
+}
+
+const char* textureUsageName(TextureUsage usage) {
+	switch (usage) {
+	case TextureUsage::Color: return "color";
+	case TextureUsage::Normal: return "normal";
+	case TextureUsage::Material: return "material";
+	}
+	return "unknown";
+}
+
+size_t blockBytes(BlockFormat format) {
+	switch (format) {
+	case BlockFormat::BC1:
+	case BlockFormat::BC4:
+		return 8;
+	case BlockFormat::BC3:
+	case BlockFormat::BC5:
+	case BlockFormat::BC7:
+		return 16;
+	default:
+		return 4;
+	}
+}
+
+size_t levelBytes(BlockFormat format, uint32_t width, uint32_t height) {
+	if (format == BlockFormat::RGBA8) {
+		return size_t(width) * height * 4;
+	}
+	return size_t((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+BlockFormat chooseBlockFormat(TextureUsage usage, const uint8_t* rgba, uint32_t width, uint32_t height,
+	const BlockFormatSupport& support) {
+	auto supported = [&](BlockFormat format) { return support.supports(format) ? format : BlockFormat::RGBA8; };
+	if (usage == TextureUsage::Normal) {
+		return supported(BlockFormat::BC5);
+	}
+	if (usage == TextureUsage::Material) {
+		return support.bc7 ? BlockFormat::BC7 : supported(BlockFormat::BC3);
+	}
+
+	bool opaque = true, grey = true;
+	for (size_t i = 0, count = size_t(width) * height; i < count && (opaque || grey); i++) {
+		const uint8_t* texel = rgba + i * 4;
+		opaque &= texel[3] == 255;
+		grey &= texel[0] == texel[1] && texel[1] == texel[2];
+	}
+	if (opaque && grey && support.bc4) {
+		return BlockFormat::BC4;
+	}
+	if (opaque) {
+		return supported(BlockFormat::BC1);
+	}
+	return support.bc7 ? BlockFormat::BC7 : supported(BlockFormat::BC3);
+}
+
+void compressBlocks(const uint8_t* rgba, uint32_t width, uint32_t height, BlockFormat format, uint8_t* out) {
+	if (format == BlockFormat::RGBA8) {
+		memcpy(out, rgba, levelBytes(format, width, height));
+		return;
+	}
+	Block block;
+	for (uint32_t by = 0; by < (height + 3) / 4; by++) {
+		for (uint32_t bx = 0; bx < (width + 3) / 4; bx++) {
+			loadBlock(rgba, width, height, bx, by, block);
+			switch (format) {
+			case BlockFormat::BC1:
+				encodeColor(block, out);
+				break;
+			case BlockFormat::BC3:
+				encodeChannel(block, 3, out);
+				encodeColor(block, out + 8);
+				break;
+			case BlockFormat::BC4:
+				encodeChannel(block, 0, out);
+				break;
+			case BlockFormat::BC5:
+				encodeChannel(block, 0, out);
+				encodeChannel(block, 1, out + 8);
+				break;
+			case BlockFormat::BC7:
+				encodeBC7(block, out);
+				break;
+			default:
+				break;
+			}
+			out += blockBytes(format);
+		}
+	}
+}
+
+GpuTexture compressTexture(const GpuTexture& texture, BlockFormat format) {
+	if (format == texture.format) {
+		return texture;
+	}
+	// Every level is laid out in one buffer, largest first.
+	size_t total = 0;
+	for (auto& level : texture.levels) {
+		total += levelBytes(format, level.width, level.height);
+	}
+	auto storage = std::make_shared<std::vector<uint8_t>>(total);
+	GpuTexture compressed;
+	compressed.format = format;
+	compressed.storage = storage;
+	size_t offset = 0;
+	for (auto& level : texture.levels) {
+		size_t size = levelBytes(format, level.width, level.height);
+		compressBlocks(level.data, level.width, level.height, format, storage->data() + offset);
+		compressed.levels.push_back({ level.width, level.height, storage->data() + offset, size });
+		offset += size;
+	}
+	return compressed;
+}
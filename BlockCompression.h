@@ -0,0 +1,106 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief The formats a texture can be stored in on the GPU: plain 8-bit RGBA, or one of the BCn
+ * block-compressed formats, which store each 4x4 block of texels in 8 or 16 bytes.
+ */
+enum class BlockFormat : uint32_t {
+	RGBA8,
+	// Opaque RGB in 4 bits per texel.
+	BC1,
+	// RGB as in BC1, with an interpolated alpha channel; 8 bits per texel.
+	BC3,
+	// One interpolated channel in 4 bits per texel.
+	BC4,
+	// Two BC4 channels, for normal maps; 8 bits per texel.
+	BC5,
+	// High-quality RGBA in 8 bits per texel.
+	BC7,
+};
+
+/**
+ * @brief What a texture is sampled for, which decides the block format that suits it.
+ */
+enum class TextureUsage {
+	// Base colour textures, and any other texture sampled as a colour.
+	Color,
+	// Tangent-space normal maps, of which only the X and Y components are kept.
+	Normal,
+	// Packed material maps (see packMaterialMaps): a specular colour, and a gloss in alpha.
+	Material,
+};
+
+/**
+ * @brief The block-compressed formats that the GPU can sample.
+ */
+struct BlockFormatSupport {
+	bool bc1 = false;
+	bool bc3 = false;
+	bool bc4 = false;
+	bool bc5 = false;
+	bool bc7 = false;
+
+	bool supports(BlockFormat format) const;
+};
+
+/**
+ * @brief One mip level of a GpuTexture.
+ */
+struct GpuTextureLevel {
+	uint32_t width;
+	uint32_t height;
+	const uint8_t* data;
+	size_t size;
+};
+
+/**
+ * @brief A texture in the form the GPU samples it: its format and mip levels, largest first, whose
+ * bytes stay valid as long as the storage is alive.
+ */
+struct GpuTexture {
+	BlockFormat format = BlockFormat::RGBA8;
+	std::vector<GpuTextureLevel> levels;
+	std::shared_ptr<const void> storage;
+
+	bool valid() const { return !levels.empty(); }
+	uint32_t width() const { return levels.empty() ? 0 : levels[0].width; }
+	uint32_t height() const { return levels.empty() ? 0 : levels[0].height; }
+	size_t bytes() const;
+};
+
+const char* blockFormatName(BlockFormat format);
+const char* textureUsageName(TextureUsage usage);
+
+/**
+ * @brief The bytes in one 4x4 block of a compressed format, or in one texel of RGBA8.
+ */
+size_t blockBytes(BlockFormat format);
+
+/**
+ * @brief The bytes in one mip level of the given size. Compressed levels are padded to whole blocks.
+ */
+size_t levelBytes(BlockFormat format, uint32_t width, uint32_t height);
+
+/**
+ * @brief Picks the format for an image from its usage and contents: BC5 for normal maps, BC7 or
+ * else BC3 for material maps, and for colour, BC4 if it is grey, BC1 if it is opaque, and BC7 or else BC3 if it
+ * has alpha. Formats the GPU cannot sample fall back to RGBA8.
+ */
+BlockFormat chooseBlockFormat(TextureUsage usage, const uint8_t* rgba, uint32_t width, uint32_t height,
+	const BlockFormatSupport& support);
+
+/**
+ * @brief Compresses an RGBA image into blocks of the given format, writing levelBytes(format,
+ * width, height) bytes. Blocks that overhang the image repeat its edge texels.
+ */
+void compressBlocks(const uint8_t* rgba, uint32_t width, uint32_t height, BlockFormat format, uint8_t* out);
+
+/**
+ * @brief Compresses every level of an RGBA8 texture, such as a mip chain from generateMipmaps, into
+ * the given format.
+ */
+GpuTexture compressTexture(const GpuTexture& texture, BlockFormat format);
@@ -0,0 +1,180 @@
+#include "DependencyGraph.h"
+#include "AssetPack.h"
+#include "Hash.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+	const std::string RECORD_EXTENSION = ".deps";
+
+	std::filesystem::path recordPath(const std::filesystem::path& artifact) {
+		return artifact.string() + RECORD_EXTENSION;
+	}
+
+	/**
+	 * @brief The last write time of a loose file, or the stamp of its entry in the mounted asset pack,
+	 * with the top bit cleared so it is never -1. Otherwise -1: the file is served from memory, or
+	 * does not exist.
+	 */
+	int64_t modifiedTime(const std::string& path) {
+		auto packed = AssetPack::packedState(path);
+		if (packed) {
+			return static_cast<int64_t>(packed->stamp >> 1);
+		}
+		std::error_code error;
+		if (AssetPack::contains(path)) {
+			return -1;
+		}
+		auto time = std::filesystem::last_write_time(path, error);
+		return error ? -1 : static_cast<int64_t>(time.time_since_epoch().count());
+	}
+
+	uint64_t fileSize(const std::string& path) {
+		auto packed = AssetPack::packedState(path);
+		if (packed) {
+			return packed->size;
+		}
+		std::error_code error;
+		auto size = std::filesystem::file_size(path, error);
+		return error ? 0 : static_cast<uint64_t>(size);
+	}
+}
+
+std::optional<DependencyInput> DependencyGraph::describe(const std::string& path) {
+	auto bytes = AssetPack::open(path);
+	if (!bytes) {
+		return std::nullopt;
+	}
+	return DependencyInput{ path, bytes->size, modifiedTime(path), fnv1a64(bytes->data, bytes->size) };
+}
+
+bool DependencyGraph::record(const std::filesystem::path& artifact, const DependencyRecord& record) {
+	// One line per entry; paths come last on their line, so they may contain spaces.
+	std::ostringstream text;
+	text << "version " << record.converterVersion << "\n";
+	text << "flags " << record.importFlags << "\n";
+	for (auto& input : record.inputs) {
+		text << "input " << input.size << " " << input.modifiedTime << " " << std::hex << input.hash << std::dec
+			<< " " << input.path << "\n";
+	}
+	for (auto& reference : record.references) {
+		text << "reference " << reference << "\n";
+	}
+
+	// Written to a temporary file and renamed into place, so a crash never leaves half a record.
+	auto path = recordPath(artifact);
+	auto temporary = path;
+	temporary += ".tmp";
+	{
+		std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+		out << text.str();
+		if (!out) {
+			return false;
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(temporary, path, error);
+	return !error;
+}
+
+std::optional<DependencyRecord> DependencyGraph::load(const std::filesystem::path& artifact) {
+	std::ifstream in(recordPath(artifact));
+	if (!in) {
+		return std::nullopt;
+	}
+	DependencyRecord record;
+	std::string line;
+	while (std::getline(in, line)) {
+		std::istringstream fields(line);
+		std::string kind;
+		fields >> kind;
+		if (kind == "version") {
+			fields >> record.converterVersion;
+		}
+		else if (kind == "flags") {
+			fields >> record.importFlags;
+		}
+		else if (kind == "input") {
+			DependencyInput input;
+			fields >> input.size >> input.modifiedTime >> std::hex >> input.hash >> std::dec;
+			fields.get();
+			std::getline(fields, input.path);
+			record.inputs.push_back(std::move(input));
+		}
+		else if (kind == "reference") {
+			fields.get();
+			std::string reference;
+			std::getline(fields, reference);
+			record.references.push_back(std::move(reference));
+		}
+		if (fields.fail() && !fields.eof()) {
+			return std::nullopt;
+		}
+	}
+	return record;
+}
+
+bool DependencyGraph::isUpToDate(const std::filesystem::path& artifact, uint32_t importFlags, uint32_t converterVersion) {
+	auto existing = load(artifact);
+	if (!existing || existing->converterVersion != converterVersion || existing->importFlags != importFlags) {
+		return false;
+	}
+
+	bool touched = false;
+	for (auto& input : existing->inputs) {
+		int64_t time = modifiedTime(input.path);
+		if (time != -1 && time == input.modifiedTime && fileSize(input.path) == input.size) {
+			continue;
+		}
+		// The file was touched, or can only be checked by hash: compare its contents.
+		auto current = describe(input.path);
+		if (!current || current->size != input.size || current->hash != input.hash) {
+			std::cout << artifact.filename().string() << " is stale: " << input.path << " changed" << std::endl;
+			for (auto& other : dependents(artifact.parent_path(), input.path)) {
+				if (other.filename() != artifact.filename()) {
+					std::cout << "  which also invalidates " << other.filename().string() << std::endl;
+				}
+			}
+			return false;
+		}
+		if (current->modifiedTime != input.modifiedTime) {
+			input.modifiedTime = current->modifiedTime;
+			touched = true;
+		}
+	}
+	if (touched) {
+		record(artifact, *existing);
+	}
+	return true;
+}
+
+std::vector<std::filesystem::path> DependencyGraph::dependents(const std::filesystem::path& directory,
+	const std::string& path) {
+	std::vector<std::filesystem::path> artifacts;
+	std::error_code error;
+	for (auto& item : std::filesystem::directory_iterator(directory, error)) {
+		auto recordFile = item.path();
+		if (recordFile.extension() != RECORD_EXTENSION) {
+			continue;
+		}
+		auto artifact = recordFile;
+		artifact.replace_extension();
+		auto found = load(artifact);
+		if (!found) {
+			continue;
+		}
+		auto target = std::filesystem::path(path).lexically_normal();
+		bool uses = false;
+		for (auto& input : found->inputs) {
+			uses |= std::filesystem::path(input.path).lexically_normal() == target;
+		}
+		for (auto& reference : found->references) {
+			uses |= std::filesystem::path(reference).lexically_normal() == target;
+		}
+		if (uses) {
+			artifacts.push_back(artifact);
+		}
+	}
+	return artifacts;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief One input file of a cached artifact, as it was when the artifact was built.
+ */
+struct DependencyInput {
+	std::string path;
+	uint64_t size;
+	// The file's last write time; for an entry of the mounted asset pack, its stamp (see
+	// AssetPack::packedState); or -1 for inputs that are only checked by hash, such as bytes in memory.
+	int64_t modifiedTime;
+	uint64_t hash;
+};
+
+/**
+ * @brief What produced a cached artifact: the files whose contents were converted into it, the files
+ * it only refers to by path, and the import flags and converter version it was built with.
+ */
+struct DependencyRecord {
+	std::vector<DependencyInput> inputs;
+	// Files such as a model's textures, which are loaded separately. Editing them does not make the
+	// artifact stale, but they are recorded so the graph can tell which artifacts use them.
+	std::vector<std::string> references;
+	uint32_t importFlags = 0;
+	uint32_t converterVersion = 0;
+};
+
+/**
+ * @brief The dependency graph of the converted-asset caches. Every artifact has a record, stored
+ * beside it with a ".deps" extension, linking it to the files it was built from.
+ *
+ * Checking an artifact compares each input's size and last write time first, and only rehashes the
+ * inputs whose size or time changed; packed inputs are compared by their pack entry's stamp the same
+ * way. An input that was touched but not changed does not make the artifact stale; its record is
+ * updated so the next check is cheap again. When an input has changed, every other artifact in the
+ * same directory that uses it is reported as invalidated too.
+ */
+class DependencyGraph {
+public:
+	/**
+	 * @brief Describes the current state of an input file, hashing its contents.
+	 * @return nullopt if the file cannot be read.
+	 */
+	static std::optional<DependencyInput> describe(const std::string& path);
+
+	/**
+	 * @brief Writes the record for an artifact, replacing any previous one.
+	 * @return false if the record could not be written.
+	 */
+	static bool record(const std::filesystem::path& artifact, const DependencyRecord& record);
+
+	/**
+	 * @brief Reads the record for an artifact.
+	 * @return nullopt if the artifact has no readable record.
+	 */
+	static std::optional<DependencyRecord> load(const std::filesystem::path& artifact);
+
+	/**
+	 * @brief True if the artifact has a record with the given flags and converter version, and none
+	 * of its inputs have changed since it was built. Stale artifacts are logged with the reason, and
+	 * with the other artifacts the changed input invalidates (see dependents).
+	 */
+	static bool isUpToDate(const std::filesystem::path& artifact, uint32_t importFlags, uint32_t converterVersion);
+
+	/**
+	 * @brief The artifacts in a cache directory that use the given file, as an input or a reference.
+	 */
+	static std::vector<std::filesystem::path> dependents(const std::filesystem::path& directory,
+		const std::string& path);
+};
@@ -0,0 +1,552 @@
+#include "GltfImport.h"
+#include "AssetPack.h"
+#include "AssimpImport.h"
+#include "Json.h"
+#include "MaterialPacker.h"
+#include "MeshOptimizer.h"
+#include "ModelRegistry.h"
+#include "TextureLoader.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+
+namespace {
+	// glTF accessor component types and primitive modes, which share their values with OpenGL's.
+	const int64_t GLTF_UNSIGNED_BYTE = 5121;
+	const int64_t GLTF_UNSIGNED_SHORT = 5123;
+	const int64_t GLTF_UNSIGNED_INT = 5125;
+	const int64_t GLTF_FLOAT = 5126;
+	const int64_t GLTF_TRIANGLES = 4;
+
+	// The ModelRegistry key for natively-loaded glTF models. Assimp's flag sets always include
+	// several preset steps, so they never collide with these.
+	uint32_t nativeGltfFlags(bool flipTextureCoords) {
+		return flipTextureCoords ? 1 : 0;
+	}
+
+	/**
+	 * @brief Thrown for valid glTF files that use a feature the fast path does not handle.
+	 */
+	struct GltfUnsupported : public std::runtime_error {
+		using std::runtime_error::runtime_error;
+	};
+
+	/**
+	 * @brief The bytes of one glTF buffer: either a mapped (or packed) .bin file, or a decoded data: URI.
+	 */
+	struct GltfBuffer {
+		AssetBytes file;
+		std::vector<uint8_t> decoded;
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+	};
+
+	/**
+	 * @brief A span of a buffer holding one accessor's elements.
+	 */
+	struct AccessorRange {
+		const uint8_t* data;
+		size_t byteLength;
+		uint32_t stride;
+		size_t count;
+		int64_t componentType;
+	};
+
+	std::vector<uint8_t> decodeBase64(const std::string& text) {
+		auto value = [](char c) -> int {
+			if (c >= 'A' && c <= 'Z') { return c - 'A'; }
+			if (c >= 'a' && c <= 'z') { return c - 'a' + 26; }
+			if (c >= '0' && c <= '9') { return c - '0' + 52; }
+			if (c == '+' || c == '-') { return 62; }
+			if (c == '/' || c == '_') { return 63; }
+			return -1;
+		};
+		std::vector<uint8_t> out;
+		out.reserve(text.size() * 3 / 4);
+		uint32_t bits = 0;
+		int bitCount = 0;
+		for (char c : text) {
+			int v = value(c);
+			if (v < 0) {
+				continue;
+			}
+			bits = (bits << 6) | static_cast<uint32_t>(v);
+			bitCount += 6;
+			if (bitCount >= 8) {
+				bitCount -= 8;
+				out.push_back(static_cast<uint8_t>((bits >> bitCount) & 0xFF));
+			}
+		}
+		return out;
+	}
+
+	/**
+	 * @brief Decodes %XX escapes in a relative URI, so it can be used as a file path.
+	 */
+	std::string decodeUri(const std::string& uri) {
+		std::string out;
+		for (size_t i = 0; i < uri.size(); i++) {
+			if (uri[i] == '%' && i + 2 < uri.size()) {
+				out += static_cast<char>(std::stoi(uri.substr(i + 1, 2), nullptr, 16));
+				i += 2;
+			}
+			else {
+				out += uri[i];
+			}
+		}
+		return out;
+	}
+
+	size_t componentSize(int64_t componentType) {
+		switch (componentType) {
+		case GLTF_UNSIGNED_BYTE: return 1;
+		case GLTF_UNSIGNED_SHORT: return 2;
+		case GLTF_UNSIGNED_INT: return 4;
+		case GLTF_FLOAT: return 4;
+		default: throw GltfUnsupported("unsupported accessor component type");
+		}
+	}
+
+	size_t componentCount(const std::string& type) {
+		if (type == "SCALAR") { return 1; }
+		if (type == "VEC2") { return 2; }
+		if (type == "VEC3") { return 3; }
+		if (type == "VEC4") { return 4; }
+		throw GltfUnsupported("unsupported accessor type " + type);
+	}
+
+	/**
+	 * @brief Converts a glTF node's matrix, or its translation/rotation/scale, to a glm matrix.
+	 */
+	glm::mat4 nodeTransform(const JsonValue& node) {
+		glm::mat4 m(1);
+		if (node.has("matrix")) {
+			const JsonValue& matrix = node["matrix"];
+			// glTF matrices are column-major, like glm's.
+			for (auto col = 0; col < 4; col++) {
+				for (auto row = 0; row < 4; row++) {
+					m[col][row] = static_cast<float>(matrix[col * 4 + row].asNumber());
+				}
+			}
+			return m;
+		}
+		const JsonValue& t = node["translation"];
+		const JsonValue& r = node["rotation"];
+		const JsonValue& s = node["scale"];
+		float x = r[0].asNumber(0), y = r[1].asNumber(0), z = r[2].asNumber(0), w = r[3].asNumber(1);
+		float sx = s[0].asNumber(1), sy = s[1].asNumber(1), sz = s[2].asNumber(1);
+		// T * R * S, with R built from the unit quaternion (x, y, z, w).
+		m[0] = glm::vec4(1 - 2 * (y * y + z * z), 2 * (x * y + w * z), 2 * (x * z - w * y), 0) * sx;
+		m[1] = glm::vec4(2 * (x * y - w * z), 1 - 2 * (x * x + z * z), 2 * (y * z + w * x), 0) * sy;
+		m[2] = glm::vec4(2 * (x * z + w * y), 2 * (y * z - w * x), 1 - 2 * (x * x + y * y), 0) * sz;
+		m[3] = glm::vec4(t[0].asNumber(0), t[1].asNumber(0), t[2].asNumber(0), 1);
+		return m;
+	}
+
+	/**
+	 * @brief A parsed .gltf file and its mapped buffers.
+	 */
+	class GltfDocument {
+	private:
+		JsonValue m_json;
+		std::filesystem::path m_directory;
+		std::vector<std::unique_ptr<GltfBuffer>> m_buffers;
+
+	public:
+		explicit GltfDocument(const std::filesystem::path& path) : m_directory(path.parent_path()) {
+			auto file = AssetPack::open(path);
+			if (!file) {
+				throw std::runtime_error("Could not open glTF file " + path.string());
+			}
+			auto* text = reinterpret_cast<const char*>(file->data);
+			m_json = JsonValue::parse(text, text + file->size);
+
+			for (size_t i = 0; i < m_json["buffers"].size(); i++) {
+				const std::string& uri = m_json["buffers"][i]["uri"].asString();
+				auto buffer = std::make_unique<GltfBuffer>();
+				if (uri.rfind("data:", 0) == 0) {
+					buffer->decoded = decodeBase64(uri.substr(uri.find(',') + 1));
+					buffer->data = buffer->decoded.data();
+					buffer->size = buffer->decoded.size();
+				}
+				else {
+					auto bufferPath = m_directory / decodeUri(uri);
+					auto file = uri.empty() ? std::nullopt : AssetPack::open(bufferPath);
+					if (!file) {
+						throw std::runtime_error("Could not open glTF buffer " + bufferPath.string());
+					}
+					buffer->file = std::move(*file);
+					buffer->data = buffer->file.data;
+					buffer->size = buffer->file.size;
+				}
+				m_buffers.push_back(std::move(buffer));
+			}
+		}
+
+		const JsonValue& json() const {
+			return m_json;
+		}
+
+		/**
+		 * @brief Locates an accessor's elements in its mapped buffer, checking they are in bounds.
+		 */
+		AccessorRange accessor(int64_t index) const {
+			const JsonValue& accessor = m_json["accessors"][index];
+			if (accessor.isNull()) {
+				throw std::runtime_error("glTF accessor index out of range");
+			}
+			if (accessor.has("sparse") || !accessor.has("bufferView")) {
+				throw GltfUnsupported("sparse or buffer-less accessors");
+			}
+			const JsonValue& view = m_json["bufferViews"][accessor["bufferView"].asInt()];
+			int64_t bufferIndex = view["buffer"].asInt(-1);
+			if (bufferIndex < 0 || bufferIndex >= static_cast<int64_t>(m_buffers.size())) {
+				throw std::runtime_error("glTF buffer index out of range");
+			}
+			const GltfBuffer& buffer = *m_buffers[bufferIndex];
+
+			AccessorRange range;
+			range.componentType = accessor["componentType"].asInt();
+			range.count = static_cast<size_t>(accessor["count"].asInt());
+			size_t elementSize = componentSize(range.componentType) * componentCount(accessor["type"].asString());
+			range.stride = static_cast<uint32_t>(view["byteStride"].asInt(static_cast<int64_t>(elementSize)));
+			range.byteLength = range.count == 0 ? 0 : range.stride * (range.count - 1) + elementSize;
+			size_t start = static_cast<size_t>(view["byteOffset"].asInt(0) + accessor["byteOffset"].asInt(0));
+			size_t viewEnd = static_cast<size_t>(view["byteOffset"].asInt(0) + view["byteLength"].asInt(0));
+			if (start + range.byteLength > viewEnd || viewEnd > buffer.size) {
+				throw std::runtime_error("glTF accessor extends past its buffer");
+			}
+			range.data = buffer.data + start;
+			return range;
+		}
+
+		/**
+		 * @brief The image file behind a material's texture slot, such as "baseColorTexture".
+		 */
+		std::optional<std::string> texturePath(const JsonValue& textureInfo) const {
+			if (textureInfo.isNull()) {
+				return std::nullopt;
+			}
+			const JsonValue& texture = m_json["textures"][textureInfo["index"].asInt()];
+			const JsonValue& image = m_json["images"][texture["source"].asInt()];
+			const std::string& uri = image["uri"].asString();
+			if (uri.empty() || uri.rfind("data:", 0) == 0) {
+				throw GltfUnsupported("embedded images");
+			}
+			return (m_directory / decodeUri(uri)).string();
+		}
+	};
+
+	/**
+	 * @brief Reads a tightly-packed index accessor of any unsigned type, and writes indices back in that type.
+	 */
+	std::vector<uint32_t> readIndices(const AccessorRange& range) {
+		std::vector<uint32_t> indices(range.count);
+		for (size_t i = 0; i < range.count; i++) {
+			const uint8_t* element = range.data + i * range.stride;
+			if (range.componentType == GLTF_UNSIGNED_BYTE) {
+				indices[i] = *element;
+			}
+			else if (range.componentType == GLTF_UNSIGNED_SHORT) {
+				uint16_t index;
+				std::memcpy(&index, element, sizeof(index));
+				indices[i] = index;
+			}
+			else {
+				std::memcpy(&indices[i], element, sizeof(uint32_t));
+			}
+		}
+		return indices;
+	}
+
+	void writeIndices(const std::vector<uint32_t>& indices, int64_t componentType, uint8_t* out) {
+		size_t size = componentSize(componentType);
+		for (size_t i = 0; i < indices.size(); i++) {
+			if (componentType == GLTF_UNSIGNED_BYTE) {
+				out[i] = static_cast<uint8_t>(indices[i]);
+			}
+			else if (componentType == GLTF_UNSIGNED_SHORT) {
+				uint16_t index = static_cast<uint16_t>(indices[i]);
+				std::memcpy(out + i * size, &index, sizeof(index));
+			}
+			else {
+				std::memcpy(out + i * size, &indices[i], sizeof(uint32_t));
+			}
+		}
+	}
+
+	/**
+	 * @brief A triangle-list primitive whose accessors have been checked, ready to upload: its
+	 * attribute ranges in the mapped buffers, and its indices, reordered for the vertex cache.
+	 */
+	struct PreparedPrimitive {
+		// Position, normal, and texture coordinates. The coordinates are read from flippedUvs instead
+		// when it is not empty.
+		AccessorRange ranges[3];
+		std::vector<float> flippedUvs;
+		std::vector<uint8_t> indices;
+		size_t indexCount;
+		int64_t indexType;
+		// The index buffer's cache figures before and after reordering.
+		std::pair<CacheStats, CacheStats> cache;
+	};
+
+	/**
+	 * @brief Checks a primitive's accessors and prepares it for upload, without touching the GPU.
+	 * The triangles are reordered for the vertex cache with Tipsify, in the accessor's own index
+	 * type; the vertices keep the file's order, so optimizeMesh's overdraw and vertex fetch passes,
+	 * which move them, are left out.
+	 * @throws GltfUnsupported if the primitive uses a feature the fast path does not handle.
+	 */
+	PreparedPrimitive preparePrimitive(const GltfDocument& doc, const JsonValue& primitive, bool flipTextureCoords) {
+		if (primitive["mode"].asInt(GLTF_TRIANGLES) != GLTF_TRIANGLES) {
+			throw GltfUnsupported("primitives other than triangle lists");
+		}
+		const JsonValue& attributes = primitive["attributes"];
+		if (!attributes.has("POSITION") || !attributes.has("NORMAL") || !attributes.has("TEXCOORD_0")
+			|| !primitive.has("indices")) {
+			throw GltfUnsupported("primitives without normals, texture coordinates, or indices");
+		}
+		PreparedPrimitive prepared = { {
+			doc.accessor(attributes["POSITION"].asInt()),
+			doc.accessor(attributes["NORMAL"].asInt()),
+			doc.accessor(attributes["TEXCOORD_0"].asInt()),
+		} };
+		const AccessorRange* ranges = prepared.ranges;
+		AccessorRange indices = doc.accessor(primitive["indices"].asInt());
+		for (auto i = 0; i < 3; i++) {
+			if (ranges[i].componentType != GLTF_FLOAT || ranges[i].count != ranges[0].count) {
+				throw GltfUnsupported("non-float or mismatched vertex attributes");
+			}
+		}
+		if (indices.componentType == GLTF_FLOAT || indices.stride != componentSize(indices.componentType)) {
+			throw std::runtime_error("glTF indices must be tightly-packed unsigned integers");
+		}
+		std::vector<uint32_t> order = readIndices(indices);
+		if (order.size() % 3 != 0 || std::any_of(order.begin(), order.end(),
+			[&](uint32_t index) { return index >= ranges[0].count; })) {
+			throw std::runtime_error("glTF indices must form triangles of the primitive's vertices");
+		}
+		prepared.cache.first = measureVertexCache(order, ranges[0].count);
+		optimizeVertexCache(order, ranges[0].count);
+		prepared.cache.second = measureVertexCache(order, ranges[0].count);
+		prepared.indices.resize(indices.byteLength);
+		writeIndices(order, indices.componentType, prepared.indices.data());
+		prepared.indexCount = indices.count;
+		prepared.indexType = indices.componentType;
+
+		// Assimp flips glTF's texture coordinates on import, so only the flipped layout matches the
+		// file. The other one needs a converted copy of the coordinates.
+		if (!flipTextureCoords) {
+			prepared.flippedUvs.reserve(ranges[2].count * 2);
+			for (size_t i = 0; i < ranges[2].count; i++) {
+				const float* uv = reinterpret_cast<const float*>(ranges[2].data + i * ranges[2].stride);
+				prepared.flippedUvs.push_back(uv[0]);
+				prepared.flippedUvs.push_back(1 - uv[1]);
+			}
+		}
+		return prepared;
+	}
+
+	/**
+	 * @brief Creates the vertex array and buffers for a prepared primitive, copying each attribute's
+	 * accessor range straight out of the mapped buffer.
+	 */
+	std::shared_ptr<MeshGeometry> uploadPrimitive(const PreparedPrimitive& prepared) {
+		AccessorRange ranges[3] = { prepared.ranges[0], prepared.ranges[1], prepared.ranges[2] };
+		if (!prepared.flippedUvs.empty()) {
+			ranges[2].data = reinterpret_cast<const uint8_t*>(prepared.flippedUvs.data());
+			ranges[2].stride = 2 * sizeof(float);
+			ranges[2].byteLength = prepared.flippedUvs.size() * sizeof(float);
+		}
+
+		// The three attribute ranges sit back to back in one vertex buffer, each 4-byte aligned.
+		size_t offsets[3];
+		size_t total = 0;
+		for (auto i = 0; i < 3; i++) {
+			offsets[i] = total;
+			total += (ranges[i].byteLength + 3) & ~static_cast<size_t>(3);
+		}
+
+		auto geometry = std::make_shared<MeshGeometry>();
+		glGenVertexArrays(1, &geometry->vao);
+		uint32_t buffers[2];
+		glGenBuffers(2, buffers);
+		geometry->vbo = buffers[0];
+		geometry->ebo = buffers[1];
+		glBindVertexArray(geometry->vao);
+
+		glBindBuffer(GL_ARRAY_BUFFER, geometry->vbo);
+		glBufferData(GL_ARRAY_BUFFER, total, nullptr, GL_STATIC_DRAW);
+		const GLint componentsPerAttribute[3] = { 3, 3, 2 };
+		for (auto i = 0; i < 3; i++) {
+			glBufferSubData(GL_ARRAY_BUFFER, offsets[i], ranges[i].byteLength, ranges[i].data);
+			// Attributes 0, 1, and 2 are position, normal, and texture coordinates, as in Mesh3D.
+			glVertexAttribPointer(i, componentsPerAttribute[i], GL_FLOAT, false, ranges[i].stride, (void*)offsets[i]);
+			glEnableVertexAttribArray(i);
+		}
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry->ebo);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, prepared.indices.size(), prepared.indices.data(), GL_STATIC_DRAW);
+		glBindVertexArray(0);
+
+		geometry->vertexCount = ranges[0].count;
+		geometry->faceCount = prepared.indexCount;
+		geometry->indexType = static_cast<uint32_t>(prepared.indexType);
+		return geometry;
+	}
+
+	/**
+	 * @brief The texture references of a primitive's material, in the same order and with the same
+	 * sampler names that fromAssimpMesh gives Assimp's glTF materials. The metallic-roughness texture
+	 * is both the roughness and the metallic map, which packMaterialMaps reads from green and blue.
+	 */
+	std::vector<TextureRef> primitiveTextures(const GltfDocument& doc, const JsonValue& primitive) {
+		std::vector<TextureRef> refs;
+		if (!primitive.has("material")) {
+			return refs;
+		}
+		const JsonValue& material = doc.json()["materials"][primitive["material"].asInt()];
+		auto base = doc.texturePath(material["pbrMetallicRoughness"]["baseColorTexture"]);
+		if (base) {
+			refs.push_back({ *base, "baseTexture" });
+		}
+		auto normal = doc.texturePath(material["normalTexture"]);
+		if (normal) {
+			refs.push_back({ *normal, "normalMap" });
+		}
+		auto metallicRoughness = doc.texturePath(material["pbrMetallicRoughness"]["metallicRoughnessTexture"]);
+		if (metallicRoughness) {
+			refs.push_back({ *metallicRoughness, "roughnessMap" });
+			refs.push_back({ *metallicRoughness, "metallicMap" });
+		}
+		return refs;
+	}
+
+	/**
+	 * @brief Every primitive of a glTF file, checked and prepared for upload, and the textures of
+	 * each, with their material maps packed as the Assimp path packs them.
+	 */
+	struct GltfPrimitives {
+		// Each primitive's geometry, mesh by mesh.
+		std::vector<PreparedPrimitive> prepared;
+		// One MeshData per primitive, in the same order, holding only its texture references. Its
+		// embedded textures are the packed material maps' recipes, which are served while they are held.
+		ModelData materials;
+		// The index of each glTF mesh's first primitive.
+		std::vector<size_t> firstPrimitives;
+		std::unordered_map<std::filesystem::path, Texture, PathHash> loadedTextures;
+	};
+
+	/**
+	 * @brief Builds the Object3D for a glTF node and its descendants. Each glTF mesh is uploaded once,
+	 * and shared by every node that references it.
+	 */
+	Object3D buildGltfNode(const GltfDocument& doc, int64_t nodeIndex, const GltfPrimitives& model,
+		std::vector<std::optional<std::vector<Mesh3D>>>& meshes) {
+		const JsonValue& node = doc.json()["nodes"][nodeIndex];
+		if (node.isNull()) {
+			throw std::runtime_error("glTF node index out of range");
+		}
+
+		std::vector<Mesh3D> nodeMeshes;
+		if (node.has("mesh")) {
+			int64_t meshIndex = node["mesh"].asInt();
+			if (meshIndex < 0 || meshIndex >= static_cast<int64_t>(meshes.size())) {
+				throw std::runtime_error("glTF mesh index out of range");
+			}
+			if (!meshes[meshIndex]) {
+				// Like Assimp, each primitive of a glTF mesh becomes its own mesh.
+				std::vector<Mesh3D> primitives;
+				const JsonValue& gltfMesh = doc.json()["meshes"][meshIndex];
+				for (size_t p = 0; p < gltfMesh["primitives"].size(); p++) {
+					size_t primitive = model.firstPrimitives[meshIndex] + p;
+					std::vector<Texture> textures;
+					for (auto& ref : model.materials.meshes[primitive].textures) {
+						textures.push_back(Texture{ model.loadedTextures.at(loadedTextureKey(ref)).handle, ref.samplerName });
+					}
+					const PreparedPrimitive& prepared = model.prepared[primitive];
+					primitives.emplace_back(uploadPrimitive(prepared), std::move(textures));
+					std::cout << "Mesh " << meshIndex << " (" << gltfMesh["name"].asString() << ") primitive " << p
+						<< ": ACMR " << prepared.cache.first.acmr << " -> " << prepared.cache.second.acmr << ", ATVR "
+						<< prepared.cache.first.atvr << " -> " << prepared.cache.second.atvr << std::endl;
+				}
+				meshes[meshIndex] = std::move(primitives);
+			}
+			nodeMeshes = *meshes[meshIndex];
+		}
+
+		auto object = Object3D(std::move(nodeMeshes), nodeTransform(node));
+		object.setName(node["name"].asString());
+		const JsonValue& children = node["children"];
+		for (size_t i = 0; i < children.size(); i++) {
+			object.addChild(buildGltfNode(doc, children[i].asInt(), model, meshes));
+		}
+		return object;
+	}
+}
+
+Object3D gltfLoadDirect(const std::string& path, bool flipTextureCoords) {
+	GltfDocument doc(path);
+	const JsonValue& json = doc.json();
+
+	// Every primitive and its material are checked before any texture is loaded or anything is
+	// uploaded, so a model the fast path does not support is given up on before it costs anything.
+	GltfPrimitives model;
+	for (size_t m = 0; m < json["meshes"].size(); m++) {
+		model.firstPrimitives.push_back(model.prepared.size());
+		const JsonValue& primitives = json["meshes"][m]["primitives"];
+		for (size_t p = 0; p < primitives.size(); p++) {
+			model.prepared.push_back(preparePrimitive(doc, primitives[p], flipTextureCoords));
+			MeshData material;
+			material.textures = primitiveTextures(doc, primitives[p]);
+			model.materials.meshes.push_back(std::move(material));
+		}
+	}
+
+	// Pack every primitive's material maps and decode every texture up front on the thread pool,
+	// like the Assimp path does.
+	packMaterialMaps(model.materials, path);
+	std::vector<TextureRef> refs;
+	for (auto& material : model.materials.meshes) {
+		refs.insert(refs.end(), material.textures.begin(), material.textures.end());
+	}
+	loadTextures(refs, model.loadedTextures);
+
+	std::vector<std::optional<std::vector<Mesh3D>>> meshes(json["meshes"].size());
+	const JsonValue& scene = json["scenes"][json["scene"].asInt(0)];
+	const JsonValue& roots = scene["nodes"];
+	// Assimp uses a scene's only root node as the model's root, and otherwise adds a "ROOT" node.
+	if (roots.size() == 1) {
+		return buildGltfNode(doc, roots[0].asInt(), model, meshes);
+	}
+	auto root = Object3D(std::vector<Mesh3D>{}, glm::mat4(1));
+	root.setName("ROOT");
+	for (size_t i = 0; i < roots.size(); i++) {
+		root.addChild(buildGltfNode(doc, roots[i].asInt(), model, meshes));
+	}
+	return root;
+}
+
+Object3D gltfLoad(const std::string& path, bool flipTextureCoords) {
+	auto flags = nativeGltfFlags(flipTextureCoords);
+	auto instance = ModelRegistry::find(path, flags);
+	if (instance) {
+		return std::move(*instance);
+	}
+
+	std::optional<Object3D> model;
+	try {
+		model.emplace(gltfLoadDirect(path, flipTextureCoords));
+	}
+	catch (GltfUnsupported& e) {
+		std::cerr << "Loading " << path << " with Assimp; the glTF fast path does not support " << e.what() << std::endl;
+		model.emplace(assimpLoad(path, flipTextureCoords));
+	}
+	// Models the fast path gave up on are registered under its key too, so it is tried only once.
+	ModelRegistry::insert(path, flags, *model);
+	return std::move(*model);
+}
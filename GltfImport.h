@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+#include "Object3D.h"
+
+/**
+ * @brief Loads a glTF 2.0 model without going through Assimp. The model's .bin buffers are
+ * memory-mapped, and the position, normal, and texture coordinate accessors of each primitive are
+ * copied straight from the mapping into GL buffers, described by the accessors' own offsets and
+ * strides. Only the index buffers are rewritten, reordered for the vertex cache; the vertices keep
+ * the file's order, so the overdraw and vertex fetch passes of Assimp imports are skipped.
+ * The resulting hierarchy has the same nodes, names, and transformations as assimpLoad's.
+ * Models using features the fast path does not handle (sparse accessors, non-float attributes,
+ * primitives other than triangle lists, missing normals or texture coordinates, embedded images)
+ * fall back to assimpLoad. Every primitive is checked before any texture or buffer is loaded, and
+ * the fallback's result is registered under the fast path's key, so it is only tried once.
+ */
+Object3D gltfLoad(const std::string& path, bool flipTextureCoords);
+
+/**
+ * @brief Loads a glTF 2.0 model like gltfLoad, but without consulting or updating the ModelRegistry.
+ * @throws std::runtime_error if the model cannot be loaded by the fast path.
+ */
+Object3D gltfLoadDirect(const std::string& path, bool flipTextureCoords);
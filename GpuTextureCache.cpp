@@ -0,0 +1,271 @@
+#include "GpuTextureCache.h"
+#include "MappedFile.h"
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace {
+	const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	/**
+	 * @brief The KTX2 header and index that follow the identifier. The 64-bit supercompression
+	 * global data fields are split in two, so the struct has no padding.
+	 */
+	struct Ktx2Header {
+		uint32_t vkFormat;
+		uint32_t typeSize;
+		uint32_t pixelWidth;
+		uint32_t pixelHeight;
+		uint32_t pixelDepth;
+		uint32_t layerCount;
+		uint32_t faceCount;
+		uint32_t levelCount;
+		uint32_t supercompressionScheme;
+		uint32_t dfdByteOffset;
+		uint32_t dfdByteLength;
+		uint32_t kvdByteOffset;
+		uint32_t kvdByteLength;
+		uint32_t sgdByteOffset[2];
+		uint32_t sgdByteLength[2];
+	};
+
+	struct Ktx2Level {
+		uint64_t byteOffset;
+		uint64_t byteLength;
+		uint64_t uncompressedByteLength;
+	};
+
+	const size_t LEVEL_INDEX_OFFSET = sizeof(KTX2_IDENTIFIER) + sizeof(Ktx2Header);
+	static_assert(LEVEL_INDEX_OFFSET == 80, "The KTX2 level index starts at byte 80");
+
+	std::filesystem::path cacheDirectory = "../cache/textures";
+
+	/**
+	 * @brief The VkFormat that KTX2 identifies each format by.
+	 */
+	uint32_t vkFormat(BlockFormat format) {
+		switch (format) {
+		case BlockFormat::RGBA8: return 37;  // VK_FORMAT_R8G8B8A8_UNORM
+		case BlockFormat::BC1: return 131;   // VK_FORMAT_BC1_RGB_UNORM_BLOCK
+		case BlockFormat::BC3: return 137;   // VK_FORMAT_BC3_UNORM_BLOCK
+		case BlockFormat::BC4: return 139;   // VK_FORMAT_BC4_UNORM_BLOCK
+		case BlockFormat::BC5: return 141;   // VK_FORMAT_BC5_UNORM_BLOCK
+		case BlockFormat::BC7: return 145;   // VK_FORMAT_BC7_UNORM_BLOCK
+		}
+		return 0;
+	}
+
+	std::optional<BlockFormat> blockFormat(uint32_t vkFormat) {
+		for (auto format : { BlockFormat::RGBA8, BlockFormat::BC1, BlockFormat::BC3, BlockFormat::BC4,
+			BlockFormat::BC5, BlockFormat::BC7 }) {
+			if (::vkFormat(format) == vkFormat) {
+				return format;
+			}
+		}
+		return std::nullopt;
+	}
+
+	/**
+	 * @brief The basic data format descriptor that KTX2 requires alongside the VkFormat, describing
+	 * the texel block's colour model and where each channel's bits are.
+	 */
+	std::vector<uint32_t> dataFormatDescriptor(BlockFormat format) {
+		struct Sample {
+			uint32_t bitOffset;
+			uint32_t bitLength;
+			uint32_t channel;
+			uint32_t upper;
+		};
+		const uint32_t BLOCK = 0xFFFFFFFF;
+		uint32_t colorModel;
+		std::vector<Sample> samples;
+		switch (format) {
+		case BlockFormat::RGBA8:
+			colorModel = 1;  // KHR_DF_MODEL_RGBSDA
+			samples = { { 0, 8, 0, 255 }, { 8, 8, 1, 255 }, { 16, 8, 2, 255 }, { 24, 8, 15, 255 } };
+			break;
+		case BlockFormat::BC1:
+			colorModel = 128;
+			samples = { { 0, 64, 0, BLOCK } };
+			break;
+		case BlockFormat::BC3:
+			colorModel = 130;
+			samples = { { 0, 64, 15, BLOCK }, { 64, 64, 0, BLOCK } };
+			break;
+		case BlockFormat::BC4:
+			colorModel = 131;
+			samples = { { 0, 64, 0, BLOCK } };
+			break;
+		case BlockFormat::BC5:
+			colorModel = 132;
+			samples = { { 0, 64, 0, BLOCK }, { 64, 64, 1, BLOCK } };
+			break;
+		case BlockFormat::BC7:
+		default:
+			colorModel = 134;
+			samples = { { 0, 128, 0, BLOCK } };
+			break;
+		}
+		bool compressed = format != BlockFormat::RGBA8;
+		uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+		std::vector<uint32_t> words = {
+			4 + blockSize,
+			// Khronos vendor, basic descriptor type; version 2 and the block's size.
+			0,
+			2 | blockSize << 16,
+			// Colour model, BT.709 primaries, linear transfer, straight alpha.
+			colorModel | 1 << 8 | 1 << 16,
+			// Texel block dimensions, less one.
+			compressed ? 3u | 3u << 8 : 0u,
+			// Bytes in the block's only plane.
+			static_cast<uint32_t>(blockBytes(format)),
+			0,
+		};
+		for (auto& sample : samples) {
+			words.push_back(sample.bitOffset | (sample.bitLength - 1) << 16 | sample.channel << 24);
+			words.push_back(0);
+			words.push_back(0);
+			words.push_back(sample.upper);
+		}
+		return words;
+	}
+}
+
+const std::filesystem::path& GpuTextureCache::directory() {
+	return cacheDirectory;
+}
+
+void GpuTextureCache::setDirectory(const std::filesystem::path& directory) {
+	cacheDirectory = directory;
+}
+
+std::filesystem::path GpuTextureCache::entryPath(uint64_t fileHash, TextureUsage usage,
+	const BlockFormatSupport& support) {
+	// One bit per block format the GPU supports, since those decide which format the texture targets.
+	uint32_t formats = 0;
+	for (auto format : { BlockFormat::BC1, BlockFormat::BC3, BlockFormat::BC4, BlockFormat::BC5, BlockFormat::BC7 }) {
+		if (support.supports(format)) {
+			formats |= 1u << static_cast<uint32_t>(format);
+		}
+	}
+	std::ostringstream name;
+	name << std::hex << std::setw(16) << std::setfill('0') << fileHash << "-" << textureUsageName(usage)
+		<< "-f" << std::setw(2) << formats << "-v" << std::dec << VERSION << ".ktx2";
+	return cacheDirectory / name.str();
+}
+
+std::vector<uint8_t> GpuTextureCache::encodeKtx2(const GpuTexture& texture) {
+	auto dfd = dataFormatDescriptor(texture.format);
+	Ktx2Header header = {};
+	header.vkFormat = vkFormat(texture.format);
+	header.typeSize = 1;
+	header.pixelWidth = texture.width();
+	header.pixelHeight = texture.height();
+	header.faceCount = 1;
+	header.levelCount = static_cast<uint32_t>(texture.levels.size());
+	header.dfdByteOffset = static_cast<uint32_t>(LEVEL_INDEX_OFFSET + sizeof(Ktx2Level) * texture.levels.size());
+	header.dfdByteLength = static_cast<uint32_t>(dfd.size() * sizeof(uint32_t));
+
+	// Each level starts on a multiple of its block size, which is always a multiple of 4.
+	size_t alignment = blockBytes(texture.format) % 4 == 0 ? blockBytes(texture.format) : 4;
+	std::vector<Ktx2Level> levels(texture.levels.size());
+	size_t offset = header.dfdByteOffset + header.dfdByteLength;
+	for (size_t l = texture.levels.size(); l-- > 0;) {
+		offset = (offset + alignment - 1) / alignment * alignment;
+		levels[l] = { offset, texture.levels[l].size, texture.levels[l].size };
+		offset += texture.levels[l].size;
+	}
+
+	std::vector<uint8_t> file(offset);
+	memcpy(file.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+	memcpy(file.data() + sizeof(KTX2_IDENTIFIER), &header, sizeof(header));
+	memcpy(file.data() + LEVEL_INDEX_OFFSET, levels.data(), sizeof(Ktx2Level) * levels.size());
+	memcpy(file.data() + header.dfdByteOffset, dfd.data(), header.dfdByteLength);
+	for (size_t l = 0; l < levels.size(); l++) {
+		memcpy(file.data() + levels[l].byteOffset, texture.levels[l].data, texture.levels[l].size);
+	}
+	return file;
+}
+
+std::optional<GpuTexture> GpuTextureCache::decodeKtx2(const uint8_t* data, size_t size,
+	std::shared_ptr<const void> storage) {
+	if (size < LEVEL_INDEX_OFFSET || memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+		return std::nullopt;
+	}
+	Ktx2Header header;
+	memcpy(&header, data + sizeof(KTX2_IDENTIFIER), sizeof(header));
+	auto format = blockFormat(header.vkFormat);
+	// Only single 2D images with a stored mip chain, as encodeKtx2 writes them.
+	if (!format || header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth != 0
+		|| header.layerCount != 0 || header.faceCount != 1 || header.supercompressionScheme != 0
+		|| header.levelCount == 0 || header.levelCount > 32
+		|| size < LEVEL_INDEX_OFFSET + sizeof(Ktx2Level) * header.levelCount) {
+		return std::nullopt;
+	}
+
+	GpuTexture texture;
+	texture.format = *format;
+	texture.storage = std::move(storage);
+	for (uint32_t l = 0; l < header.levelCount; l++) {
+		Ktx2Level level;
+		memcpy(&level, data + LEVEL_INDEX_OFFSET + sizeof(Ktx2Level) * l, sizeof(level));
+		uint32_t width = std::max(1u, header.pixelWidth >> l);
+		uint32_t height = std::max(1u, header.pixelHeight >> l);
+		if (level.byteLength != levelBytes(*format, width, height) || level.byteOffset > size
+			|| level.byteLength > size - level.byteOffset) {
+			return std::nullopt;
+		}
+		texture.levels.push_back({ width, height, data + level.byteOffset, static_cast<size_t>(level.byteLength) });
+	}
+	return texture;
+}
+
+std::optional<GpuTexture> GpuTextureCache::load(uint64_t fileHash, TextureUsage usage,
+	const BlockFormatSupport& support) {
+	auto file = std::make_shared<MappedFile>();
+	if (!file->open(entryPath(fileHash, usage, support).string())) {
+		return std::nullopt;
+	}
+	auto texture = decodeKtx2(file->data(), file->size(), file);
+	if (!texture) {
+		std::cerr << "Ignoring corrupt texture cache entry " << entryPath(fileHash, usage, support) << std::endl;
+		return std::nullopt;
+	}
+	// The key already names the formats the GPU supports; this guards against a misnamed file.
+	if (!support.supports(texture->format)) {
+		return std::nullopt;
+	}
+	return texture;
+}
+
+bool GpuTextureCache::store(uint64_t fileHash, TextureUsage usage, const BlockFormatSupport& support,
+	const GpuTexture& texture) {
+	auto bytes = encodeKtx2(texture);
+
+	// Textures are stored from worker threads, so each writes its own temporary file, which is
+	// renamed over the entry so a reader never maps a half-written file.
+	std::error_code error;
+	std::filesystem::create_directories(cacheDirectory, error);
+	auto path = entryPath(fileHash, usage, support);
+	auto tempPath = path;
+	tempPath += "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+		if (!out) {
+			std::cerr << "Could not write texture cache entry " << path << std::endl;
+			return false;
+		}
+	}
+	std::filesystem::rename(tempPath, path, error);
+	if (error) {
+		std::cerr << "Could not write texture cache entry " << path << ": " << error.message() << std::endl;
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	return true;
+}
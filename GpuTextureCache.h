@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <vector>
+#include "BlockCompression.h"
+
+/**
+ * @brief An on-disk cache of textures already in the form the GPU samples them, so warm starts
+ * skip both decoding image files and compressing them. Entries are KTX2 files, keyed by the hash
+ * of the source image file's bytes, the usage the texture was compressed for, and the block formats
+ * the GPU could sample, which together decide the format it was compressed to. An edited image has
+ * a new hash, so entries never go stale, and a texture that fell back to RGBA8 on one GPU is
+ * compressed again on a GPU that supports its block format. Safe to use from any thread.
+ */
+class GpuTextureCache {
+public:
+	/**
+	 * @brief Bumped whenever the encoders or the mipmap filter change, so textures are compressed again.
+	 */
+	static const uint32_t VERSION = 2;
+
+	/**
+	 * @brief Maps the entry for an image file and usage, compressed for a GPU with the given support.
+	 * @return an empty optional if there is none, it is corrupt, or the GPU cannot sample its format.
+	 */
+	static std::optional<GpuTexture> load(uint64_t fileHash, TextureUsage usage, const BlockFormatSupport& support);
+
+	/**
+	 * @brief Writes the entry for an image file and usage, compressed for a GPU with the given
+	 * support, replacing any existing one.
+	 * @return false if the entry could not be written.
+	 */
+	static bool store(uint64_t fileHash, TextureUsage usage, const BlockFormatSupport& support, const GpuTexture& texture);
+
+	/**
+	 * @brief The directory that entries are written to. Defaults to "../cache/textures".
+	 */
+	static const std::filesystem::path& directory();
+	static void setDirectory(const std::filesystem::path& directory);
+
+	/**
+	 * @brief Lays a texture out as a KTX2 file, with its levels stored smallest first as KTX2 requires.
+	 */
+	static std::vector<uint8_t> encodeKtx2(const GpuTexture& texture);
+
+	/**
+	 * @brief Reads a KTX2 file written by encodeKtx2. The texture's levels point into the bytes,
+	 * which the storage must keep alive.
+	 * @return an empty optional if the file is malformed or in a format this renderer does not use.
+	 */
+	static std::optional<GpuTexture> decodeKtx2(const uint8_t* data, size_t size, std::shared_ptr<const void> storage);
+
+private:
+	static std::filesystem::path entryPath(uint64_t fileHash, TextureUsage usage, const BlockFormatSupport& support);
+};
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+const uint64_t FNV_PRIME = 1099511628211ull;
+
+/**
+ * @brief Computes the 64-bit FNV-1a hash of a block of bytes. Pass a previous result as the
+ * seed to continue hashing across several blocks.
+ */
+inline uint64_t fnv1a64(const void* data, size_t size, uint64_t seed = FNV_OFFSET_BASIS) {
+	auto* bytes = static_cast<const uint8_t*>(data);
+	uint64_t hash = seed;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
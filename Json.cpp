@@ -0,0 +1,293 @@
+#include "Json.h"
+#include <cstdint>
+#include <cctype>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace {
+	const JsonValue NULL_VALUE;
+	const std::string EMPTY_STRING;
+}
+
+/**
+ * @brief A recursive-descent parser over a block of JSON text.
+ */
+class JsonParser {
+private:
+	const char* m_cursor;
+	const char* m_end;
+
+	[[noreturn]] void fail(const std::string& message) {
+		throw std::runtime_error("Invalid JSON: " + message);
+	}
+
+	void skipWhitespace() {
+		while (m_cursor < m_end && (*m_cursor == ' ' || *m_cursor == '\t' || *m_cursor == '\n' || *m_cursor == '\r')) {
+			m_cursor++;
+		}
+	}
+
+	char peek() {
+		skipWhitespace();
+		if (m_cursor >= m_end) {
+			fail("unexpected end of document");
+		}
+		return *m_cursor;
+	}
+
+	void expect(char c) {
+		if (peek() != c) {
+			fail(std::string("expected '") + c + "'");
+		}
+		m_cursor++;
+	}
+
+	void expectLiteral(const char* literal) {
+		for (const char* p = literal; *p != '\0'; p++, m_cursor++) {
+			if (m_cursor >= m_end || *m_cursor != *p) {
+				fail(std::string("expected ") + literal);
+			}
+		}
+	}
+
+	static void appendUtf8(std::string& out, uint32_t codepoint) {
+		if (codepoint < 0x80) {
+			out += static_cast<char>(codepoint);
+		}
+		else if (codepoint < 0x800) {
+			out += static_cast<char>(0xC0 | (codepoint >> 6));
+			out += static_cast<char>(0x80 | (codepoint & 0x3F));
+		}
+		else if (codepoint < 0x10000) {
+			out += static_cast<char>(0xE0 | (codepoint >> 12));
+			out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (codepoint & 0x3F));
+		}
+		else {
+			out += static_cast<char>(0xF0 | (codepoint >> 18));
+			out += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+			out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (codepoint & 0x3F));
+		}
+	}
+
+	uint32_t parseHex4() {
+		if (m_end - m_cursor < 4) {
+			fail("truncated unicode escape");
+		}
+		uint32_t value = 0;
+		for (int i = 0; i < 4; i++, m_cursor++) {
+			char c = *m_cursor;
+			value <<= 4;
+			if (c >= '0' && c <= '9') { value |= c - '0'; }
+			else if (c >= 'a' && c <= 'f') { value |= c - 'a' + 10; }
+			else if (c >= 'A' && c <= 'F') { value |= c - 'A' + 10; }
+			else { fail("bad unicode escape"); }
+		}
+		return value;
+	}
+
+	std::string parseString() {
+		expect('"');
+		std::string out;
+		while (true) {
+			if (m_cursor >= m_end) {
+				fail("unterminated string");
+			}
+			char c = *m_cursor++;
+			if (c == '"') {
+				return out;
+			}
+			if (c != '\\') {
+				out += c;
+				continue;
+			}
+			if (m_cursor >= m_end) {
+				fail("unterminated string");
+			}
+			char escape = *m_cursor++;
+			switch (escape) {
+			case '"': out += '"'; break;
+			case '\\': out += '\\'; break;
+			case '/': out += '/'; break;
+			case 'b': out += '\b'; break;
+			case 'f': out += '\f'; break;
+			case 'n': out += '\n'; break;
+			case 'r': out += '\r'; break;
+			case 't': out += '\t'; break;
+			case 'u': {
+				uint32_t codepoint = parseHex4();
+				// Characters outside the basic plane are escaped as a surrogate pair.
+				if (codepoint >= 0xD800 && codepoint < 0xDC00 && m_end - m_cursor >= 6
+					&& m_cursor[0] == '\\' && m_cursor[1] == 'u') {
+					m_cursor += 2;
+					uint32_t low = parseHex4();
+					codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+				}
+				appendUtf8(out, codepoint);
+				break;
+			}
+			default:
+				fail("bad escape sequence");
+			}
+		}
+	}
+
+	double parseNumber() {
+		// strtod needs a terminated string; numbers are short, so copy the candidate characters.
+		const char* start = m_cursor;
+		while (m_cursor < m_end && (std::isdigit(static_cast<unsigned char>(*m_cursor)) || *m_cursor == '-'
+			|| *m_cursor == '+' || *m_cursor == '.' || *m_cursor == 'e' || *m_cursor == 'E')) {
+			m_cursor++;
+		}
+		std::string text(start, m_cursor);
+		char* parsedEnd = nullptr;
+		double value = std::strtod(text.c_str(), &parsedEnd);
+		if (text.empty() || parsedEnd != text.c_str() + text.size()) {
+			fail("bad number");
+		}
+		return value;
+	}
+
+public:
+	JsonParser(const char* begin, const char* end) : m_cursor(begin), m_end(end) {}
+
+	JsonValue parseValue() {
+		JsonValue value;
+		char c = peek();
+		if (c == '{') {
+			m_cursor++;
+			value.m_type = JsonValue::Type::Object;
+			if (peek() == '}') {
+				m_cursor++;
+				return value;
+			}
+			while (true) {
+				value.m_keys.push_back(parseString());
+				expect(':');
+				value.m_values.push_back(parseValue());
+				if (peek() == ',') {
+					m_cursor++;
+					continue;
+				}
+				expect('}');
+				return value;
+			}
+		}
+		if (c == '[') {
+			m_cursor++;
+			value.m_type = JsonValue::Type::Array;
+			if (peek() == ']') {
+				m_cursor++;
+				return value;
+			}
+			while (true) {
+				value.m_values.push_back(parseValue());
+				if (peek() == ',') {
+					m_cursor++;
+					continue;
+				}
+				expect(']');
+				return value;
+			}
+		}
+		if (c == '"') {
+			value.m_type = JsonValue::Type::String;
+			value.m_string = parseString();
+			return value;
+		}
+		if (c == 't') {
+			expectLiteral("true");
+			value.m_type = JsonValue::Type::Bool;
+			value.m_bool = true;
+			return value;
+		}
+		if (c == 'f') {
+			expectLiteral("false");
+			value.m_type = JsonValue::Type::Bool;
+			value.m_bool = false;
+			return value;
+		}
+		if (c == 'n') {
+			expectLiteral("null");
+			return value;
+		}
+		value.m_type = JsonValue::Type::Number;
+		value.m_number = parseNumber();
+		return value;
+	}
+
+	void finish() {
+		skipWhitespace();
+		if (m_cursor != m_end) {
+			fail("unexpected text after document");
+		}
+	}
+};
+
+JsonValue::JsonValue() : m_type(Type::Null), m_bool(false), m_number(0) {}
+
+JsonValue JsonValue::parse(const char* begin, const char* end) {
+	JsonParser parser(begin, end);
+	JsonValue value = parser.parseValue();
+	parser.finish();
+	return value;
+}
+
+JsonValue::Type JsonValue::type() const {
+	return m_type;
+}
+
+bool JsonValue::isNull() const {
+	return m_type == Type::Null;
+}
+
+bool JsonValue::has(const std::string& key) const {
+	if (m_type != Type::Object) {
+		return false;
+	}
+	for (auto& k : m_keys) {
+		if (k == key) {
+			return true;
+		}
+	}
+	return false;
+}
+
+const JsonValue& JsonValue::operator[](const std::string& key) const {
+	if (m_type == Type::Object) {
+		for (size_t i = 0; i < m_keys.size(); i++) {
+			if (m_keys[i] == key) {
+				return m_values[i];
+			}
+		}
+	}
+	return NULL_VALUE;
+}
+
+const JsonValue& JsonValue::operator[](size_t index) const {
+	if (m_type == Type::Array && index < m_values.size()) {
+		return m_values[index];
+	}
+	return NULL_VALUE;
+}
+
+size_t JsonValue::size() const {
+	return m_type == Type::Array || m_type == Type::Object ? m_values.size() : 0;
+}
+
+bool JsonValue::asBool(bool fallback) const {
+	return m_type == Type::Bool ? m_bool : fallback;
+}
+
+double JsonValue::asNumber(double fallback) const {
+	return m_type == Type::Number ? m_number : fallback;
+}
+
+int64_t JsonValue::asInt(int64_t fallback) const {
+	return m_type == Type::Number ? static_cast<int64_t>(m_number) : fallback;
+}
+
+const std::string& JsonValue::asString() const {
+	return m_type == Type::String ? m_string : EMPTY_STRING;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A parsed JSON value. Only as much of JSON as asset formats like glTF need: objects keep their
+ * keys in document order, and numbers are stored as doubles.
+ */
+class JsonValue {
+public:
+	enum class Type { Null, Bool, Number, String, Array, Object };
+
+private:
+	Type m_type;
+	bool m_bool;
+	double m_number;
+	std::string m_string;
+	// Array elements, or object values in the same order as m_keys.
+	std::vector<JsonValue> m_values;
+	std::vector<std::string> m_keys;
+
+	friend class JsonParser;
+
+public:
+	JsonValue();
+
+	/**
+	 * @brief Parses a complete JSON document.
+	 * @throws std::runtime_error if the text is not valid JSON.
+	 */
+	static JsonValue parse(const char* begin, const char* end);
+
+	Type type() const;
+	bool isNull() const;
+
+	/**
+	 * @brief True if this is an object with the given key.
+	 */
+	bool has(const std::string& key) const;
+
+	/**
+	 * @brief The value for a key of an object, or a null value if there is no such key.
+	 */
+	const JsonValue& operator[](const std::string& key) const;
+
+	/**
+	 * @brief An element of an array, or a null value if the index is out of range.
+	 */
+	const JsonValue& operator[](size_t index) const;
+
+	/**
+	 * @brief The number of elements of an array or members of an object.
+	 */
+	size_t size() const;
+
+	// Conversions, which return the given fallback if the value has a different type.
+	bool asBool(bool fallback = false) const;
+	double asNumber(double fallback = 0) const;
+	int64_t asInt(int64_t fallback = 0) const;
+	const std::string& asString() const;
+};
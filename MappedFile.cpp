@@ -0,0 +1,138 @@
+#include "MappedFile.h"
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile() : m_data(nullptr), m_size(0), m_file(nullptr), m_mapping(nullptr) {}
+#else
+MappedFile::MappedFile() : m_data(nullptr), m_size(0), m_fd(-1) {}
+#endif
+
+MappedFile::~MappedFile() {
+	release();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept : MappedFile() {
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+	if (this != &other) {
+		release();
+		std::swap(m_data, other.m_data);
+		std::swap(m_size, other.m_size);
+#ifdef _WIN32
+		std::swap(m_file, other.m_file);
+		std::swap(m_mapping, other.m_mapping);
+#else
+		std::swap(m_fd, other.m_fd);
+#endif
+	}
+	return *this;
+}
+
+bool MappedFile::open(const std::string& path) {
+	release();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size)) {
+		CloseHandle(file);
+		return false;
+	}
+	m_file = file;
+	m_size = static_cast<size_t>(size.QuadPart);
+	if (m_size == 0) {
+		// Empty files cannot be mapped, but are still valid (empty) views.
+		return true;
+	}
+	m_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mapping == nullptr) {
+		release();
+		return false;
+	}
+	m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		::close(fd);
+		return false;
+	}
+	m_fd = fd;
+	m_size = static_cast<size_t>(st.st_size);
+	if (m_size == 0) {
+		return true;
+	}
+	void* mapped = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (mapped == MAP_FAILED) {
+		release();
+		return false;
+	}
+	m_data = static_cast<const uint8_t*>(mapped);
+#endif
+	if (m_data == nullptr) {
+		release();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::release() {
+#ifdef _WIN32
+	if (m_data != nullptr) {
+		UnmapViewOfFile(m_data);
+	}
+	if (m_mapping != nullptr) {
+		CloseHandle(m_mapping);
+	}
+	if (m_file != nullptr) {
+		CloseHandle(m_file);
+	}
+	m_mapping = nullptr;
+	m_file = nullptr;
+#else
+	if (m_data != nullptr) {
+		munmap(const_cast<uint8_t*>(m_data), m_size);
+	}
+	if (m_fd >= 0) {
+		::close(m_fd);
+	}
+	m_fd = -1;
+#endif
+	m_data = nullptr;
+	m_size = 0;
+}
+
+bool MappedFile::isOpen() const {
+#ifdef _WIN32
+	return m_file != nullptr;
+#else
+	return m_fd >= 0;
+#endif
+}
+
+const uint8_t* MappedFile::data() const {
+	return m_data;
+}
+
+size_t MappedFile::size() const {
+	return m_size;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief A read-only view of a file's contents, memory-mapped into the address space of the process.
+ * The mapping is released when the MappedFile is destroyed.
+ */
+class MappedFile {
+private:
+	const uint8_t* m_data;
+	size_t m_size;
+#ifdef _WIN32
+	void* m_file;
+	void* m_mapping;
+#else
+	int m_fd;
+#endif
+
+	void release();
+
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	/**
+	 * @brief Maps the file at the given path, releasing any previous mapping.
+	 * @return false if the file could not be opened or mapped.
+	 */
+	bool open(const std::string& path);
+
+	bool isOpen() const;
+	const uint8_t* data() const;
+	size_t size() const;
+};
@@ -0,0 +1,87 @@
+#include "MappedIOSystem.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+MappedIOStream::MappedIOStream(AssetBytes file) : m_file(std::move(file)), m_position(0) {}
+
+size_t MappedIOStream::Read(void* buffer, size_t size, size_t count) {
+	if (size == 0) {
+		return 0;
+	}
+	// Like fread, only whole elements are read.
+	size_t elements = std::min(count, (m_file.size - m_position) / size);
+	std::memcpy(buffer, m_file.data + m_position, elements * size);
+	m_position += elements * size;
+	return elements;
+}
+
+size_t MappedIOStream::Write(const void* /*buffer*/, size_t /*size*/, size_t /*count*/) {
+	return 0;
+}
+
+aiReturn MappedIOStream::Seek(size_t offset, aiOrigin origin) {
+	// As with fseek, which Assimp's default stream calls, the offset is added to the origin. A
+	// negative offset arrives converted to size_t, so the unsigned sum wraps around to the target,
+	// and a target before the start wraps past the end of the file.
+	size_t target;
+	if (origin == aiOrigin_SET) {
+		target = offset;
+	}
+	else if (origin == aiOrigin_CUR) {
+		target = m_position + offset;
+	}
+	else {
+		target = m_file.size + offset;
+	}
+	if (target > m_file.size) {
+		return aiReturn_FAILURE;
+	}
+	m_position = target;
+	return aiReturn_SUCCESS;
+}
+
+size_t MappedIOStream::Tell() const {
+	return m_position;
+}
+
+size_t MappedIOStream::FileSize() const {
+	return m_file.size;
+}
+
+void MappedIOStream::Flush() {}
+
+bool MappedIOSystem::Exists(const char* path) const {
+	std::error_code error;
+	return AssetPack::contains(path) || std::filesystem::is_regular_file(path, error);
+}
+
+char MappedIOSystem::getOsSeparator() const {
+#ifdef _WIN32
+	return '\\';
+#else
+	return '/';
+#endif
+}
+
+Assimp::IOStream* MappedIOSystem::Open(const char* path, const char* mode) {
+	if (std::strchr(mode, 'w') != nullptr || std::strchr(mode, 'a') != nullptr) {
+		return nullptr;
+	}
+	auto file = AssetPack::open(path);
+	if (!file) {
+		return nullptr;
+	}
+	if (std::find(m_openedPaths.begin(), m_openedPaths.end(), path) == m_openedPaths.end()) {
+		m_openedPaths.push_back(path);
+	}
+	return new MappedIOStream(std::move(*file));
+}
+
+const std::vector<std::string>& MappedIOSystem::openedPaths() const {
+	return m_openedPaths;
+}
+
+void MappedIOSystem::Close(Assimp::IOStream* stream) {
+	delete stream;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+#include "AssetPack.h"
+#include <string>
+#include <vector>
+
+/**
+ * @brief An Assimp file stream over a memory-mapped file or asset pack entry. Reads copy straight out
+ * of memory, with no stdio buffer in between and no read() syscalls.
+ */
+class MappedIOStream : public Assimp::IOStream {
+private:
+	AssetBytes m_file;
+	size_t m_position;
+
+public:
+	explicit MappedIOStream(AssetBytes file);
+
+	size_t Read(void* buffer, size_t size, size_t count) override;
+	// Mapped files are read-only; writes always fail.
+	size_t Write(const void* buffer, size_t size, size_t count) override;
+	aiReturn Seek(size_t offset, aiOrigin origin) override;
+	size_t Tell() const override;
+	size_t FileSize() const override;
+	void Flush() override;
+};
+
+/**
+ * @brief An Assimp file system that opens every file an import reads, including the model's external
+ * references, as a MappedIOStream. Files come from the mounted AssetPack when it has them. Opening a
+ * file for writing fails.
+ */
+class MappedIOSystem : public Assimp::IOSystem {
+private:
+	std::vector<std::string> m_openedPaths;
+
+public:
+	/**
+	 * @brief Every file opened through this IOSystem, in the order they were first opened.
+	 */
+	const std::vector<std::string>& openedPaths() const;
+
+	bool Exists(const char* path) const override;
+	char getOsSeparator() const override;
+	Assimp::IOStream* Open(const char* path, const char* mode = "rb") override;
+	void Close(Assimp::IOStream* stream) override;
+};
@@ -0,0 +1,169 @@
+#include "MaterialPacker.h"
+#include "Hash.h"
+#include "StbImage.h"
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+
+namespace {
+	// The first line of a recipe. Bumped whenever the packing changes, which packs every texture again.
+	const std::string RECIPE_HEADER = "MSMATERIAL 2\n";
+
+	// The specular reflectance of a dielectric, which metallic maps blend toward white.
+	const uint8_t DIELECTRIC_SPECULAR = 10;
+
+	/**
+	 * @brief The RGBA texel of a material map nearest to the given texel of a texture of the given size.
+	 */
+	const uint8_t* sampleTexel(const StbImage& image, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+		uint32_t sx = static_cast<uint32_t>(uint64_t(x) * image.getWidth() / width);
+		uint32_t sy = static_cast<uint32_t>(uint64_t(y) * image.getHeight() / height);
+		return image.getData() + (size_t(sy) * image.getWidth() + sx) * 4;
+	}
+
+	/**
+	 * @brief Whether the recipe's roughness and metallic come from one file, packed as glTF packs them.
+	 */
+	bool isMetallicRoughness(const MaterialRecipe& recipe) {
+		return !recipe.maps[1].empty() && recipe.maps[1] == recipe.maps[2];
+	}
+}
+
+std::string packedTexturePath(const std::filesystem::path& modelPath, uint32_t index) {
+	return (modelPath / ("*material" + std::to_string(index))).string();
+}
+
+std::optional<MaterialRecipe> readMaterialRecipe(const AssetBytes& file) {
+	std::string text(reinterpret_cast<const char*>(file.data), file.size);
+	if (text.compare(0, RECIPE_HEADER.size(), RECIPE_HEADER) != 0) {
+		return std::nullopt;
+	}
+	std::istringstream lines(text.substr(RECIPE_HEADER.size()));
+	MaterialRecipe recipe;
+	for (size_t c = 0; c < recipe.maps.size(); c++) {
+		if (!std::getline(lines, recipe.maps[c])) {
+			return std::nullopt;
+		}
+		if (!recipe.maps[c].empty()) {
+			recipe.files[c] = AssetPack::open(recipe.maps[c]);
+		}
+	}
+	return recipe;
+}
+
+uint64_t materialRecipeHash(const MaterialRecipe& recipe) {
+	uint64_t hash = fnv1a64(RECIPE_HEADER.data(), RECIPE_HEADER.size());
+	for (auto& file : recipe.files) {
+		// A missing map is told apart from any file's bytes by its length, which is hashed first.
+		uint64_t size = file ? file->size : UINT64_MAX;
+		hash = fnv1a64(&size, sizeof(size), hash);
+		if (file) {
+			hash = fnv1a64(file->data, file->size, hash);
+		}
+	}
+	uint8_t metallicRoughness = isMetallicRoughness(recipe) ? 1 : 0;
+	return fnv1a64(&metallicRoughness, sizeof(metallicRoughness), hash);
+}
+
+std::vector<uint8_t> packMaterialTexels(const MaterialRecipe& recipe, uint32_t& width, uint32_t& height) {
+	// Decode every map once, even if several channels share it.
+	StbImage images[3];
+	const StbImage* channelImages[3] = {};
+	width = height = 1;
+	for (size_t c = 0; c < 3; c++) {
+		auto shared = std::find(recipe.maps.begin(), recipe.maps.begin() + c, recipe.maps[c]);
+		if (shared != recipe.maps.begin() + c) {
+			channelImages[c] = channelImages[shared - recipe.maps.begin()];
+		}
+		else if (recipe.files[c] && images[c].loadFromMemory(recipe.files[c]->data, recipe.files[c]->size, recipe.maps[c])) {
+			channelImages[c] = &images[c];
+		}
+		if (channelImages[c] != nullptr) {
+			width = std::max(width, static_cast<uint32_t>(channelImages[c]->getWidth()));
+			height = std::max(height, static_cast<uint32_t>(channelImages[c]->getHeight()));
+		}
+	}
+
+	// Without a roughness map the surface is fully rough, which leaves the shading as it was.
+	bool metallicRoughness = isMetallicRoughness(recipe);
+	const int roughnessComponent = metallicRoughness ? 1 : 0, metallicComponent = metallicRoughness ? 2 : 0;
+	const StbImage* specular = channelImages[0];
+	const StbImage* roughness = channelImages[1];
+	const StbImage* metallic = channelImages[2];
+	std::vector<uint8_t> rgba(size_t(width) * height * 4);
+	for (uint32_t y = 0; y < height; y++) {
+		for (uint32_t x = 0; x < width; x++) {
+			uint8_t* texel = &rgba[(size_t(y) * width + x) * 4];
+			if (specular != nullptr) {
+				std::copy_n(sampleTexel(*specular, x, y, width, height), 3, texel);
+			}
+			else {
+				uint8_t metal = metallic == nullptr ? 255 : sampleTexel(*metallic, x, y, width, height)[metallicComponent];
+				uint8_t grey = static_cast<uint8_t>(DIELECTRIC_SPECULAR + (255 - DIELECTRIC_SPECULAR) * metal / 255);
+				texel[0] = texel[1] = texel[2] = grey;
+			}
+			texel[3] = roughness == nullptr ? 0 : 255 - sampleTexel(*roughness, x, y, width, height)[roughnessComponent];
+		}
+	}
+	return rgba;
+}
+
+void packMaterialMaps(ModelData& model, const std::filesystem::path& modelPath) {
+	// Each distinct set of maps, the path of each channel's or "" for none, becomes one texture.
+	// Mesh3D binds a mesh's textures in order, so the last map of each kind is the one it would use.
+	using ChannelMaps = std::array<std::string, 3>;
+	std::map<ChannelMaps, uint32_t> packIndices;
+	std::vector<ChannelMaps> packs;
+	size_t mapCount = 0;
+	for (auto& mesh : model.meshes) {
+		ChannelMaps maps;
+		std::vector<TextureRef> kept;
+		size_t position = SIZE_MAX;
+		for (auto& ref : mesh.textures) {
+			auto channel = std::find_if(std::begin(MATERIAL_CHANNEL_SAMPLERS), std::end(MATERIAL_CHANNEL_SAMPLERS),
+				[&](const char* sampler) { return ref.samplerName == sampler; }) - std::begin(MATERIAL_CHANNEL_SAMPLERS);
+			if (channel == 3) {
+				kept.push_back(ref);
+				continue;
+			}
+			if (position == SIZE_MAX) {
+				position = kept.size();
+			}
+			maps[channel] = ref.path;
+		}
+		if (position == SIZE_MAX) {
+			continue;
+		}
+		auto inserted = packIndices.insert({ maps, static_cast<uint32_t>(packs.size()) });
+		if (inserted.second) {
+			packs.push_back(maps);
+			mapCount += std::count_if(maps.begin(), maps.end(), [](const std::string& path) { return !path.empty(); });
+		}
+		kept.insert(kept.begin() + position,
+			TextureRef{ packedTexturePath(modelPath, inserted.first->second), MATERIAL_MAP_SAMPLER });
+		mesh.textures = std::move(kept);
+	}
+	if (packs.empty()) {
+		return;
+	}
+
+	for (size_t p = 0; p < packs.size(); p++) {
+		EmbeddedTexture recipe;
+		recipe.path = packedTexturePath(modelPath, static_cast<uint32_t>(p));
+		auto text = std::make_shared<std::string>(RECIPE_HEADER);
+		for (auto& path : packs[p]) {
+			*text += path + "\n";
+			// Embedded maps come from the model file itself, which the mesh cache already tracks.
+			if (!path.empty() && std::filesystem::path(path).filename().string().rfind('*', 0) != 0) {
+				recipe.sources.push_back(path);
+			}
+		}
+		recipe.bytes = AssetBytes{ reinterpret_cast<const uint8_t*>(text->data()), text->size(), text };
+		AssetPack::addMemory(recipe.path, recipe.bytes);
+		model.embeddedTextures.push_back(std::move(recipe));
+	}
+	std::cout << "Packing " << mapCount << " material maps of " << modelPath << " into " << packs.size()
+		<< " textures" << std::endl;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+#include "ModelData.h"
+
+/**
+ * @brief The sampler of a mesh's packed material texture, which holds its specular colour in red,
+ * green, and blue, and its gloss, one minus its roughness, in alpha.
+ */
+const char* const MATERIAL_MAP_SAMPLER = "materialMap";
+
+/**
+ * @brief The samplers of the maps that packMaterialMaps folds into the material texture: the
+ * specular map, whose colour is kept, and the single-channel roughness and metallic maps.
+ */
+const char* const MATERIAL_CHANNEL_SAMPLERS[3] = { "specMap", "roughnessMap", "metallicMap" };
+
+/**
+ * @brief The virtual path of the model's packed material texture with the given index. Like an
+ * embedded texture's, it starts with "*" so that no file on disk can have it.
+ */
+std::string packedTexturePath(const std::filesystem::path& modelPath, uint32_t index);
+
+/**
+ * @brief The maps a packed material texture is built from, as named by the recipe served under its
+ * virtual path, and their bytes.
+ */
+struct MaterialRecipe {
+	// The path of the specular, roughness, and metallic map, or "" for none.
+	std::array<std::string, 3> maps;
+	std::array<std::optional<AssetBytes>, 3> files;
+};
+
+/**
+ * @brief Reads a recipe written by packMaterialMaps, and opens the maps it names.
+ * @return nullopt if the bytes are not a recipe.
+ */
+std::optional<MaterialRecipe> readMaterialRecipe(const AssetBytes& file);
+
+/**
+ * @brief The hash of a recipe's maps' contents, which changes whenever one of them is edited.
+ */
+uint64_t materialRecipeHash(const MaterialRecipe& recipe);
+
+/**
+ * @brief Decodes a recipe's maps and packs them into 8-bit RGBA texels, rows top to bottom. The
+ * texture is as large as its largest map; smaller maps are sampled at the nearest texel. Without a
+ * specular map, the specular colour is grey, from dielectric to fully reflective as the metallic
+ * map goes from 0 to 1, or white without one either.
+ */
+std::vector<uint8_t> packMaterialTexels(const MaterialRecipe& recipe, uint32_t& width, uint32_t& height);
+
+/**
+ * @brief Replaces each mesh's specular, roughness, and metallic maps with one reference to a
+ * materialMap, so the fragment shader fetches them all at once. Meshes with the same maps share a
+ * texture. No texels are packed here: the model's embedded textures only gain a recipe naming the
+ * maps, served from memory, and the texture loaders pack and cache the texture itself (see
+ * prepareTexture). So the mesh cache never holds packed texels, and editing a map only packs its
+ * texture again. A roughness and metallic map in the same file is read as glTF packs them, from
+ * green and blue.
+ */
+void packMaterialMaps(ModelData& model, const std::filesystem::path& modelPath);
@@ -1,4 +1,6 @@
 #include <iostream>
+#include <algorithm>
+#include <cmath>
 #include "Mesh3D.h"
 #include <glad/glad.h>
 
@@ -13,22 +15,98 @@ Mesh3D::Mesh3D(std::vector<Vertex3D>&& vertices, std::vector<uint32_t>&& faces,
 }
 
 Mesh3D::Mesh3D(std::vector<Vertex3D>&& vertices, std::vector<uint32_t>&& faces, std::vector<Texture>&& textures)
- : m_vertexCount(vertices.size()), m_faceCount(faces.size()), m_textures(textures) {
+	: Mesh3D(vertices.data(), vertices.size(), faces.data(), faces.size(), std::move(textures)) {
+}
+
+Mesh3D::Mesh3D(const Vertex3D* vertices, size_t vertexCount, const uint32_t* faces, size_t faceCount,
+	std::vector<Texture>&& textures, std::vector<MeshLod> lods, std::vector<Meshlet> meshlets)
+ : m_geometry(std::make_shared<MeshGeometry>()), m_textures(textures) {
+	m_geometry->upload(vertices, vertexCount, faces, faceCount, std::move(lods), std::move(meshlets));
+}
+
+Mesh3D::Mesh3D(uint32_t vao, uint32_t vbo, uint32_t ebo, const Vertex3D* vertices, size_t vertexCount,
+	const uint32_t* faces, size_t faceCount, std::vector<Texture>&& textures, std::vector<MeshLod> lods,
+	std::vector<Meshlet> meshlets)
+ : m_geometry(std::make_shared<MeshGeometry>()), m_textures(textures) {
+	m_geometry->upload(vao, vbo, ebo, vertices, vertexCount, faces, faceCount, std::move(lods), std::move(meshlets));
+}
+
+ViewContext ViewContext::fromCamera(const glm::mat4& view, const glm::mat4& projection, float viewportHeight) {
+	ViewContext context;
+	context.cameraPosition = glm::vec3(glm::inverse(view)[3]);
+	// The projection's [1][1] is the cotangent of half the vertical field of view.
+	context.pixelsPerUnit = viewportHeight * projection[1][1] / 2;
+	// Each plane is the view-projection matrix's last row plus or minus one of the others (Gribb and
+	// Hartmann), normalized so that it gives distances.
+	glm::mat4 viewProjection = projection * view;
+	for (int axis = 0; axis < 3; axis++) {
+		for (int side = 0; side < 2; side++) {
+			glm::vec4 plane;
+			for (int column = 0; column < 4; column++) {
+				float row = viewProjection[column][axis];
+				plane[column] = viewProjection[column][3] + (side == 0 ? row : -row);
+			}
+			context.frustum[axis * 2 + side] = plane / glm::length(glm::vec3(plane));
+		}
+	}
+	return context;
+}
+
+namespace {
+	/**
+	 * @brief Tests a sphere against frustum planes; the planes and sphere may be in any space, as
+	 * long as it is the same one, and the planes' normals need not be unit length.
+	 */
+	bool outsideFrustum(const glm::vec4* planes, const glm::vec3& centre, float radius) {
+		for (int i = 0; i < 6; i++) {
+			glm::vec3 normal(planes[i]);
+			if (glm::dot(normal, centre) + planes[i].w < -radius * glm::length(normal)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Reused by every meshlet draw, so culling does not allocate each frame.
+	std::vector<GLsizei> visibleCounts;
+	std::vector<const void*> visibleOffsets;
+}
+
+Mesh3D::Mesh3D(std::shared_ptr<MeshGeometry> geometry, std::vector<Texture>&& textures)
+ : m_geometry(std::move(geometry)), m_textures(textures) {
+}
 
+void MeshGeometry::upload(const Vertex3D* vertices, size_t numVertices, const uint32_t* faces, size_t numFaces,
+	std::vector<MeshLod> levels, std::vector<Meshlet> clusters) {
 	// Generate a vertex array object on the GPU.
-	glGenVertexArrays(1, &m_vao);
-	// "Bind" the newly-generated vao, which makes future functions operate on that specific object.
-	glBindVertexArray(m_vao);
+	uint32_t vertexArray;
+	glGenVertexArrays(1, &vertexArray);
+	// Generate a vertex buffer object for the vertices, and a second buffer for the indices of each triangle.
+	uint32_t buffers[2];
+	glGenBuffers(2, buffers);
+	upload(vertexArray, buffers[0], buffers[1], vertices, numVertices, faces, numFaces, std::move(levels),
+		std::move(clusters));
+}
+
+MeshGeometry::~MeshGeometry() {
+	if (vao != 0) {
+		glDeleteVertexArrays(1, &vao);
+		uint32_t buffers[] = { vbo, ebo };
+		glDeleteBuffers(2, buffers);
+	}
+}
 
-	// Generate a vertex buffer object on the GPU.
-	uint32_t vbo;
-	glGenBuffers(1, &vbo);
+void MeshGeometry::upload(uint32_t vertexArray, uint32_t vertexBuffer, uint32_t elementBuffer, const Vertex3D* vertices,
+	size_t numVertices, const uint32_t* faces, size_t numFaces, std::vector<MeshLod> levels,
+	std::vector<Meshlet> clusters) {
+	// "Bind" the vao, which makes future functions operate on that specific object.
+	glBindVertexArray(vertexArray);
 
-	// "Bind" the newly-generated vbo, which makes future functions operate on that specific object.
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	// This vbo is now associated with m_vao.
+	// "Bind" the vbo, which makes future functions operate on that specific object.
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	// This vbo is now associated with the vao.
 	// Copy the contents of the vertices list to the buffer that lives on the GPU.
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex3D), &vertices[0], GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, numVertices * sizeof(Vertex3D), vertices, GL_STATIC_DRAW);
 
 	// Inform OpenGL how to interpret the buffer. Each vertex now has TWO attributes; a position and a color.
 	// Atrribute 0 is position: 3 contiguous floats (x/y/z)...
@@ -43,14 +121,41 @@ Mesh3D::Mesh3D(std::vector<Vertex3D>&& vertices, std::vector<uint32_t>&& faces,
 	glVertexAttribPointer(2, 2, GL_FLOAT, false, sizeof(Vertex3D), (void*)24);
 	glEnableVertexAttribArray(2);
 
-	// Generate a second buffer, to store the indices of each triangle in the mesh.
-	uint32_t ebo;
-	glGenBuffers(1, &ebo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, faces.size() * sizeof(uint32_t), &faces[0], GL_STATIC_DRAW);
+	// The second buffer stores the indices of each triangle in the mesh.
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, numFaces * sizeof(uint32_t), faces, GL_STATIC_DRAW);
 
 	// Unbind the vertex array, so no one else can accidentally mess with it.
 	glBindVertexArray(0);
+
+	// Levels of detail are chosen by their error seen from the distance to this sphere, which is
+	// centred on the mean vertex rather than the smallest possible, but is found in one pass.
+	glm::vec3 centre(0);
+	for (size_t i = 0; i < numVertices; i++) {
+		centre += glm::vec3(vertices[i].x, vertices[i].y, vertices[i].z);
+	}
+	centre /= std::max<size_t>(numVertices, 1);
+	float radius = 0;
+	for (size_t i = 0; i < numVertices; i++) {
+		radius = std::max(radius, glm::length(glm::vec3(vertices[i].x, vertices[i].y, vertices[i].z) - centre));
+	}
+	bounds = glm::vec4(centre, radius);
+	lods = std::move(levels);
+	meshlets = std::move(clusters);
+
+	vertexCount = numVertices;
+	faceCount = numFaces;
+	vao = vertexArray;
+	vbo = vertexBuffer;
+	ebo = elementBuffer;
+}
+
+size_t MeshGeometry::indexSize() const {
+	switch (indexType) {
+	case GL_UNSIGNED_BYTE: return 1;
+	case GL_UNSIGNED_SHORT: return 2;
+	default: return 4;
+	}
 }
 
 void Mesh3D::addTexture(Texture texture)
@@ -58,17 +163,137 @@ void Mesh3D::addTexture(Texture texture)
 	m_textures.push_back(texture);
 }
 
+const std::shared_ptr<MeshGeometry>& Mesh3D::getGeometry() const {
+	return m_geometry;
+}
+
+size_t Mesh3D::selectLod(const glm::vec3& centre, float radius, float scale, const ViewContext& view) const {
+	const auto& levels = m_geometry->lods;
+	if (levels.size() < 2) {
+		return 0;
+	}
+	// An error of e units at distance d covers about e / d * pixelsPerUnit pixels; the distance is
+	// to the nearest point of the bounding sphere, and the model matrix's largest scale grows the error.
+	float distance = glm::length(view.cameraPosition - centre) - radius;
+	if (distance <= 0) {
+		return 0;
+	}
+	float pixelsPerError = scale * view.pixelsPerUnit / distance;
+
+	size_t level = 0;
+	for (size_t i = levels.size() - 1; i > 0; i--) {
+		float limit = i > m_lodLevel ? view.errorThreshold * (1 - view.hysteresis) : view.errorThreshold;
+		if (levels[i].error * pixelsPerError <= limit) {
+			level = i;
+			break;
+		}
+	}
+	return level;
+}
+
 void Mesh3D::render(sf::Window& window, ShaderProgram& program) const {
+	drawLevel(program, 0);
+}
+
+void Mesh3D::render(sf::Window& window, ShaderProgram& program, const glm::mat4& model, const ViewContext& view) const {
+	// Geometry without bounds can be neither culled nor simplified.
+	if (m_geometry->bounds.w < 0) {
+		drawLevel(program, 0);
+		return;
+	}
+	glm::vec3 centre = glm::vec3(model * glm::vec4(glm::vec3(m_geometry->bounds), 1));
+	float scale = std::max({ glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])),
+		glm::length(glm::vec3(model[2])) });
+	float radius = m_geometry->bounds.w * scale;
+	if (outsideFrustum(view.frustum, centre, radius)) {
+		return;
+	}
+
+	m_lodLevel = selectLod(centre, radius, scale, view);
+	if (m_lodLevel == 0 && !m_geometry->meshlets.empty()) {
+		drawMeshlets(program, model, view);
+	}
+	else {
+		drawLevel(program, m_lodLevel);
+	}
+}
+
+void Mesh3D::drawLevel(ShaderProgram& program, size_t level) const {
+	GLsizei count = static_cast<GLsizei>(m_geometry->faceCount);
+	const void* offset = nullptr;
+	if (!m_geometry->lods.empty()) {
+		count = m_geometry->lods[level].indexCount;
+		offset = (void*)(m_geometry->lods[level].indexOffset * m_geometry->indexSize());
+	}
+	draw(program, &count, &offset, 1);
+}
+
+void Mesh3D::drawMeshlets(ShaderProgram& program, const glm::mat4& model, const ViewContext& view) const {
+	// Meshlets are tested in object space: the planes are carried there by the transposed model
+	// matrix, which keeps the sphere test exact under non-uniform scale.
+	glm::mat4 transposed = glm::transpose(model);
+	glm::vec4 planes[6];
+	for (int i = 0; i < 6; i++) {
+		planes[i] = transposed * view.frustum[i];
+	}
+	glm::vec3 camera = glm::vec3(glm::inverse(model) * glm::vec4(view.cameraPosition, 1));
+	// A mirroring transform turns triangles' backs to the front, so their cones mean nothing.
+	bool coneCulling = view.coneCulling && glm::determinant(glm::mat3(model)) > 0;
+
+	size_t indexSize = m_geometry->indexSize();
+	visibleCounts.clear();
+	visibleOffsets.clear();
+	for (auto& meshlet : m_geometry->meshlets) {
+		if (outsideFrustum(planes, meshlet.center, meshlet.radius)) {
+			continue;
+		}
+		// The camera is behind every triangle if it lies inside the cone, opened out by the sphere,
+		// that points back from the meshlet along its axis (see meshoptimizer's meshopt_Bounds).
+		glm::vec3 toMeshlet = meshlet.center - camera;
+		if (coneCulling && glm::dot(toMeshlet, meshlet.coneAxis)
+			>= meshlet.coneCutoff * glm::length(toMeshlet) + meshlet.radius) {
+			continue;
+		}
+		// Neighbouring survivors are merged into one range.
+		const void* offset = (void*)(meshlet.indexOffset * indexSize);
+		if (!visibleCounts.empty() && (const char*)visibleOffsets.back() + visibleCounts.back() * indexSize == offset) {
+			visibleCounts.back() += meshlet.indexCount;
+		}
+		else {
+			visibleCounts.push_back(meshlet.indexCount);
+			visibleOffsets.push_back(offset);
+		}
+	}
+	if (!visibleCounts.empty()) {
+		draw(program, visibleCounts.data(), visibleOffsets.data(), visibleCounts.size());
+	}
+}
+
+void Mesh3D::draw(ShaderProgram& program, const GLsizei* counts, const void* const* offsets, size_t ranges) const {
+	// Geometry that is still streaming in has nothing to draw yet.
+	if (m_geometry->vao == 0) {
+		return;
+	}
 	// Activate the mesh's vertex array.
-	glBindVertexArray(m_vao);
+	glBindVertexArray(m_geometry->vao);
+	bool normalMapIsTwoChannel = false;
 	for (auto i = 0; i < m_textures.size(); i++) {
 		program.setUniform(m_textures[i].samplerName, i);
 		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, m_textures[i].textureId);
+		glBindTexture(GL_TEXTURE_2D, m_textures[i].textureId());
+		if (m_textures[i].samplerName == "normalMap") {
+			normalMapIsTwoChannel = m_textures[i].handle->boundTwoChannel();
+		}
 	}
+	program.setUniform("normalMapIsTwoChannel", normalMapIsTwoChannel);
 
-	// Draw the vertex array, using its "element buffer" to identify the faces.
-	glDrawElements(GL_TRIANGLES, m_faceCount, GL_UNSIGNED_INT, nullptr);
+	// Draw the vertex array, using its "element buffer" to identify the faces in each range.
+	if (ranges == 1) {
+		glDrawElements(GL_TRIANGLES, counts[0], m_geometry->indexType, offsets[0]);
+	}
+	else {
+		glMultiDrawElements(GL_TRIANGLES, counts, m_geometry->indexType, offsets, static_cast<GLsizei>(ranges));
+	}
 	// Deactivate the mesh's vertex array and texture.
 	glBindVertexArray(0);
 	glBindTexture(GL_TEXTURE_2D, 0);
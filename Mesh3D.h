@@ -1,4 +1,6 @@
 #pragma once
+#include <memory>
+#include <vector>
 #include <SFML/Window.hpp>
 #include <glm/glm.hpp>
 #include <glad/glad.h>
@@ -22,16 +24,117 @@ struct Vertex3D {
 		x(px), y(py), z(pz), nx(normX), ny(normY), nz(normZ), u(texU), v(texV) {}
 };
 
+/**
+ * @brief One level of detail of a mesh: a range of its element buffer, and how far (in object
+ * space) the level's surface may stray from the full-detail mesh.
+ */
+struct MeshLod {
+	uint32_t indexOffset;
+	uint32_t indexCount;
+	float error;
+};
+
+/**
+ * @brief A cluster of a mesh's full-detail triangles: a range of its element buffer, with a sphere
+ * around the cluster and a cone containing its triangles' normals, in object space.
+ */
+struct Meshlet {
+	uint32_t indexOffset;
+	uint32_t indexCount;
+	glm::vec3 center;
+	float radius;
+	glm::vec3 coneAxis;
+	// The sine of the widest angle between the axis and a normal; 1 if no viewpoint sees only backs.
+	float coneCutoff;
+};
+
+/**
+ * @brief What a mesh needs to choose its level of detail and cull its meshlets: the camera's
+ * position and frustum, how many pixels a length of one unit spans at a distance of one unit, and
+ * the largest error to allow on screen.
+ */
+struct ViewContext {
+	glm::vec3 cameraPosition;
+	float pixelsPerUnit;
+	// The frustum's planes in world space, facing inwards: left, right, bottom, top, near, far.
+	glm::vec4 frustum[6];
+	float errorThreshold = 1.0f;
+	// Switching to a coarser level requires its error to fall this fraction below the threshold,
+	// so meshes near the boundary do not flicker between levels.
+	float hysteresis = 0.25f;
+	// Skips meshlets whose triangles all face away from the camera. The renderer does not enable
+	// GL_CULL_FACE, so open, single-sided surfaces such as the boat's hull show their backs; this
+	// would hide whole meshlets of them, so it is only for scenes whose back faces are never seen.
+	bool coneCulling = false;
+
+	/**
+	 * @brief The context for a camera with the given view and perspective projection matrices,
+	 * drawing into a viewport of the given height in pixels.
+	 */
+	static ViewContext fromCamera(const glm::mat4& view, const glm::mat4& projection, float viewportHeight);
+};
+
+/**
+ * @brief The vertex array of a mesh on the GPU, shared by every copy of the Mesh3D that draws it.
+ * A vao of 0 means the geometry has not been uploaded yet, and meshes using it draw nothing.
+ * The vertex array and its buffers are deleted when the last Mesh3D sharing them is destroyed.
+ */
+struct MeshGeometry {
+	uint32_t vao = 0;
+	uint32_t vbo = 0;
+	uint32_t ebo = 0;
+	size_t vertexCount = 0;
+	size_t faceCount = 0;
+	// The type of the values in the element buffer: GL_UNSIGNED_INT, GL_UNSIGNED_SHORT, or GL_UNSIGNED_BYTE.
+	uint32_t indexType = GL_UNSIGNED_INT;
+	// The mesh's levels of detail, finest first, all in the element buffer; empty if the whole
+	// buffer is the only level.
+	std::vector<MeshLod> lods;
+	// The mesh's full-detail triangles in clusters, for culling; empty if the mesh is drawn whole.
+	std::vector<Meshlet> meshlets;
+	// A sphere around the vertices in object space: the centre, and the radius in w, which is
+	// negative for geometry uploaded without one, which is then never culled or simplified.
+	glm::vec4 bounds = glm::vec4(0, 0, 0, -1);
+
+	MeshGeometry() = default;
+	MeshGeometry(const MeshGeometry&) = delete;
+	MeshGeometry& operator=(const MeshGeometry&) = delete;
+	~MeshGeometry();
+
+	/**
+	 * @brief The bytes of one value in the element buffer, from indexType.
+	 */
+	size_t indexSize() const;
+
+	/**
+	 * @brief Fills vertex array and buffers that were already generated, and describes the vertex layout.
+	 */
+	void upload(uint32_t vertexArray, uint32_t vertexBuffer, uint32_t elementBuffer, const Vertex3D* vertices,
+		size_t numVertices, const uint32_t* faces, size_t numFaces, std::vector<MeshLod> levels = {},
+		std::vector<Meshlet> clusters = {});
+
+	/**
+	 * @brief Generates a vertex array and buffers, and fills them.
+	 */
+	void upload(const Vertex3D* vertices, size_t numVertices, const uint32_t* faces, size_t numFaces,
+		std::vector<MeshLod> levels = {}, std::vector<Meshlet> clusters = {});
+};
+
 /**
  * @brief Represents a mesh whose vertices have positions, normal vectors, and texture coordinates;
  * as well as a list of Textures to bind when rendering the mesh.
  */
 class Mesh3D {
 private:
-	uint32_t m_vao;
+	std::shared_ptr<MeshGeometry> m_geometry;
 	std::vector<Texture> m_textures;
-	size_t m_vertexCount;
-	size_t m_faceCount;
+	// The level of detail drawn last frame, which biases the next choice; see ViewContext::hysteresis.
+	mutable size_t m_lodLevel = 0;
+
+	size_t selectLod(const glm::vec3& centre, float radius, float scale, const ViewContext& view) const;
+	void draw(ShaderProgram& program, const GLsizei* counts, const void* const* offsets, size_t ranges) const;
+	void drawLevel(ShaderProgram& program, size_t level) const;
+	void drawMeshlets(ShaderProgram& program, const glm::mat4& model, const ViewContext& view) const;
 
 public:
 	Mesh3D() = delete;
@@ -46,8 +149,30 @@ public:
 	Mesh3D(std::vector<Vertex3D>&& vertices, std::vector<uint32_t>&& faces,
 		std::vector<Texture>&& textures);
 
+	/**
+	 * @brief Constructs a Mesh3D by copying vertices and faces directly from existing memory to the GPU,
+	 * such as a memory-mapped cache file.
+	*/
+	Mesh3D(const Vertex3D* vertices, size_t vertexCount, const uint32_t* faces, size_t faceCount,
+		std::vector<Texture>&& textures, std::vector<MeshLod> lods = {}, std::vector<Meshlet> meshlets = {});
+
+	/**
+	 * @brief Constructs a Mesh3D in a vertex array and buffers that were already generated, so that
+	 * many meshes can share one glGenVertexArrays/glGenBuffers call.
+	*/
+	Mesh3D(uint32_t vao, uint32_t vbo, uint32_t ebo, const Vertex3D* vertices, size_t vertexCount,
+		const uint32_t* faces, size_t faceCount, std::vector<Texture>&& textures, std::vector<MeshLod> lods = {},
+		std::vector<Meshlet> meshlets = {});
+
+	/**
+	 * @brief Constructs a Mesh3D that draws existing geometry, which may not be uploaded yet.
+	*/
+	Mesh3D(std::shared_ptr<MeshGeometry> geometry, std::vector<Texture>&& textures);
+
 	void addTexture(Texture texture);
 
+	const std::shared_ptr<MeshGeometry>& getGeometry() const;
+
 	/**
 	 * @brief Constructs a 1x1 square centered at the origin in world space.
 	*/
@@ -62,8 +187,16 @@ public:
 	static Mesh3D triangle(Texture texture);
 
 	/**
-	 * @brief Renders the mesh to the given context.
+	 * @brief Renders the mesh to the given context at full detail.
 	 */
 	void render(sf::Window& window, ShaderProgram& program) const;
+
+	/**
+	 * @brief Renders the mesh to the given context at the coarsest level of detail whose projected
+	 * error, under the given model matrix, stays within the view's threshold. Meshes outside the
+	 * view's frustum are skipped; at full detail, so are meshlets outside it, and with
+	 * ViewContext::coneCulling, those facing away.
+	 */
+	void render(sf::Window& window, ShaderProgram& program, const glm::mat4& model, const ViewContext& view) const;
 	
 };
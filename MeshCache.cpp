@@ -0,0 +1,405 @@
+#include "MeshCache.h"
+#include "AssetPack.h"
+#include "DependencyGraph.h"
+#include "Hash.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <type_traits>
+#include <unordered_set>
+
+static_assert(sizeof(Vertex3D) == 8 * sizeof(float), "Vertex3D must be tightly packed to be cached");
+static_assert(std::is_trivially_copyable<Vertex3D>::value, "Vertex3D must be trivially copyable to be cached");
+
+namespace {
+	const char MAGIC[4] = { 'M', 'S', 'M', 'C' };
+	// Vertex and face arrays start on this alignment, so they can be used in place once mapped.
+	const size_t ARRAY_ALIGNMENT = 16;
+	// NodeHeader flags.
+	const uint32_t NODE_ANIMATED = 1;
+
+	struct FileHeader {
+		char magic[4];
+		uint32_t version;
+		uint32_t importFlags;
+		float weldEpsilon;
+		uint32_t nodeCount;
+		uint32_t meshCount;
+		uint32_t sourcePathLength;
+		uint32_t embeddedTextureCount;
+	};
+
+	struct NodeHeader {
+		float baseTransform[16];
+		uint32_t nameLength;
+		uint32_t meshCount;
+		uint32_t childCount;
+		uint32_t flags;
+	};
+
+	struct MeshHeader {
+		uint32_t vertexCount;
+		uint32_t faceCount;
+		uint32_t textureCount;
+		uint32_t lodCount;
+		uint32_t meshletCount;
+		uint32_t padding;
+	};
+
+	struct TextureHeader {
+		uint32_t pathLength;
+		uint32_t samplerLength;
+	};
+
+	struct EmbeddedTextureHeader {
+		uint64_t size;
+		uint32_t pathLength;
+		uint32_t padding;
+	};
+
+	std::filesystem::path cacheDirectory = "../cache";
+
+	/**
+	 * @brief Appends plain data to an output buffer, tracking the write offset for alignment.
+	 */
+	class CacheWriter {
+	private:
+		std::string m_buffer;
+
+	public:
+		void write(const void* data, size_t size) {
+			m_buffer.append(static_cast<const char*>(data), size);
+		}
+
+		template <typename T>
+		void write(const T& value) {
+			write(&value, sizeof(T));
+		}
+
+		void writeString(const std::string& value) {
+			write(value.data(), value.size());
+		}
+
+		void align(size_t alignment) {
+			size_t padding = (alignment - m_buffer.size() % alignment) % alignment;
+			m_buffer.append(padding, '\0');
+		}
+
+		const std::string& buffer() const {
+			return m_buffer;
+		}
+	};
+
+	/**
+	 * @brief Walks a mapped cache file, refusing to read past its end.
+	 */
+	class CacheReader {
+	private:
+		const uint8_t* m_data;
+		size_t m_size;
+		size_t m_offset;
+
+	public:
+		CacheReader(const uint8_t* data, size_t size) : m_data(data), m_size(size), m_offset(0) {}
+
+		const uint8_t* take(size_t size) {
+			if (size > m_size - m_offset) {
+				throw std::runtime_error("Mesh cache entry is truncated");
+			}
+			const uint8_t* p = m_data + m_offset;
+			m_offset += size;
+			return p;
+		}
+
+		template <typename T>
+		T read() {
+			T value;
+			std::memcpy(&value, take(sizeof(T)), sizeof(T));
+			return value;
+		}
+
+		std::string readString(size_t length) {
+			return std::string(reinterpret_cast<const char*>(take(length)), length);
+		}
+
+		void align(size_t alignment) {
+			take((alignment - m_offset % alignment) % alignment);
+		}
+	};
+}
+
+std::optional<MeshCacheKey> MeshCache::makeKey(const std::string& sourcePath, uint32_t importFlags, float weldEpsilon) {
+	std::error_code error;
+	if (!AssetPack::contains(sourcePath) && !std::filesystem::is_regular_file(sourcePath, error)) {
+		return std::nullopt;
+	}
+	return MeshCacheKey{ sourcePath, importFlags, weldEpsilon };
+}
+
+const std::filesystem::path& MeshCache::directory() {
+	return cacheDirectory;
+}
+
+void MeshCache::setDirectory(const std::filesystem::path& directory) {
+	cacheDirectory = directory;
+}
+
+std::filesystem::path MeshCache::entryPath(const MeshCacheKey& key) {
+	// Entries are named for the source file, with a hash of its full path to keep models with the
+	// same file name apart, and the import flags and any weld epsilon so each combination has its own entry.
+	uint64_t pathHash = fnv1a64(key.sourcePath.data(), key.sourcePath.size());
+	std::ostringstream name;
+	name << std::filesystem::path(key.sourcePath).filename().string() << "-"
+		<< std::hex << std::setw(16) << std::setfill('0') << pathHash << "-"
+		<< std::setw(8) << key.importFlags;
+	if (key.weldEpsilon != 0) {
+		uint32_t epsilonBits;
+		std::memcpy(&epsilonBits, &key.weldEpsilon, sizeof(epsilonBits));
+		name << "-w" << std::setw(8) << epsilonBits;
+	}
+	name << ".mscache";
+	return cacheDirectory / name.str();
+}
+
+std::optional<CachedModel> MeshCache::load(const MeshCacheKey& key) {
+	if (!DependencyGraph::isUpToDate(entryPath(key), key.importFlags, VERSION)) {
+		return std::nullopt;
+	}
+	CachedModel cached;
+	if (!cached.file.open(entryPath(key).string())) {
+		return std::nullopt;
+	}
+
+	try {
+		CacheReader reader(cached.file.data(), cached.file.size());
+		auto header = reader.read<FileHeader>();
+		if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION
+			|| header.importFlags != key.importFlags || header.weldEpsilon != key.weldEpsilon
+			|| reader.readString(header.sourcePathLength) != key.sourcePath) {
+			return std::nullopt;
+		}
+
+		ModelView& model = cached.model;
+		model.nodes.reserve(header.nodeCount);
+		for (uint32_t n = 0; n < header.nodeCount; n++) {
+			reader.align(alignof(NodeHeader));
+			auto nodeHeader = reader.read<NodeHeader>();
+			NodeData node;
+			for (auto i = 0; i < 4; i++) {
+				for (auto j = 0; j < 4; j++) {
+					node.baseTransform[i][j] = nodeHeader.baseTransform[i * 4 + j];
+				}
+			}
+			node.name = reader.readString(nodeHeader.nameLength);
+			node.animated = (nodeHeader.flags & NODE_ANIMATED) != 0;
+			reader.align(sizeof(uint32_t));
+			for (uint32_t i = 0; i < nodeHeader.meshCount; i++) {
+				node.meshes.push_back(reader.read<uint32_t>());
+			}
+			for (uint32_t i = 0; i < nodeHeader.childCount; i++) {
+				node.children.push_back(reader.read<uint32_t>());
+			}
+			model.nodes.push_back(std::move(node));
+		}
+
+		model.meshes.reserve(header.meshCount);
+		for (uint32_t m = 0; m < header.meshCount; m++) {
+			reader.align(alignof(MeshHeader));
+			auto meshHeader = reader.read<MeshHeader>();
+			MeshView mesh;
+			for (uint32_t t = 0; t < meshHeader.textureCount; t++) {
+				reader.align(alignof(TextureHeader));
+				auto texHeader = reader.read<TextureHeader>();
+				TextureRef ref;
+				ref.path = reader.readString(texHeader.pathLength);
+				ref.samplerName = reader.readString(texHeader.samplerLength);
+				mesh.textures.push_back(std::move(ref));
+			}
+			// The vertex and face arrays are used in place, straight out of the mapped file.
+			reader.align(ARRAY_ALIGNMENT);
+			mesh.vertexCount = meshHeader.vertexCount;
+			mesh.vertices = reinterpret_cast<const Vertex3D*>(reader.take(mesh.vertexCount * sizeof(Vertex3D)));
+			reader.align(ARRAY_ALIGNMENT);
+			mesh.faceCount = meshHeader.faceCount;
+			mesh.faces = reinterpret_cast<const uint32_t*>(reader.take(mesh.faceCount * sizeof(uint32_t)));
+			for (uint32_t l = 0; l < meshHeader.lodCount; l++) {
+				reader.align(alignof(MeshLod));
+				auto lod = reader.read<MeshLod>();
+				if (uint64_t(lod.indexOffset) + lod.indexCount > mesh.faceCount) { return std::nullopt; }
+				mesh.lods.push_back(lod);
+			}
+			for (uint32_t l = 0; l < meshHeader.meshletCount; l++) {
+				reader.align(alignof(Meshlet));
+				auto meshlet = reader.read<Meshlet>();
+				if (uint64_t(meshlet.indexOffset) + meshlet.indexCount > mesh.faceCount) { return std::nullopt; }
+				mesh.meshlets.push_back(meshlet);
+			}
+			model.meshes.push_back(std::move(mesh));
+		}
+
+		// Embedded textures are copied out of the mapping, so serving them does not pin the entry.
+		for (uint32_t t = 0; t < header.embeddedTextureCount; t++) {
+			reader.align(alignof(EmbeddedTextureHeader));
+			auto embeddedHeader = reader.read<EmbeddedTextureHeader>();
+			std::string path = reader.readString(embeddedHeader.pathLength);
+			const uint8_t* data = reader.take(embeddedHeader.size);
+			auto bytes = std::make_shared<std::vector<uint8_t>>(data, data + embeddedHeader.size);
+			cached.embeddedTextures.push_back(AssetBytes{ bytes->data(), bytes->size(), bytes });
+			AssetPack::addMemory(path, cached.embeddedTextures.back());
+		}
+
+		// Reject entries whose indices point outside the model, rather than crashing while building it.
+		for (auto& node : model.nodes) {
+			for (auto meshIndex : node.meshes) {
+				if (meshIndex >= model.meshes.size()) { return std::nullopt; }
+			}
+			for (auto childIndex : node.children) {
+				if (childIndex >= model.nodes.size()) { return std::nullopt; }
+			}
+		}
+		if (model.nodes.empty()) {
+			return std::nullopt;
+		}
+	}
+	catch (std::runtime_error& e) {
+		std::cerr << "Ignoring mesh cache entry " << entryPath(key) << ": " << e.what() << std::endl;
+		return std::nullopt;
+	}
+	return cached;
+}
+
+bool MeshCache::store(const MeshCacheKey& key, const ModelData& model, const std::vector<std::string>& inputs) {
+	CacheWriter writer;
+	FileHeader header{};
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.importFlags = key.importFlags;
+	header.weldEpsilon = key.weldEpsilon;
+	header.nodeCount = static_cast<uint32_t>(model.nodes.size());
+	header.meshCount = static_cast<uint32_t>(model.meshes.size());
+	header.sourcePathLength = static_cast<uint32_t>(key.sourcePath.size());
+	header.embeddedTextureCount = static_cast<uint32_t>(model.embeddedTextures.size());
+	writer.write(header);
+	writer.writeString(key.sourcePath);
+
+	for (auto& node : model.nodes) {
+		writer.align(alignof(NodeHeader));
+		NodeHeader nodeHeader{};
+		for (auto i = 0; i < 4; i++) {
+			for (auto j = 0; j < 4; j++) {
+				nodeHeader.baseTransform[i * 4 + j] = node.baseTransform[i][j];
+			}
+		}
+		nodeHeader.nameLength = static_cast<uint32_t>(node.name.size());
+		nodeHeader.meshCount = static_cast<uint32_t>(node.meshes.size());
+		nodeHeader.childCount = static_cast<uint32_t>(node.children.size());
+		nodeHeader.flags = node.animated ? NODE_ANIMATED : 0;
+		writer.write(nodeHeader);
+		writer.writeString(node.name);
+		writer.align(sizeof(uint32_t));
+		writer.write(node.meshes.data(), node.meshes.size() * sizeof(uint32_t));
+		writer.write(node.children.data(), node.children.size() * sizeof(uint32_t));
+	}
+
+	for (auto& mesh : model.meshes) {
+		writer.align(alignof(MeshHeader));
+		MeshHeader meshHeader{};
+		meshHeader.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+		meshHeader.faceCount = static_cast<uint32_t>(mesh.faces.size());
+		meshHeader.textureCount = static_cast<uint32_t>(mesh.textures.size());
+		meshHeader.lodCount = static_cast<uint32_t>(mesh.lods.size());
+		meshHeader.meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+		writer.write(meshHeader);
+		for (auto& ref : mesh.textures) {
+			writer.align(alignof(TextureHeader));
+			TextureHeader texHeader{ static_cast<uint32_t>(ref.path.size()), static_cast<uint32_t>(ref.samplerName.size()) };
+			writer.write(texHeader);
+			writer.writeString(ref.path);
+			writer.writeString(ref.samplerName);
+		}
+		writer.align(ARRAY_ALIGNMENT);
+		writer.write(mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex3D));
+		writer.align(ARRAY_ALIGNMENT);
+		writer.write(mesh.faces.data(), mesh.faces.size() * sizeof(uint32_t));
+		for (auto& lod : mesh.lods) {
+			writer.align(alignof(MeshLod));
+			writer.write(lod);
+		}
+		for (auto& meshlet : mesh.meshlets) {
+			writer.align(alignof(Meshlet));
+			writer.write(meshlet);
+		}
+	}
+
+	for (auto& embedded : model.embeddedTextures) {
+		writer.align(alignof(EmbeddedTextureHeader));
+		EmbeddedTextureHeader embeddedHeader{ embedded.bytes.size, static_cast<uint32_t>(embedded.path.size()), 0 };
+		writer.write(embeddedHeader);
+		writer.writeString(embedded.path);
+		writer.write(embedded.bytes.data, embedded.bytes.size);
+	}
+
+	// The entry's record is the source model and every other file the import read, as inputs, and
+	// the textures it refers to, including the maps its packed material textures are built from.
+	// Inputs are hashed now, while the import has just read them.
+	DependencyRecord record;
+	record.importFlags = key.importFlags;
+	record.converterVersion = VERSION;
+	std::unordered_set<std::string> seen;
+	auto sources = inputs;
+	sources.insert(sources.begin(), key.sourcePath);
+	for (auto& source : sources) {
+		if (!seen.insert(std::filesystem::path(source).lexically_normal().string()).second) {
+			continue;
+		}
+		auto input = DependencyGraph::describe(source);
+		if (!input) {
+			std::cerr << "Could not record mesh cache input " << source << std::endl;
+			return false;
+		}
+		record.inputs.push_back(std::move(*input));
+	}
+	std::vector<std::string> references;
+	for (auto& mesh : model.meshes) {
+		for (auto& ref : mesh.textures) {
+			references.push_back(ref.path);
+		}
+	}
+	for (auto& embedded : model.embeddedTextures) {
+		references.insert(references.end(), embedded.sources.begin(), embedded.sources.end());
+	}
+	for (auto& reference : references) {
+		if (seen.insert(std::filesystem::path(reference).lexically_normal().string()).second) {
+			record.references.push_back(reference);
+		}
+	}
+
+	// Write to a temporary file and rename it over the entry, so a reader never maps a half-written file.
+	// The old entry's record goes first, so the new entry is never checked against it.
+	std::error_code error;
+	std::filesystem::create_directories(cacheDirectory, error);
+	auto path = entryPath(key);
+	auto tempPath = path;
+	tempPath += ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out) {
+			std::cerr << "Could not write mesh cache entry " << path << std::endl;
+			return false;
+		}
+		out.write(writer.buffer().data(), static_cast<std::streamsize>(writer.buffer().size()));
+		if (!out) {
+			std::cerr << "Could not write mesh cache entry " << path << std::endl;
+			return false;
+		}
+	}
+	std::filesystem::remove(path.string() + ".deps", error);
+	std::filesystem::rename(tempPath, path, error);
+	if (error) {
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	return DependencyGraph::record(path, record);
+}
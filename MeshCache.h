@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+#include "ModelData.h"
+
+/**
+ * @brief Identifies one conversion of a source model: the file it came from, the Assimp
+ * post-processing flags it was imported with, and the epsilon its vertices were welded with (see
+ * weldVertices). Whether the entry for a key is still current is decided by its DependencyGraph record.
+ */
+struct MeshCacheKey {
+	std::string sourcePath;
+	uint32_t importFlags;
+	float weldEpsilon = 0;
+};
+
+/**
+ * @brief A model loaded from the mesh cache. The mesh views in the model point directly into the
+ * mapped cache file, which stays mapped for as long as this object lives.
+ */
+struct CachedModel {
+	MappedFile file;
+	ModelView model;
+	// The entry's embedded textures, copied out of the mapping; AssetPack serves them while they live.
+	std::vector<AssetBytes> embeddedTextures;
+};
+
+/**
+ * @brief A versioned on-disk cache of converted models, so that warm starts can skip Assimp
+ * entirely. Each entry stores a model's vertices, faces, node hierarchy, texture references, any
+ * textures embedded in the model file, and the recipes of its packed material maps.
+ * Entries are rebuilt only when one of the files they were converted from changes; the textures
+ * they reference, packed material maps included, are loaded separately, so editing a texture never
+ * invalidates an entry.
+ */
+class MeshCache {
+public:
+	/**
+	 * @brief Bumped whenever the file layout or the conversion from Assimp changes, which
+	 * invalidates every existing cache file.
+	 */
+	static const uint32_t VERSION = 12;
+
+	/**
+	 * @brief Builds the cache key for a source model.
+	 * @return an empty optional if the source file does not exist.
+	 */
+	static std::optional<MeshCacheKey> makeKey(const std::string& sourcePath, uint32_t importFlags, float weldEpsilon = 0);
+
+	/**
+	 * @brief Maps the cache entry for the given key.
+	 * @return an empty optional if there is no entry, or if the entry is stale or corrupt.
+	 */
+	static std::optional<CachedModel> load(const MeshCacheKey& key);
+
+	/**
+	 * @brief Writes a converted model to the cache, replacing any existing entry for the key, and
+	 * records the files it was converted from: the source model and any files the import read
+	 * alongside it, such as material libraries and binary buffers.
+	 * @return false if the entry could not be written.
+	 */
+	static bool store(const MeshCacheKey& key, const ModelData& model, const std::vector<std::string>& inputs);
+
+	/**
+	 * @brief The directory that cache files are written to. Defaults to "../cache", alongside
+	 * "../models".
+	 */
+	static const std::filesystem::path& directory();
+	static void setDirectory(const std::filesystem::path& directory);
+
+private:
+	static std::filesystem::path entryPath(const MeshCacheKey& key);
+};
@@ -0,0 +1,719 @@
+#include "MeshOptimizer.h"
+#include "Hash.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+WeldStats& WeldStats::operator+=(const WeldStats& other) {
+	verticesBefore += other.verticesBefore;
+	verticesAfter += other.verticesAfter;
+	cacheMissesBefore += other.cacheMissesBefore;
+	cacheMissesAfter += other.cacheMissesAfter;
+	indexCount += other.indexCount;
+	return *this;
+}
+
+size_t countCacheMisses(const uint32_t* indices, size_t indexCount, size_t vertexCount, size_t cacheSize) {
+	// A vertex is in the FIFO while fewer than cacheSize misses have happened since it went in.
+	std::vector<size_t> insertedAt(vertexCount, 0);
+	size_t misses = 0;
+	for (size_t i = 0; i < indexCount; i++) {
+		uint32_t vertex = indices[i];
+		if (insertedAt[vertex] == 0 || misses - (insertedAt[vertex] - 1) >= cacheSize) {
+			misses++;
+			insertedAt[vertex] = misses;
+		}
+	}
+	return misses;
+}
+
+namespace {
+	const size_t FLOATS_PER_VERTEX = sizeof(Vertex3D) / sizeof(float);
+
+	/**
+	 * @brief A vertex's attributes as the integers they are compared by: raw bits, or grid cells.
+	 */
+	struct WeldKey {
+		int64_t values[FLOATS_PER_VERTEX];
+
+		bool operator==(const WeldKey& other) const {
+			return std::memcmp(values, other.values, sizeof(values)) == 0;
+		}
+	};
+
+	struct WeldKeyHash {
+		size_t operator()(const WeldKey& key) const {
+			return static_cast<size_t>(fnv1a64(key.values, sizeof(key.values)));
+		}
+	};
+
+	WeldKey weldKey(const Vertex3D& vertex, float epsilon) {
+		WeldKey key;
+		const float* attributes = &vertex.x;
+		for (size_t i = 0; i < FLOATS_PER_VERTEX; i++) {
+			// Adding 0 turns -0 into +0, so the two compare equal bit for bit.
+			float value = attributes[i] + 0.0f;
+			if (epsilon > 0) {
+				key.values[i] = static_cast<int64_t>(std::floor(value / epsilon + 0.5f));
+			}
+			else {
+				uint32_t bits;
+				std::memcpy(&bits, &value, sizeof(bits));
+				key.values[i] = bits;
+			}
+		}
+		return key;
+	}
+}
+
+WeldStats weldVertices(MeshData& mesh, float epsilon) {
+	static_assert(sizeof(Vertex3D) == FLOATS_PER_VERTEX * sizeof(float), "Vertex3D must be tightly packed floats");
+	WeldStats stats;
+	stats.verticesBefore = mesh.vertices.size();
+	stats.indexCount = mesh.faces.size();
+	stats.cacheMissesBefore = countCacheMisses(mesh.faces.data(), mesh.faces.size(), mesh.vertices.size());
+
+	// Vertices are kept in the order the index buffer first uses them; unreferenced ones are dropped.
+	std::vector<Vertex3D> welded;
+	welded.reserve(mesh.vertices.size());
+	std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+	std::unordered_map<WeldKey, uint32_t, WeldKeyHash> survivors;
+	survivors.reserve(mesh.vertices.size());
+	for (auto& index : mesh.faces) {
+		if (remap[index] == UINT32_MAX) {
+			auto inserted = survivors.insert({ weldKey(mesh.vertices[index], epsilon), static_cast<uint32_t>(welded.size()) });
+			if (inserted.second) {
+				welded.push_back(mesh.vertices[index]);
+			}
+			remap[index] = inserted.first->second;
+		}
+		index = remap[index];
+	}
+	mesh.vertices = std::move(welded);
+
+	stats.verticesAfter = mesh.vertices.size();
+	stats.cacheMissesAfter = countCacheMisses(mesh.faces.data(), mesh.faces.size(), mesh.vertices.size());
+	return stats;
+}
+
+CacheStats measureVertexCache(const MeshData& mesh, size_t cacheSize) {
+	return measureVertexCache(mesh.faces, mesh.vertices.size(), cacheSize);
+}
+
+CacheStats measureVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, size_t cacheSize) {
+	CacheStats stats;
+	if (indices.empty()) {
+		return stats;
+	}
+	std::vector<bool> used(vertexCount, false);
+	size_t usedCount = 0;
+	for (auto index : indices) {
+		if (!used[index]) {
+			used[index] = true;
+			usedCount++;
+		}
+	}
+	double misses = double(countCacheMisses(indices.data(), indices.size(), vertexCount, cacheSize));
+	stats.acmr = misses / (indices.size() / 3);
+	stats.atvr = misses / usedCount;
+	return stats;
+}
+
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, size_t cacheSize,
+	std::vector<size_t>* clusters) {
+	size_t triangleCount = indices.size() / 3;
+	if (clusters) { clusters->assign(1, 0); }
+	if (triangleCount == 0) {
+		return;
+	}
+
+	// The triangles around each vertex, in compressed rows.
+	std::vector<uint32_t> liveTriangles(vertexCount, 0);
+	for (auto index : indices) {
+		liveTriangles[index]++;
+	}
+	std::vector<size_t> adjacencyStart(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++) {
+		adjacencyStart[v + 1] = adjacencyStart[v] + liveTriangles[v];
+	}
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<size_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (size_t i = 0; i < indices.size(); i++) {
+		adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	std::vector<size_t> cacheTime(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> deadEnds;
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> reordered;
+	reordered.reserve(indices.size());
+	size_t time = cacheSize + 1;
+	size_t cursor = 0;
+
+	int64_t fanning = indices[0];
+	while (fanning >= 0) {
+		candidates.clear();
+		for (size_t a = adjacencyStart[fanning]; a < adjacencyStart[fanning + 1]; a++) {
+			uint32_t triangle = adjacency[a];
+			if (emitted[triangle]) {
+				continue;
+			}
+			emitted[triangle] = true;
+			for (size_t corner = 0; corner < 3; corner++) {
+				uint32_t vertex = indices[triangle * 3 + corner];
+				reordered.push_back(vertex);
+				deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+				liveTriangles[vertex]--;
+				if (time - cacheTime[vertex] > cacheSize) {
+					cacheTime[vertex] = time++;
+				}
+			}
+		}
+
+		// Fan next around the candidate that is oldest in the cache yet will still be in it once
+		// its remaining triangles are emitted.
+		fanning = -1;
+		size_t bestPriority = 0;
+		for (auto vertex : candidates) {
+			if (liveTriangles[vertex] == 0) {
+				continue;
+			}
+			size_t priority = 0;
+			if (time - cacheTime[vertex] + 2 * liveTriangles[vertex] <= cacheSize) {
+				priority = time - cacheTime[vertex];
+			}
+			if (fanning < 0 || priority > bestPriority) {
+				fanning = vertex;
+				bestPriority = priority;
+			}
+		}
+		if (fanning >= 0) {
+			continue;
+		}
+
+		// A dead end: resume from a recently used vertex, or failing that the next unfinished one,
+		// which starts a new run.
+		while (!deadEnds.empty() && fanning < 0) {
+			uint32_t vertex = deadEnds.back();
+			deadEnds.pop_back();
+			if (liveTriangles[vertex] > 0) {
+				fanning = vertex;
+			}
+		}
+		while (fanning < 0 && cursor < vertexCount) {
+			if (liveTriangles[cursor] > 0) {
+				fanning = static_cast<int64_t>(cursor);
+			}
+			cursor++;
+		}
+		if (fanning >= 0 && clusters && time - cacheTime[fanning] > cacheSize) {
+			clusters->push_back(reordered.size());
+		}
+	}
+	indices = std::move(reordered);
+}
+
+void optimizeVertexCache(MeshData& mesh, size_t cacheSize, std::vector<size_t>* clusters) {
+	optimizeVertexCache(mesh.faces, mesh.vertices.size(), cacheSize, clusters);
+}
+
+void optimizeOverdraw(MeshData& mesh, const std::vector<size_t>& clusters, float threshold, size_t cacheSize) {
+	if (clusters.size() < 2) {
+		return;
+	}
+	auto position = [&](uint32_t index) {
+		const auto& vertex = mesh.vertices[index];
+		return std::array<double, 3>{ vertex.x, vertex.y, vertex.z };
+	};
+
+	std::array<double, 3> meshCentre = { 0, 0, 0 };
+	for (auto index : mesh.faces) {
+		auto p = position(index);
+		for (int axis = 0; axis < 3; axis++) { meshCentre[axis] += p[axis]; }
+	}
+	for (auto& c : meshCentre) { c /= mesh.faces.size(); }
+
+	// Each run is keyed by how far its area-weighted normal points away from the mesh's centre.
+	struct Cluster {
+		size_t begin;
+		size_t end;
+		double outwardness;
+	};
+	std::vector<Cluster> sorted;
+	for (size_t c = 0; c < clusters.size(); c++) {
+		size_t begin = clusters[c];
+		size_t end = c + 1 < clusters.size() ? clusters[c + 1] : mesh.faces.size();
+		std::array<double, 3> centre = { 0, 0, 0 };
+		std::array<double, 3> normal = { 0, 0, 0 };
+		for (size_t i = begin; i < end; i += 3) {
+			auto a = position(mesh.faces[i]);
+			auto b = position(mesh.faces[i + 1]);
+			auto d = position(mesh.faces[i + 2]);
+			std::array<double, 3> ab = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+			std::array<double, 3> ad = { d[0] - a[0], d[1] - a[1], d[2] - a[2] };
+			normal[0] += ab[1] * ad[2] - ab[2] * ad[1];
+			normal[1] += ab[2] * ad[0] - ab[0] * ad[2];
+			normal[2] += ab[0] * ad[1] - ab[1] * ad[0];
+			for (int axis = 0; axis < 3; axis++) { centre[axis] += a[axis] + b[axis] + d[axis]; }
+		}
+		double outwardness = 0;
+		double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		if (length > 0) {
+			for (int axis = 0; axis < 3; axis++) {
+				outwardness += (centre[axis] / (end - begin) - meshCentre[axis]) * normal[axis] / length;
+			}
+		}
+		sorted.push_back({ begin, end, outwardness });
+	}
+	std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) {
+		return a.outwardness > b.outwardness;
+	});
+
+	std::vector<uint32_t> reordered;
+	reordered.reserve(mesh.faces.size());
+	for (auto& cluster : sorted) {
+		reordered.insert(reordered.end(), mesh.faces.begin() + cluster.begin, mesh.faces.begin() + cluster.end);
+	}
+	size_t before = countCacheMisses(mesh.faces.data(), mesh.faces.size(), mesh.vertices.size(), cacheSize);
+	size_t after = countCacheMisses(reordered.data(), reordered.size(), mesh.vertices.size(), cacheSize);
+	if (after <= before * threshold) {
+		mesh.faces = std::move(reordered);
+	}
+}
+
+void optimizeVertexFetch(MeshData& mesh) {
+	std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+	std::vector<Vertex3D> reordered;
+	reordered.reserve(mesh.vertices.size());
+	for (auto& index : mesh.faces) {
+		if (remap[index] == UINT32_MAX) {
+			remap[index] = static_cast<uint32_t>(reordered.size());
+			reordered.push_back(mesh.vertices[index]);
+		}
+		index = remap[index];
+	}
+	mesh.vertices = std::move(reordered);
+}
+
+std::pair<CacheStats, CacheStats> optimizeMesh(MeshData& mesh, bool overdraw) {
+	CacheStats before = measureVertexCache(mesh);
+	std::vector<size_t> clusters;
+	optimizeVertexCache(mesh, VERTEX_CACHE_SIZE, &clusters);
+	if (overdraw) {
+		optimizeOverdraw(mesh, clusters);
+	}
+	optimizeVertexFetch(mesh);
+	return { before, measureVertexCache(mesh) };
+}
+
+namespace {
+	/**
+	 * @brief A symmetric 4x4 matrix whose value at a point is the area-weighted mean of the squared
+	 * distances from the point to a set of planes.
+	 */
+	struct Quadric {
+		// xx, xy, xz, xw, yy, yz, yw, zz, zw, ww.
+		double m[10] = {};
+		double weight = 0;
+
+		void addPlane(double a, double b, double c, double d, double area) {
+			double plane[4] = { a, b, c, d };
+			size_t k = 0;
+			for (size_t i = 0; i < 4; i++) {
+				for (size_t j = i; j < 4; j++) {
+					m[k++] += area * plane[i] * plane[j];
+				}
+			}
+			weight += area;
+		}
+
+		Quadric& operator+=(const Quadric& other) {
+			for (size_t k = 0; k < 10; k++) { m[k] += other.m[k]; }
+			weight += other.weight;
+			return *this;
+		}
+
+		double evaluate(const Vertex3D& p) const {
+			if (weight == 0) {
+				return 0;
+			}
+			double x = p.x, y = p.y, z = p.z;
+			return (m[0] * x * x + 2 * m[1] * x * y + 2 * m[2] * x * z + 2 * m[3] * x
+				+ m[4] * y * y + 2 * m[5] * y * z + 2 * m[6] * y
+				+ m[7] * z * z + 2 * m[8] * z + m[9]) / weight;
+		}
+	};
+
+	std::array<double, 3> triangleNormal(const Vertex3D& a, const Vertex3D& b, const Vertex3D& c) {
+		double abx = b.x - a.x, aby = b.y - a.y, abz = b.z - a.z;
+		double acx = c.x - a.x, acy = c.y - a.y, acz = c.z - a.z;
+		return { aby * acz - abz * acy, abz * acx - abx * acz, abx * acy - aby * acx };
+	}
+
+	/**
+	 * @brief The state of one mesh's simplification, kept across the levels of its chain.
+	 */
+	struct Simplifier {
+		const std::vector<Vertex3D>& vertices;
+		// Vertices that share a position share an id, and their position's quadric.
+		std::vector<uint32_t> position;
+		std::vector<bool> locked;
+		std::vector<Quadric> quadrics;
+		// The largest error of any collapse so far, as a root-mean-square distance.
+		double error = 0;
+
+		explicit Simplifier(const std::vector<Vertex3D>& vertices) : vertices(vertices) {}
+
+		bool degenerate(uint32_t a, uint32_t b, uint32_t c) const {
+			return position[a] == position[b] || position[b] == position[c] || position[a] == position[c];
+		}
+
+		void prepare(const std::vector<uint32_t>& indices) {
+			std::unordered_map<WeldKey, uint32_t, WeldKeyHash> positions;
+			std::vector<uint32_t> wedges;
+			position.resize(vertices.size());
+			for (size_t v = 0; v < vertices.size(); v++) {
+				Vertex3D point(vertices[v].x, vertices[v].y, vertices[v].z, 0, 0, 0, 0, 0);
+				auto inserted = positions.insert({ weldKey(point, 0), static_cast<uint32_t>(wedges.size()) });
+				if (inserted.second) {
+					wedges.push_back(0);
+				}
+				position[v] = inserted.first->second;
+				wedges[position[v]]++;
+			}
+
+			// Edges with one triangle are open, and edges with more are non-manifold; both lock their ends.
+			std::unordered_map<uint64_t, uint32_t> edges;
+			quadrics.assign(wedges.size(), Quadric());
+			for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+				uint32_t corners[3] = { indices[i], indices[i + 1], indices[i + 2] };
+				if (degenerate(corners[0], corners[1], corners[2])) {
+					continue;
+				}
+				for (size_t e = 0; e < 3; e++) {
+					uint64_t a = position[corners[e]], b = position[corners[(e + 1) % 3]];
+					edges[std::min(a, b) << 32 | std::max(a, b)]++;
+				}
+				auto normal = triangleNormal(vertices[corners[0]], vertices[corners[1]], vertices[corners[2]]);
+				double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+				if (length == 0) {
+					continue;
+				}
+				double a = normal[0] / length, b = normal[1] / length, c = normal[2] / length;
+				const Vertex3D& p = vertices[corners[0]];
+				double d = -(a * p.x + b * p.y + c * p.z);
+				for (auto corner : corners) {
+					quadrics[position[corner]].addPlane(a, b, c, d, length / 2);
+				}
+			}
+			std::vector<bool> lockedPosition(wedges.size(), false);
+			for (auto& edge : edges) {
+				if (edge.second != 2) {
+					lockedPosition[edge.first >> 32] = true;
+					lockedPosition[edge.first & 0xffffffff] = true;
+				}
+			}
+			locked.resize(vertices.size());
+			for (size_t v = 0; v < vertices.size(); v++) {
+				locked[v] = wedges[position[v]] > 1 || lockedPosition[position[v]];
+			}
+		}
+
+		/**
+		 * @brief Collapses the cheapest edges whose neighbourhoods do not overlap, until the mesh has
+		 * targetTriangles triangles or no more edges can be collapsed in this pass.
+		 * @return the number of collapses.
+		 */
+		size_t collapsePass(std::vector<uint32_t>& indices, size_t targetTriangles) {
+			struct Collapse {
+				uint32_t from;
+				uint32_t to;
+				double cost;
+			};
+			size_t triangleCount = indices.size() / 3;
+
+			std::vector<uint32_t> adjacencyStart(vertices.size() + 1, 0);
+			for (auto index : indices) { adjacencyStart[index + 1]++; }
+			for (size_t v = 0; v < vertices.size(); v++) { adjacencyStart[v + 1] += adjacencyStart[v]; }
+			std::vector<uint32_t> adjacency(indices.size());
+			std::vector<uint32_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+			for (size_t i = 0; i < indices.size(); i++) {
+				adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+
+			// Each edge is seen from both of its triangles; only the sighting with the lower position
+			// first is kept, and collapses towards whichever end is cheaper.
+			std::vector<Collapse> collapses;
+			for (size_t i = 0; i < indices.size(); i += 3) {
+				for (size_t e = 0; e < 3; e++) {
+					uint32_t a = indices[i + e], b = indices[i + (e + 1) % 3];
+					if (position[a] >= position[b] || (locked[a] && locked[b])) {
+						continue;
+					}
+					Quadric combined = quadrics[position[a]];
+					combined += quadrics[position[b]];
+					double toB = locked[a] ? INFINITY : combined.evaluate(vertices[b]);
+					double toA = locked[b] ? INFINITY : combined.evaluate(vertices[a]);
+					collapses.push_back(toB <= toA ? Collapse{ a, b, toB } : Collapse{ b, a, toA });
+				}
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) {
+				return x.cost < y.cost;
+			});
+
+			std::vector<bool> touched(quadrics.size(), false);
+			std::vector<uint32_t> collapseTo(vertices.size());
+			for (size_t v = 0; v < vertices.size(); v++) { collapseTo[v] = static_cast<uint32_t>(v); }
+			size_t removed = 0;
+			size_t collapsed = 0;
+			for (auto& collapse : collapses) {
+				if (triangleCount - removed <= targetTriangles) {
+					break;
+				}
+				uint32_t from = position[collapse.from], to = position[collapse.to];
+				if (touched[from] || touched[to]) {
+					continue;
+				}
+
+				// Reject collapses that would turn a surviving triangle around the moved vertex over.
+				bool flips = false;
+				size_t dying = 0;
+				for (size_t a = adjacencyStart[collapse.from]; a < adjacencyStart[collapse.from + 1] && !flips; a++) {
+					const uint32_t* corners = &indices[adjacency[a] * 3];
+					if (position[corners[0]] == to || position[corners[1]] == to || position[corners[2]] == to) {
+						dying++;
+						continue;
+					}
+					const Vertex3D* before[3];
+					const Vertex3D* after[3];
+					for (size_t c = 0; c < 3; c++) {
+						before[c] = &vertices[corners[c]];
+						after[c] = corners[c] == collapse.from ? &vertices[collapse.to] : before[c];
+					}
+					auto n0 = triangleNormal(*before[0], *before[1], *before[2]);
+					auto n1 = triangleNormal(*after[0], *after[1], *after[2]);
+					flips = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] <= 0;
+				}
+				if (flips) {
+					continue;
+				}
+
+				collapseTo[collapse.from] = collapse.to;
+				quadrics[to] += quadrics[from];
+				error = std::max(error, std::sqrt(std::max(collapse.cost, 0.0)));
+				for (size_t a = adjacencyStart[collapse.from]; a < adjacencyStart[collapse.from + 1]; a++) {
+					for (size_t c = 0; c < 3; c++) {
+						touched[position[indices[adjacency[a] * 3 + c]]] = true;
+					}
+				}
+				removed += dying;
+				collapsed++;
+			}
+
+			std::vector<uint32_t> remaining;
+			remaining.reserve(indices.size() - removed * 3);
+			for (size_t i = 0; i < indices.size(); i += 3) {
+				uint32_t a = collapseTo[indices[i]], b = collapseTo[indices[i + 1]], c = collapseTo[indices[i + 2]];
+				if (!degenerate(a, b, c)) {
+					remaining.insert(remaining.end(), { a, b, c });
+				}
+			}
+			indices = std::move(remaining);
+			return collapsed;
+		}
+	};
+}
+
+size_t generateLods(MeshData& mesh, size_t maxLevels, size_t minTriangles) {
+	size_t baseCount = mesh.baseFaceCount();
+	mesh.faces.resize(baseCount);
+	mesh.lods.clear();
+	if (baseCount / 3 < 2 * minTriangles) {
+		return 0;
+	}
+
+	Simplifier simplifier(mesh.vertices);
+	std::vector<uint32_t> indices(mesh.faces.begin(), mesh.faces.end());
+	simplifier.prepare(indices);
+	std::vector<MeshLod> lods = { MeshLod{ 0, static_cast<uint32_t>(baseCount), 0 } };
+	for (size_t level = 1; level <= maxLevels; level++) {
+		size_t previous = indices.size() / 3;
+		size_t target = previous / 2;
+		if (target < minTriangles) {
+			break;
+		}
+		while (indices.size() / 3 > target && simplifier.collapsePass(indices, target) > 0) {
+		}
+		// A level that is not much smaller than the last is not worth a draw range of its own.
+		if (indices.size() / 3 > previous * 3 / 4) {
+			break;
+		}
+		optimizeVertexCache(indices, mesh.vertices.size());
+		lods.push_back({ static_cast<uint32_t>(mesh.faces.size()), static_cast<uint32_t>(indices.size()),
+			static_cast<float>(simplifier.error) });
+		mesh.faces.insert(mesh.faces.end(), indices.begin(), indices.end());
+	}
+	if (lods.size() > 1) {
+		mesh.lods = std::move(lods);
+	}
+	return mesh.lods.empty() ? 0 : mesh.lods.size() - 1;
+}
+
+size_t buildMeshlets(MeshData& mesh, size_t minTriangles) {
+	mesh.meshlets.clear();
+	size_t baseCount = mesh.baseFaceCount();
+	size_t triangleCount = baseCount / 3;
+	if (triangleCount < minTriangles) {
+		return 0;
+	}
+
+	std::vector<std::array<float, 3>> normals(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++) {
+		auto n = triangleNormal(mesh.vertices[mesh.faces[t * 3]], mesh.vertices[mesh.faces[t * 3 + 1]],
+			mesh.vertices[mesh.faces[t * 3 + 2]]);
+		double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		normals[t] = length > 0 ? std::array<float, 3>{ float(n[0] / length), float(n[1] / length), float(n[2] / length) }
+			: std::array<float, 3>{ 0, 0, 0 };
+	}
+
+	std::vector<uint32_t> adjacencyStart(mesh.vertices.size() + 1, 0);
+	for (size_t i = 0; i < baseCount; i++) { adjacencyStart[mesh.faces[i] + 1]++; }
+	for (size_t v = 0; v < mesh.vertices.size(); v++) { adjacencyStart[v + 1] += adjacencyStart[v]; }
+	std::vector<uint32_t> adjacency(baseCount);
+	std::vector<uint32_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (size_t i = 0; i < baseCount; i++) {
+		adjacency[fill[mesh.faces[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	std::vector<bool> used(triangleCount, false);
+	// The meshlet each vertex was last added to, so membership is tested without clearing a set.
+	std::vector<uint32_t> vertexMeshlet(mesh.vertices.size(), UINT32_MAX);
+	std::vector<uint32_t> reordered;
+	reordered.reserve(mesh.faces.size());
+	// The triangles in the order they joined meshlets.
+	std::vector<uint32_t> triangles;
+	triangles.reserve(triangleCount);
+	std::vector<uint32_t> candidates;
+	size_t seed = 0;
+
+	while (true) {
+		while (seed < triangleCount && used[seed]) { seed++; }
+		if (seed == triangleCount) {
+			break;
+		}
+		auto id = static_cast<uint32_t>(mesh.meshlets.size());
+		size_t begin = reordered.size();
+		size_t vertexCount = 0;
+		std::array<float, 3> normalSum = { 0, 0, 0 };
+		candidates.assign(1, static_cast<uint32_t>(seed));
+
+		// Grow the meshlet by the neighbouring triangle that adds the fewest new vertices, preferring
+		// triangles that face the way the meshlet already does.
+		while ((reordered.size() - begin) / 3 < MESHLET_MAX_TRIANGLES) {
+			int64_t best = -1;
+			float bestScore = 0;
+			for (size_t c = 0; c < candidates.size();) {
+				uint32_t t = candidates[c];
+				if (used[t]) {
+					candidates[c] = candidates.back();
+					candidates.pop_back();
+					continue;
+				}
+				size_t added = 0;
+				for (size_t corner = 0; corner < 3; corner++) {
+					added += vertexMeshlet[mesh.faces[t * 3 + corner]] != id;
+				}
+				if (vertexCount + added <= MESHLET_MAX_VERTICES) {
+					float facing = normals[t][0] * normalSum[0] + normals[t][1] * normalSum[1] + normals[t][2] * normalSum[2];
+					float length = std::sqrt(normalSum[0] * normalSum[0] + normalSum[1] * normalSum[1] + normalSum[2] * normalSum[2]);
+					float score = float(added) - (length > 0 ? facing / length : 0);
+					if (best < 0 || score < bestScore) {
+						best = t;
+						bestScore = score;
+					}
+				}
+				c++;
+			}
+			if (best < 0) {
+				break;
+			}
+
+			used[best] = true;
+			triangles.push_back(static_cast<uint32_t>(best));
+			for (size_t axis = 0; axis < 3; axis++) { normalSum[axis] += normals[best][axis]; }
+			for (size_t corner = 0; corner < 3; corner++) {
+				uint32_t vertex = mesh.faces[best * 3 + corner];
+				reordered.push_back(vertex);
+				if (vertexMeshlet[vertex] != id) {
+					vertexMeshlet[vertex] = id;
+					vertexCount++;
+					for (size_t a = adjacencyStart[vertex]; a < adjacencyStart[vertex + 1]; a++) {
+						if (!used[adjacency[a]]) { candidates.push_back(adjacency[a]); }
+					}
+				}
+			}
+		}
+
+		// The bounding sphere is centred on the mean of the meshlet's vertices.
+		Meshlet meshlet{};
+		meshlet.indexOffset = static_cast<uint32_t>(begin);
+		meshlet.indexCount = static_cast<uint32_t>(reordered.size() - begin);
+		glm::vec3 centre(0);
+		for (size_t i = begin; i < reordered.size(); i++) {
+			const Vertex3D& v = mesh.vertices[reordered[i]];
+			centre += glm::vec3(v.x, v.y, v.z);
+		}
+		centre = centre / float(meshlet.indexCount);
+		float radius = 0;
+		for (size_t i = begin; i < reordered.size(); i++) {
+			const Vertex3D& v = mesh.vertices[reordered[i]];
+			radius = std::max(radius, glm::length(glm::vec3(v.x, v.y, v.z) - centre));
+		}
+		meshlet.center = centre;
+		meshlet.radius = radius;
+
+		// The cone's axis is the mean normal, and its cutoff the sine of the widest angle between the
+		// axis and a triangle's normal; a meshlet whose normals span a hemisphere is never culled.
+		glm::vec3 axis(normalSum[0], normalSum[1], normalSum[2]);
+		float axisLength = glm::length(axis);
+		meshlet.coneAxis = axisLength > 0 ? axis / axisLength : glm::vec3(0, 0, 1);
+		float minDot = axisLength > 0 ? 1.0f : -1.0f;
+		for (size_t i = begin / 3; i < triangles.size(); i++) {
+			const auto& n = normals[triangles[i]];
+			minDot = std::min(minDot, n[0] * meshlet.coneAxis.x + n[1] * meshlet.coneAxis.y + n[2] * meshlet.coneAxis.z);
+		}
+		meshlet.coneCutoff = minDot <= 0 ? 1.0f : std::sqrt(1 - minDot * minDot);
+		mesh.meshlets.push_back(meshlet);
+	}
+
+	// Each meshlet's triangles are put back into cache order, on indices local to the meshlet so
+	// the pass only touches its few vertices; the meshlet keeps its range.
+	std::vector<uint32_t> local;
+	std::vector<uint32_t> global;
+	std::vector<uint32_t> localIndex(mesh.vertices.size(), UINT32_MAX);
+	for (auto& meshlet : mesh.meshlets) {
+		auto first = reordered.begin() + meshlet.indexOffset;
+		local.clear();
+		global.clear();
+		for (auto it = first; it != first + meshlet.indexCount; ++it) {
+			if (localIndex[*it] == UINT32_MAX) {
+				localIndex[*it] = static_cast<uint32_t>(global.size());
+				global.push_back(*it);
+			}
+			local.push_back(localIndex[*it]);
+		}
+		optimizeVertexCache(local, global.size());
+		for (size_t i = 0; i < local.size(); i++) {
+			first[i] = global[local[i]];
+		}
+		for (auto vertex : global) {
+			localIndex[vertex] = UINT32_MAX;
+		}
+	}
+	std::copy(reordered.begin(), reordered.end(), mesh.faces.begin());
+	return mesh.meshlets.size();
+}
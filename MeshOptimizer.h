@@ -0,0 +1,116 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "ModelData.h"
+
+/**
+ * @brief Before-and-after figures for a vertex weld.
+ */
+struct WeldStats {
+	size_t verticesBefore = 0;
+	size_t verticesAfter = 0;
+	// Post-transform vertex cache misses over the mesh's indices, before and after.
+	size_t cacheMissesBefore = 0;
+	size_t cacheMissesAfter = 0;
+	size_t indexCount = 0;
+
+	WeldStats& operator+=(const WeldStats& other);
+};
+
+/**
+ * @brief The number of entries in the simulated post-transform vertex cache.
+ */
+const size_t VERTEX_CACHE_SIZE = 32;
+
+/**
+ * @brief Simulates a FIFO post-transform vertex cache over an index buffer.
+ * @return the number of indices that miss the cache, and so run the vertex shader.
+ */
+size_t countCacheMisses(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+	size_t cacheSize = VERTEX_CACHE_SIZE);
+
+/**
+ * @brief Merges duplicate vertices and remaps the mesh's indices to the survivors, keeping the
+ * vertices in first-use order. With an epsilon of 0 only bit-identical vertices merge; otherwise
+ * every attribute is snapped to a grid of that spacing before comparing, so vertices within about
+ * epsilon of each other merge, while pairs that straddle a grid line may not.
+ */
+WeldStats weldVertices(MeshData& mesh, float epsilon = 0);
+
+/**
+ * @brief How well an index buffer uses the post-transform vertex cache.
+ */
+struct CacheStats {
+	// Average cache miss ratio: vertex shader runs per triangle, 0.5 at best and 3 at worst.
+	double acmr = 0;
+	// Average transform to vertex ratio: vertex shader runs per vertex, 1 at best.
+	double atvr = 0;
+};
+
+/**
+ * @brief Measures a mesh's ACMR and ATVR against a FIFO cache of the given size.
+ */
+CacheStats measureVertexCache(const MeshData& mesh, size_t cacheSize = VERTEX_CACHE_SIZE);
+CacheStats measureVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount,
+	size_t cacheSize = VERTEX_CACHE_SIZE);
+
+/**
+ * @brief Reorders the mesh's triangles for the post-transform cache with Tipsify (Sander, Nehab,
+ * and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", 2007).
+ * @param clusters if given, receives the index offset of each run of triangles that starts after
+ * the cache was flushed; reordering whole runs barely changes the cache behaviour.
+ */
+void optimizeVertexCache(MeshData& mesh, size_t cacheSize = VERTEX_CACHE_SIZE,
+	std::vector<size_t>* clusters = nullptr);
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, size_t cacheSize = VERTEX_CACHE_SIZE,
+	std::vector<size_t>* clusters = nullptr);
+
+/**
+ * @brief Sorts the runs optimizeVertexCache found so that those facing away from the mesh's
+ * centre draw first, which lets outer surfaces occlude inner ones from most viewpoints. The new
+ * order is kept only if the ACMR stays within the threshold times the old one.
+ */
+void optimizeOverdraw(MeshData& mesh, const std::vector<size_t>& clusters, float threshold = 1.05f,
+	size_t cacheSize = VERTEX_CACHE_SIZE);
+
+/**
+ * @brief Reorders the mesh's vertices into the order its indices first use them, so vertex fetch
+ * reads memory sequentially.
+ */
+void optimizeVertexFetch(MeshData& mesh);
+
+/**
+ * @brief Runs the cache, optional overdraw, and vertex fetch passes over a mesh.
+ * @return the mesh's cache figures before and after.
+ */
+std::pair<CacheStats, CacheStats> optimizeMesh(MeshData& mesh, bool overdraw = true);
+
+/**
+ * @brief Builds a chain of coarser levels of detail by quadric-error edge collapse (Garland and
+ * Heckbert, "Surface Simplification Using Quadric Error Metrics", 1997). Each level has about half
+ * the triangles of the one before; its indices are appended to mesh.faces and described in
+ * mesh.lods, and reuse the mesh's vertices, so every level shares one vertex buffer. Vertices on
+ * open edges or attribute seams never move, which keeps silhouettes and texture seams intact.
+ * Levels stop at maxLevels, at minTriangles, or when a level cannot be halved without moving them.
+ * @return the number of levels added.
+ */
+size_t generateLods(MeshData& mesh, size_t maxLevels = 4, size_t minTriangles = 64);
+
+/**
+ * @brief Limits on the size of a meshlet, chosen to match the vertex and primitive counts that
+ * mesh-shading hardware is built around.
+ */
+const size_t MESHLET_MAX_VERTICES = 64;
+const size_t MESHLET_MAX_TRIANGLES = 124;
+
+/**
+ * @brief Splits the mesh's full-detail triangles into meshlets: clusters of nearby, similarly
+ * facing triangles, each a contiguous range of mesh.faces, with a bounding sphere and a cone around
+ * its normals for culling. Clusters grow from the triangles in their current order, so the mesh's
+ * cache order survives within and between meshlets. Coarser levels of detail are left alone.
+ * Meshes with fewer than minTriangles triangles gain too little from culling to be split.
+ * @return the number of meshlets.
+ */
+size_t buildMeshlets(MeshData& mesh, size_t minTriangles = 1024);
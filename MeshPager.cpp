@@ -0,0 +1,33 @@
+/**
+Splits a scan too large to load whole into spatially coherent pages, which the renderer streams in
+as the view moves.
+
+Usage: mesh_pager <scan.ply> <page file> [triangles per page]
+*/
+
+#include "MeshPages.h"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+int main(int argc, char* argv[]) {
+	if (argc != 3 && argc != 4) {
+		std::cerr << "Usage: " << argv[0] << " <scan.ply> <page file> [triangles per page]" << std::endl;
+		return 1;
+	}
+	try {
+		MeshPagerOptions options;
+		if (argc == 4) {
+			options.pageTriangles = std::stoul(argv[3]);
+			if (options.pageTriangles == 0) {
+				throw std::runtime_error("Pages must hold at least one triangle");
+			}
+		}
+		buildMeshPages(argv[1], argv[2], options);
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
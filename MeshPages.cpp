@@ -0,0 +1,792 @@
+#include "MeshPages.h"
+#include "MeshOptimizer.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+
+static_assert(std::is_trivially_copyable<MeshPage>::value, "MeshPage must be trivially copyable to be stored");
+static_assert(sizeof(Vertex3D) % 16 == 0, "Each page's faces must follow its vertices on a 16-byte boundary");
+static_assert(alignof(MeshLod) <= sizeof(uint32_t) && alignof(Meshlet) <= sizeof(uint32_t),
+	"Levels of detail and meshlets must follow a page's faces without padding");
+
+namespace {
+	const char MAGIC[4] = { 'M', 'S', 'M', 'P' };
+	const uint32_t VERSION = 1;
+	// Every page starts on this alignment, so its arrays can be used in place once read.
+	const size_t PAGE_ALIGNMENT = 16;
+	// Buckets are split on disk into this many cells along each axis.
+	const uint32_t BUCKET_GRID = 4;
+
+	struct FileHeader {
+		char magic[4];
+		uint32_t version;
+		uint64_t triangleCount;
+		float bounds[4];
+		uint64_t tableOffset;
+		uint32_t pageCount;
+		uint32_t padding;
+	};
+
+	enum class PlyType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64 };
+
+	PlyType plyType(const std::string& name) {
+		if (name == "char" || name == "int8") { return PlyType::Int8; }
+		if (name == "uchar" || name == "uint8") { return PlyType::UInt8; }
+		if (name == "short" || name == "int16") { return PlyType::Int16; }
+		if (name == "ushort" || name == "uint16") { return PlyType::UInt16; }
+		if (name == "int" || name == "int32") { return PlyType::Int32; }
+		if (name == "uint" || name == "uint32") { return PlyType::UInt32; }
+		if (name == "float" || name == "float32") { return PlyType::Float32; }
+		if (name == "double" || name == "float64") { return PlyType::Float64; }
+		throw std::runtime_error("Unknown PLY property type " + name);
+	}
+
+	size_t plyTypeSize(PlyType type) {
+		switch (type) {
+		case PlyType::Int8: case PlyType::UInt8: return 1;
+		case PlyType::Int16: case PlyType::UInt16: return 2;
+		case PlyType::Int32: case PlyType::UInt32: case PlyType::Float32: return 4;
+		case PlyType::Float64: return 8;
+		}
+		return 0;
+	}
+
+	template <typename T>
+	T readValue(const uint8_t* data) {
+		T value;
+		memcpy(&value, data, sizeof(T));
+		return value;
+	}
+
+	double readPly(PlyType type, const uint8_t* data) {
+		switch (type) {
+		case PlyType::Int8: return readValue<int8_t>(data);
+		case PlyType::UInt8: return readValue<uint8_t>(data);
+		case PlyType::Int16: return readValue<int16_t>(data);
+		case PlyType::UInt16: return readValue<uint16_t>(data);
+		case PlyType::Int32: return readValue<int32_t>(data);
+		case PlyType::UInt32: return readValue<uint32_t>(data);
+		case PlyType::Float32: return readValue<float>(data);
+		case PlyType::Float64: return readValue<double>(data);
+		}
+		return 0;
+	}
+
+	struct PlyProperty {
+		std::string name;
+		PlyType type;
+		// List properties store a count of this type, then that many values of type.
+		bool list = false;
+		PlyType countType = PlyType::UInt8;
+	};
+
+	struct PlyElement {
+		std::string name;
+		uint64_t count;
+		std::vector<PlyProperty> properties;
+	};
+
+	/**
+	 * @brief Where one vertex property is within a vertex, and its type; an offset of -1 if absent.
+	 */
+	struct PlyField {
+		long offset = -1;
+		PlyType type = PlyType::Float32;
+
+		float read(const uint8_t* vertex) const {
+			return type == PlyType::Float32 ? readValue<float>(vertex + offset)
+				: static_cast<float>(readPly(type, vertex + offset));
+		}
+	};
+
+	/**
+	 * @brief A mapped binary PLY scan: its vertices, which are read in place, and its faces.
+	 */
+	struct PlyScan {
+		MappedFile file;
+		const uint8_t* vertices = nullptr;
+		uint64_t vertexCount = 0;
+		size_t vertexStride = 0;
+		PlyField position[3];
+		PlyField normal[3];
+		PlyField texCoord[2];
+		bool flipTextureCoords = true;
+
+		const uint8_t* faces = nullptr;
+		uint64_t faceCount = 0;
+		// The bytes of the face's scalar properties before and after its index list.
+		size_t faceBefore = 0;
+		size_t faceAfter = 0;
+		PlyType countType = PlyType::UInt8;
+		PlyType indexType = PlyType::Int32;
+
+		bool hasNormals() const { return normal[0].offset >= 0; }
+
+		glm::vec3 positionOf(uint32_t index) const {
+			const uint8_t* vertex = vertices + size_t(index) * vertexStride;
+			return glm::vec3(position[0].read(vertex), position[1].read(vertex), position[2].read(vertex));
+		}
+
+		Vertex3D vertexOf(uint32_t index) const {
+			const uint8_t* vertex = vertices + size_t(index) * vertexStride;
+			Vertex3D result(position[0].read(vertex), position[1].read(vertex), position[2].read(vertex), 0, 0, 0, 0, 0);
+			if (hasNormals()) {
+				result.nx = normal[0].read(vertex);
+				result.ny = normal[1].read(vertex);
+				result.nz = normal[2].read(vertex);
+			}
+			if (texCoord[0].offset >= 0) {
+				result.u = texCoord[0].read(vertex);
+				result.v = texCoord[1].read(vertex);
+				if (flipTextureCoords) {
+					result.v = 1 - result.v;
+				}
+			}
+			return result;
+		}
+
+		/**
+		 * @brief Calls onTriangle(a, b, c) for every triangle of every face, in file order, with
+		 * polygons split into fans.
+		 */
+		template <typename F>
+		void forEachTriangle(F&& onTriangle) const {
+			const uint8_t* end = file.data() + file.size();
+			const uint8_t* face = faces;
+			size_t countSize = plyTypeSize(countType);
+			size_t indexSize = plyTypeSize(indexType);
+			for (uint64_t f = 0; f < faceCount; f++) {
+				if (size_t(end - face) < faceBefore + countSize) {
+					throw std::runtime_error("PLY face list is truncated");
+				}
+				face += faceBefore;
+				auto count = static_cast<size_t>(readPly(countType, face));
+				face += countSize;
+				if (size_t(end - face) < count * indexSize + faceAfter) {
+					throw std::runtime_error("PLY face list is truncated");
+				}
+				auto index = [&](size_t i) {
+					auto value = static_cast<int64_t>(readPly(indexType, face + i * indexSize));
+					if (value < 0 || uint64_t(value) >= vertexCount) {
+						throw std::runtime_error("PLY face refers to a vertex that does not exist");
+					}
+					return static_cast<uint32_t>(value);
+				};
+				for (size_t i = 2; i < count; i++) {
+					onTriangle(index(0), index(i - 1), index(i));
+				}
+				face += count * indexSize + faceAfter;
+			}
+		}
+	};
+
+	size_t elementStride(const PlyElement& element) {
+		size_t stride = 0;
+		for (auto& property : element.properties) {
+			if (property.list) {
+				return 0;
+			}
+			stride += plyTypeSize(property.type);
+		}
+		return stride;
+	}
+
+	/**
+	 * @brief Skips an element's data, which for elements with list properties means reading every count.
+	 */
+	const uint8_t* skipElement(const PlyElement& element, const uint8_t* data, const uint8_t* end) {
+		size_t stride = elementStride(element);
+		if (stride > 0) {
+			if (element.count > uint64_t(end - data) / stride) {
+				throw std::runtime_error("PLY element " + element.name + " is truncated");
+			}
+			return data + element.count * stride;
+		}
+		for (uint64_t i = 0; i < element.count; i++) {
+			for (auto& property : element.properties) {
+				size_t size = plyTypeSize(property.list ? property.countType : property.type);
+				if (size_t(end - data) < size) {
+					throw std::runtime_error("PLY element " + element.name + " is truncated");
+				}
+				if (property.list) {
+					auto count = static_cast<size_t>(readPly(property.countType, data));
+					size += count * plyTypeSize(property.type);
+					if (size_t(end - data) < size) {
+						throw std::runtime_error("PLY element " + element.name + " is truncated");
+					}
+				}
+				data += size;
+			}
+		}
+		return data;
+	}
+
+	void openPly(PlyScan& scan, const std::string& path) {
+		if (!scan.file.open(path)) {
+			throw std::runtime_error("Could not open " + path);
+		}
+		const char* text = reinterpret_cast<const char*>(scan.file.data());
+		std::string start(text, std::min<size_t>(scan.file.size(), 1 << 16));
+		auto headerEnd = start.find("end_header");
+		if (start.compare(0, 3, "ply") != 0 || headerEnd == std::string::npos) {
+			throw std::runtime_error(path + " is not a PLY file");
+		}
+		size_t dataOffset = start.find('\n', headerEnd);
+		if (dataOffset == std::string::npos) {
+			throw std::runtime_error(path + " is not a PLY file");
+		}
+
+		std::istringstream header(start.substr(0, headerEnd));
+		std::vector<PlyElement> elements;
+		std::string line;
+		while (std::getline(header, line)) {
+			std::istringstream words(line);
+			std::string keyword;
+			words >> keyword;
+			if (keyword == "format") {
+				std::string format;
+				words >> format;
+				if (format != "binary_little_endian") {
+					throw std::runtime_error(path + " is " + format + "; only binary_little_endian PLY files can be paged");
+				}
+			}
+			else if (keyword == "element") {
+				PlyElement element;
+				words >> element.name >> element.count;
+				elements.push_back(element);
+			}
+			else if (keyword == "property" && !elements.empty()) {
+				PlyProperty property;
+				std::string type;
+				words >> type;
+				if (type == "list") {
+					std::string countType;
+					words >> countType >> type;
+					property.list = true;
+					property.countType = plyType(countType);
+				}
+				property.type = plyType(type);
+				words >> property.name;
+				elements.back().properties.push_back(property);
+			}
+		}
+
+		const uint8_t* data = scan.file.data() + dataOffset + 1;
+		const uint8_t* end = scan.file.data() + scan.file.size();
+		for (auto& element : elements) {
+			if (element.name == "vertex") {
+				scan.vertices = data;
+				scan.vertexCount = element.count;
+				scan.vertexStride = elementStride(element);
+				if (scan.vertexStride == 0) {
+					throw std::runtime_error("PLY vertices with list properties are not supported");
+				}
+				const char* names[8][4] = {
+					{ "x" }, { "y" }, { "z" }, { "nx" }, { "ny" }, { "nz" },
+					{ "u", "s", "texture_u", "texture_s" }, { "v", "t", "texture_v", "texture_t" },
+				};
+				PlyField* fields[8] = { &scan.position[0], &scan.position[1], &scan.position[2], &scan.normal[0],
+					&scan.normal[1], &scan.normal[2], &scan.texCoord[0], &scan.texCoord[1] };
+				long offset = 0;
+				for (auto& property : element.properties) {
+					for (int f = 0; f < 8; f++) {
+						for (auto name : names[f]) {
+							if (name != nullptr && property.name == name) {
+								fields[f]->offset = offset;
+								fields[f]->type = property.type;
+							}
+						}
+					}
+					offset += static_cast<long>(plyTypeSize(property.type));
+				}
+				if (scan.position[0].offset < 0 || scan.position[1].offset < 0 || scan.position[2].offset < 0) {
+					throw std::runtime_error(path + " has no vertex positions");
+				}
+				// Normals and texture coordinates are used only when all of their components are present.
+				if (scan.normal[0].offset < 0 || scan.normal[1].offset < 0 || scan.normal[2].offset < 0) {
+					scan.normal[0].offset = -1;
+				}
+				if (scan.texCoord[0].offset < 0 || scan.texCoord[1].offset < 0) {
+					scan.texCoord[0].offset = -1;
+				}
+			}
+			else if (element.name == "face") {
+				scan.faces = data;
+				scan.faceCount = element.count;
+				size_t* side = &scan.faceBefore;
+				bool found = false;
+				for (auto& property : element.properties) {
+					if (property.list && !found && (property.name == "vertex_indices" || property.name == "vertex_index")) {
+						scan.countType = property.countType;
+						scan.indexType = property.type;
+						side = &scan.faceAfter;
+						found = true;
+					}
+					else if (property.list) {
+						throw std::runtime_error("PLY faces with list properties other than their vertex indices are not supported");
+					}
+					else {
+						*side += plyTypeSize(property.type);
+					}
+				}
+				if (!found) {
+					throw std::runtime_error(path + " has no face vertex indices");
+				}
+			}
+			// Skipping the faces reads all of them, so elements after both are never reached.
+			if (scan.vertices != nullptr && scan.faces != nullptr) {
+				break;
+			}
+			data = skipElement(element, data, end);
+		}
+		if (scan.vertices == nullptr || scan.faces == nullptr) {
+			throw std::runtime_error(path + " has no vertices or no faces");
+		}
+		if (scan.vertexCount > UINT32_MAX) {
+			throw std::runtime_error(path + " has more vertices than 32-bit indices can address");
+		}
+	}
+
+	/**
+	 * @brief A triangle waiting to be paged: its vertices' indices in the scan, and its centroid.
+	 */
+	struct TriangleRecord {
+		uint32_t vertices[3];
+		glm::vec3 centroid;
+	};
+
+	/**
+	 * @brief A file of TriangleRecords, and the box around their centroids.
+	 */
+	struct Bucket {
+		std::filesystem::path path;
+		uint64_t count = 0;
+		glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+	};
+
+	/**
+	 * @brief Sorts TriangleRecords into bucket files by which cell of a grid over a box their
+	 * centroids fall in.
+	 */
+	class BucketWriter {
+	private:
+		std::vector<Bucket> m_buckets;
+		std::vector<std::ofstream> m_streams;
+		std::vector<std::vector<char>> m_buffers;
+		glm::vec3 m_min;
+		glm::vec3 m_cellsPerUnit;
+
+	public:
+		BucketWriter(const std::filesystem::path& directory, size_t& nextBucket, const glm::vec3& min, const glm::vec3& max)
+			: m_buckets(BUCKET_GRID * BUCKET_GRID * BUCKET_GRID), m_streams(m_buckets.size()), m_buffers(m_buckets.size()),
+			m_min(min) {
+			glm::vec3 extent = max - min;
+			for (int axis = 0; axis < 3; axis++) {
+				m_cellsPerUnit[axis] = extent[axis] > 0 ? BUCKET_GRID / extent[axis] : 0;
+			}
+			for (size_t b = 0; b < m_buckets.size(); b++) {
+				m_buckets[b].path = directory / ("bucket-" + std::to_string(nextBucket++));
+				m_buffers[b].resize(1 << 16);
+				m_streams[b].rdbuf()->pubsetbuf(m_buffers[b].data(), static_cast<std::streamsize>(m_buffers[b].size()));
+				m_streams[b].open(m_buckets[b].path, std::ios::binary | std::ios::trunc);
+				if (!m_streams[b]) {
+					throw std::runtime_error("Could not write " + m_buckets[b].path.string());
+				}
+			}
+		}
+
+		void add(const TriangleRecord& record) {
+			size_t cell = 0;
+			for (int axis = 2; axis >= 0; axis--) {
+				auto c = static_cast<uint32_t>((record.centroid[axis] - m_min[axis]) * m_cellsPerUnit[axis]);
+				cell = cell * BUCKET_GRID + std::min(c, BUCKET_GRID - 1);
+			}
+			Bucket& bucket = m_buckets[cell];
+			m_streams[cell].write(reinterpret_cast<const char*>(&record), sizeof(record));
+			bucket.count++;
+			bucket.min = glm::min(bucket.min, record.centroid);
+			bucket.max = glm::max(bucket.max, record.centroid);
+		}
+
+		/**
+		 * @brief Closes every bucket file, and returns the buckets that are not empty.
+		 */
+		std::vector<Bucket> finish() {
+			std::vector<Bucket> filled;
+			for (size_t b = 0; b < m_buckets.size(); b++) {
+				m_streams[b].close();
+				if (!m_streams[b]) {
+					throw std::runtime_error("Could not write " + m_buckets[b].path.string());
+				}
+				if (m_buckets[b].count > 0) {
+					filled.push_back(m_buckets[b]);
+				}
+				else {
+					std::filesystem::remove(m_buckets[b].path);
+				}
+			}
+			return filled;
+		}
+	};
+
+	/**
+	 * @brief Reads a bucket's records in order, up to limit at a time.
+	 */
+	template <typename F>
+	void readBucket(const Bucket& bucket, size_t limit, F&& onRecords) {
+		std::ifstream in(bucket.path, std::ios::binary);
+		std::vector<TriangleRecord> records;
+		for (uint64_t read = 0; read < bucket.count;) {
+			records.resize(static_cast<size_t>(std::min<uint64_t>(limit, bucket.count - read)));
+			in.read(reinterpret_cast<char*>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(TriangleRecord)));
+			if (!in) {
+				throw std::runtime_error("Could not read " + bucket.path.string());
+			}
+			read += records.size();
+			onRecords(records);
+		}
+	}
+
+	/**
+	 * @brief Writes pages to a page file, and records them in its table.
+	 */
+	class PageWriter {
+	private:
+		std::ofstream m_out;
+		uint64_t m_offset = 0;
+		uint64_t m_triangles = 0;
+		std::vector<MeshPage> m_pages;
+
+		void pad(size_t alignment) {
+			static const char zeros[PAGE_ALIGNMENT] = {};
+			size_t padding = static_cast<size_t>((alignment - m_offset % alignment) % alignment);
+			m_out.write(zeros, static_cast<std::streamsize>(padding));
+			m_offset += padding;
+		}
+
+		void write(const void* data, size_t size) {
+			m_out.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+			m_offset += size;
+		}
+
+	public:
+		explicit PageWriter(const std::filesystem::path& path) : m_out(path, std::ios::binary | std::ios::trunc) {
+			FileHeader header{};
+			write(&header, sizeof(header));
+			if (!m_out) {
+				throw std::runtime_error("Could not write " + path.string());
+			}
+		}
+
+		size_t pageCount() const { return m_pages.size(); }
+		uint64_t bytes() const { return m_offset; }
+
+		void add(const MeshData& mesh) {
+			pad(PAGE_ALIGNMENT);
+			MeshPage page;
+			page.offset = m_offset;
+			page.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+			page.faceCount = static_cast<uint32_t>(mesh.faces.size());
+			page.lodCount = static_cast<uint32_t>(mesh.lods.size());
+			page.meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+			// The same sphere MeshGeometry::upload finds: centred on the mean vertex.
+			glm::vec3 centre(0);
+			for (auto& vertex : mesh.vertices) {
+				centre += glm::vec3(vertex.x, vertex.y, vertex.z);
+			}
+			centre /= std::max<size_t>(mesh.vertices.size(), 1);
+			float radius = 0;
+			for (auto& vertex : mesh.vertices) {
+				radius = std::max(radius, glm::length(glm::vec3(vertex.x, vertex.y, vertex.z) - centre));
+			}
+			page.bounds = glm::vec4(centre, radius);
+			write(mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex3D));
+			write(mesh.faces.data(), mesh.faces.size() * sizeof(uint32_t));
+			write(mesh.lods.data(), mesh.lods.size() * sizeof(MeshLod));
+			write(mesh.meshlets.data(), mesh.meshlets.size() * sizeof(Meshlet));
+			m_pages.push_back(page);
+			m_triangles += mesh.baseFaceCount() / 3;
+		}
+
+		/**
+		 * @brief Writes the page table and the header, which points to it.
+		 */
+		void finish(const std::filesystem::path& path) {
+			pad(alignof(MeshPage));
+			FileHeader header{};
+			memcpy(header.magic, MAGIC, sizeof(MAGIC));
+			header.version = VERSION;
+			header.triangleCount = m_triangles;
+			header.tableOffset = m_offset;
+			header.pageCount = static_cast<uint32_t>(m_pages.size());
+			// A sphere around the pages' spheres, centred on the middle of the box around them.
+			glm::vec3 min(std::numeric_limits<float>::max()), max(-std::numeric_limits<float>::max());
+			for (auto& page : m_pages) {
+				min = glm::min(min, glm::vec3(page.bounds) - glm::vec3(page.bounds.w));
+				max = glm::max(max, glm::vec3(page.bounds) + glm::vec3(page.bounds.w));
+			}
+			glm::vec3 centre = m_pages.empty() ? glm::vec3(0) : (min + max) / 2.0f;
+			float radius = 0;
+			for (auto& page : m_pages) {
+				radius = std::max(radius, glm::length(glm::vec3(page.bounds) - centre) + page.bounds.w);
+			}
+			header.bounds[0] = centre.x;
+			header.bounds[1] = centre.y;
+			header.bounds[2] = centre.z;
+			header.bounds[3] = radius;
+			write(m_pages.data(), m_pages.size() * sizeof(MeshPage));
+			m_out.seekp(0);
+			m_out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			m_out.close();
+			if (!m_out) {
+				throw std::runtime_error("Could not write " + path.string());
+			}
+		}
+	};
+
+	/**
+	 * @brief Builds one page from a range of triangle records: its own copy of the vertices they
+	 * use, optimized, clustered, and simplified as imported meshes are.
+	 */
+	MeshData buildPage(const PlyScan& scan, const TriangleRecord* records, size_t count) {
+		MeshData mesh;
+		std::unordered_map<uint32_t, uint32_t> remap;
+		remap.reserve(count * 2);
+		mesh.faces.reserve(count * 3);
+		for (size_t t = 0; t < count; t++) {
+			for (uint32_t vertex : records[t].vertices) {
+				auto inserted = remap.insert(std::make_pair(vertex, static_cast<uint32_t>(mesh.vertices.size())));
+				if (inserted.second) {
+					mesh.vertices.push_back(scan.vertexOf(vertex));
+				}
+				mesh.faces.push_back(inserted.first->second);
+			}
+		}
+		if (!scan.hasNormals()) {
+			// Area-weighted face normals, summed at each vertex.
+			std::vector<glm::vec3> normals(mesh.vertices.size(), glm::vec3(0));
+			for (size_t f = 0; f < mesh.faces.size(); f += 3) {
+				glm::vec3 p[3];
+				for (int k = 0; k < 3; k++) {
+					const Vertex3D& vertex = mesh.vertices[mesh.faces[f + k]];
+					p[k] = glm::vec3(vertex.x, vertex.y, vertex.z);
+				}
+				glm::vec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+				for (int k = 0; k < 3; k++) {
+					normals[mesh.faces[f + k]] += normal;
+				}
+			}
+			for (size_t v = 0; v < mesh.vertices.size(); v++) {
+				float length = glm::length(normals[v]);
+				glm::vec3 normal = length > 0 ? normals[v] / length : glm::vec3(0, 0, 1);
+				mesh.vertices[v].nx = normal.x;
+				mesh.vertices[v].ny = normal.y;
+				mesh.vertices[v].nz = normal.z;
+			}
+		}
+		optimizeMesh(mesh);
+		buildMeshlets(mesh);
+		generateLods(mesh);
+		return mesh;
+	}
+
+	/**
+	 * @brief Splits records at the median of their centroids' longest axis until each range fits
+	 * in a page, appending the ranges in order.
+	 */
+	void splitRecords(TriangleRecord* records, size_t count, size_t pageTriangles,
+		std::vector<std::pair<size_t, size_t>>& pages, size_t first = 0) {
+		if (count <= pageTriangles) {
+			pages.emplace_back(first, count);
+			return;
+		}
+		glm::vec3 min(std::numeric_limits<float>::max()), max(-std::numeric_limits<float>::max());
+		for (size_t t = 0; t < count; t++) {
+			min = glm::min(min, records[t].centroid);
+			max = glm::max(max, records[t].centroid);
+		}
+		glm::vec3 extent = max - min;
+		int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+		size_t half = count / 2;
+		std::nth_element(records, records + half, records + count, [axis](const TriangleRecord& a, const TriangleRecord& b) {
+			return a.centroid[axis] < b.centroid[axis];
+		});
+		splitRecords(records, half, pageTriangles, pages, first);
+		splitRecords(records + half, count - half, pageTriangles, pages, first + half);
+	}
+
+	/**
+	 * @brief Splits records that fit in memory into pages, and writes them. Pages are built on the
+	 * shared ThreadPool a batch at a time, so only one batch of them is held in memory.
+	 */
+	void writePages(const PlyScan& scan, std::vector<TriangleRecord>& records, const MeshPagerOptions& options,
+		PageWriter& writer) {
+		std::vector<std::pair<size_t, size_t>> ranges;
+		splitRecords(records.data(), records.size(), options.pageTriangles, ranges);
+		ThreadPool& pool = ThreadPool::shared();
+		size_t batchSize = pool.size() * 2;
+		for (size_t start = 0; start < ranges.size(); start += batchSize) {
+			std::vector<MeshData> pages(std::min(batchSize, ranges.size() - start));
+			pool.parallelFor(pages.size(), [&](size_t i) {
+				auto& range = ranges[start + i];
+				pages[i] = buildPage(scan, records.data() + range.first, range.second);
+			});
+			for (auto& page : pages) {
+				writer.add(page);
+			}
+		}
+	}
+
+	/**
+	 * @brief Pages a bucket: in memory if it is small enough, or else by splitting it into smaller
+	 * buckets on disk first. A bucket whose centroids all fall in one cell cannot be split by the
+	 * grid, and is paged in memory-sized pieces instead.
+	 */
+	void pageBucket(const PlyScan& scan, Bucket bucket, const std::filesystem::path& directory, size_t& nextBucket,
+		const MeshPagerOptions& options, PageWriter& writer) {
+		if (bucket.count > options.bucketTriangles) {
+			BucketWriter children(directory, nextBucket, bucket.min, bucket.max);
+			readBucket(bucket, size_t(1) << 16, [&](const std::vector<TriangleRecord>& records) {
+				for (auto& record : records) {
+					children.add(record);
+				}
+			});
+			std::filesystem::remove(bucket.path);
+			auto filled = children.finish();
+			if (filled.size() > 1) {
+				for (auto& child : filled) {
+					pageBucket(scan, child, directory, nextBucket, options, writer);
+				}
+				return;
+			}
+			bucket = filled[0];
+		}
+		readBucket(bucket, options.bucketTriangles, [&](std::vector<TriangleRecord>& records) {
+			writePages(scan, records, options, writer);
+		});
+		std::filesystem::remove(bucket.path);
+	}
+}
+
+size_t MeshPage::fileBytes() const {
+	return vertexCount * sizeof(Vertex3D) + faceCount * sizeof(uint32_t) + lodCount * sizeof(MeshLod)
+		+ meshletCount * sizeof(Meshlet);
+}
+
+size_t MeshPage::gpuBytes() const {
+	return vertexCount * sizeof(Vertex3D) + faceCount * sizeof(uint32_t);
+}
+
+MeshPageView viewPage(const MeshPage& page, const uint8_t* data) {
+	MeshPageView view;
+	view.vertices = reinterpret_cast<const Vertex3D*>(data);
+	data += page.vertexCount * sizeof(Vertex3D);
+	view.faces = reinterpret_cast<const uint32_t*>(data);
+	data += page.faceCount * sizeof(uint32_t);
+	view.lods = reinterpret_cast<const MeshLod*>(data);
+	data += page.lodCount * sizeof(MeshLod);
+	view.meshlets = reinterpret_cast<const Meshlet*>(data);
+	return view;
+}
+
+MeshPageTable MeshPageTable::read(const MappedFile& file) {
+	FileHeader header;
+	if (file.size() < sizeof(header)) {
+		throw std::runtime_error("Page file is truncated");
+	}
+	memcpy(&header, file.data(), sizeof(header));
+	if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+		throw std::runtime_error("Not a page file");
+	}
+	if (header.version != VERSION) {
+		throw std::runtime_error("Page file is version " + std::to_string(header.version) + ", expected "
+			+ std::to_string(VERSION) + "; page the scan again");
+	}
+	if (header.tableOffset > file.size() || (file.size() - header.tableOffset) / sizeof(MeshPage) < header.pageCount) {
+		throw std::runtime_error("Page file is truncated");
+	}
+	MeshPageTable table;
+	table.triangleCount = header.triangleCount;
+	table.bounds = glm::vec4(header.bounds[0], header.bounds[1], header.bounds[2], header.bounds[3]);
+	table.pages.resize(header.pageCount);
+	memcpy(table.pages.data(), file.data() + header.tableOffset, header.pageCount * sizeof(MeshPage));
+	for (auto& page : table.pages) {
+		if (page.offset > header.tableOffset || page.fileBytes() > header.tableOffset - page.offset) {
+			throw std::runtime_error("Page file is truncated");
+		}
+	}
+	return table;
+}
+
+void buildMeshPages(const std::string& scanPath, const std::string& pagesPath, const MeshPagerOptions& options) {
+	auto start = std::chrono::steady_clock::now();
+	PlyScan scan;
+	scan.flipTextureCoords = options.flipTextureCoords;
+	openPly(scan, scanPath);
+
+	// Bucket files and the page file are written alongside the output, and the page file is renamed
+	// into place when it is complete.
+	std::filesystem::path output(pagesPath);
+	std::filesystem::path directory = output;
+	directory += ".buckets";
+	std::filesystem::path tempPath = output;
+	tempPath += ".tmp";
+	std::filesystem::create_directories(directory);
+	size_t nextBucket = 0;
+
+	// The first pass buckets every triangle by its centroid, within the box around the vertices.
+	glm::vec3 min(std::numeric_limits<float>::max()), max(-std::numeric_limits<float>::max());
+	for (uint64_t v = 0; v < scan.vertexCount; v++) {
+		glm::vec3 position = scan.positionOf(static_cast<uint32_t>(v));
+		min = glm::min(min, position);
+		max = glm::max(max, position);
+	}
+	std::vector<Bucket> buckets;
+	size_t pageCount = 0;
+	uint64_t pageBytes = 0;
+	try {
+		{
+			BucketWriter writer(directory, nextBucket, min, max);
+			scan.forEachTriangle([&](uint32_t a, uint32_t b, uint32_t c) {
+				TriangleRecord record = { { a, b, c }, (scan.positionOf(a) + scan.positionOf(b) + scan.positionOf(c)) / 3.0f };
+				writer.add(record);
+			});
+			buckets = writer.finish();
+		}
+		PageWriter writer(tempPath);
+		for (auto& bucket : buckets) {
+			pageBucket(scan, bucket, directory, nextBucket, options, writer);
+		}
+		writer.finish(tempPath);
+		pageCount = writer.pageCount();
+		pageBytes = writer.bytes();
+	}
+	catch (...) {
+		std::error_code error;
+		std::filesystem::remove_all(directory, error);
+		std::filesystem::remove(tempPath, error);
+		throw;
+	}
+	std::filesystem::remove_all(directory);
+	std::error_code error;
+	std::filesystem::rename(tempPath, output, error);
+	if (error) {
+		std::filesystem::remove(tempPath, error);
+		throw std::runtime_error("Could not write " + pagesPath);
+	}
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	std::cout << "Paged " << scanPath << " (" << scan.vertexCount << " vertices, " << scan.faceCount << " faces) into "
+		<< pageCount << " pages of " << pageBytes / (1024.0 * 1024.0) << " MB in " << elapsed.count()
+		<< " s" << std::endl;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "MappedFile.h"
+#include "Mesh3D.h"
+
+/**
+ * @brief One page of a paged mesh: a spatially coherent piece of the full mesh, small enough to
+ * stream in on its own. Its data, at offset in the page file, is its vertices, then its faces (the
+ * full-detail indices followed by those of its coarser levels), then its levels of detail and its
+ * meshlets, laid out so the arrays can be used in place.
+ */
+struct MeshPage {
+	// A sphere around the page's vertices in object space: the centre, and the radius in w.
+	glm::vec4 bounds;
+	uint64_t offset;
+	uint32_t vertexCount;
+	uint32_t faceCount;
+	uint32_t lodCount;
+	uint32_t meshletCount;
+
+	/**
+	 * @brief The bytes the page takes in the file, and in VRAM once uploaded.
+	 */
+	size_t fileBytes() const;
+	size_t gpuBytes() const;
+};
+
+/**
+ * @brief A page's arrays, pointing into a buffer holding its data.
+ */
+struct MeshPageView {
+	const Vertex3D* vertices;
+	const uint32_t* faces;
+	const MeshLod* lods;
+	const Meshlet* meshlets;
+};
+
+MeshPageView viewPage(const MeshPage& page, const uint8_t* data);
+
+/**
+ * @brief The index of a page file's pages, read from its mapping.
+ */
+struct MeshPageTable {
+	uint64_t triangleCount = 0;
+	// A sphere around the whole mesh in object space.
+	glm::vec4 bounds = glm::vec4(0, 0, 0, -1);
+	std::vector<MeshPage> pages;
+
+	/**
+	 * @brief Reads the table of a mapped page file.
+	 * @throws std::runtime_error if the file is not a page file of the current version, or is truncated.
+	 */
+	static MeshPageTable read(const MappedFile& file);
+};
+
+struct MeshPagerOptions {
+	// Pages hold at most this many full-detail triangles.
+	size_t pageTriangles = 32768;
+	// Buckets of up to this many triangles are split into pages in memory; larger ones are first
+	// split into smaller buckets on disk, so this bounds the memory the builder needs.
+	size_t bucketTriangles = size_t(1) << 22;
+	bool flipTextureCoords = true;
+};
+
+/**
+ * @brief Splits a scan too large to load whole into pages, and writes them to a page file.
+ *
+ * The scan is a binary little-endian PLY file, with float positions, and optional float normals and
+ * texture coordinates; polygons are triangulated as fans. The file is memory-mapped and read in a
+ * few sequential passes. Triangles are bucketed on disk by a 4x4x4 grid over their centroids,
+ * recursively, until each bucket fits in memory; each bucket is then split at the median of its
+ * longest axis down to pages of MeshPagerOptions::pageTriangles. So every page covers one compact
+ * region, and pages near each other in space are near each other in the file.
+ *
+ * Each page is optimized for the vertex cache, split into meshlets, and given a chain of levels of
+ * detail, just as imported meshes are. Page borders are open edges, which simplification never
+ * moves, so neighbouring pages at different levels still meet without cracks. Scans without
+ * normals get them from each page's own triangles, which may shade page borders slightly apart.
+ * @throws std::runtime_error if the scan cannot be read or the page file cannot be written.
+ */
+void buildMeshPages(const std::string& scanPath, const std::string& pagesPath, const MeshPagerOptions& options = {});
@@ -0,0 +1,150 @@
+#include "Mipmaps.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+	const float PI = 3.14159265358979f;
+	const int LANCZOS_LOBES = 3;
+
+	float lanczos(float x) {
+		x = std::abs(x);
+		if (x < 1e-5f) {
+			return 1;
+		}
+		if (x >= LANCZOS_LOBES) {
+			return 0;
+		}
+		float px = PI * x;
+		return LANCZOS_LOBES * std::sin(px) * std::sin(px / LANCZOS_LOBES) / (px * px);
+	}
+
+	/**
+	 * @brief The source texels, and their weights, that one destination texel along an axis
+	 * filters. Taps past either end wrap around.
+	 */
+	struct Taps {
+		std::vector<uint32_t> indices;
+		std::vector<float> weights;
+	};
+
+	std::vector<Taps> axisTaps(uint32_t sourceSize, uint32_t destinationSize) {
+		std::vector<Taps> taps(destinationSize);
+		float scale = float(sourceSize) / destinationSize;
+		float support = LANCZOS_LOBES * scale;
+		for (uint32_t d = 0; d < destinationSize; d++) {
+			float center = (d + 0.5f) * scale;
+			float total = 0;
+			for (int s = int(std::floor(center - support)); s <= int(std::ceil(center + support)); s++) {
+				float weight = lanczos((s + 0.5f - center) / scale);
+				if (weight == 0) {
+					continue;
+				}
+				int wrapped = s % int(sourceSize);
+				taps[d].indices.push_back(static_cast<uint32_t>(wrapped < 0 ? wrapped + int(sourceSize) : wrapped));
+				taps[d].weights.push_back(weight);
+				total += weight;
+			}
+			for (auto& weight : taps[d].weights) {
+				weight /= total;
+			}
+		}
+		return taps;
+	}
+
+	float srgbToLinear(float value) {
+		return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+	}
+
+	float linearToSrgb(float value) {
+		return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1 / 2.4f) - 0.055f;
+	}
+
+	uint8_t quantize(float value) {
+		return static_cast<uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255));
+	}
+
+	/**
+	 * @brief Filters an image down to the given size, a row at a time: each destination row is the
+	 * weighted sum of source rows, which is then filtered along its length.
+	 */
+	void downsample(const uint8_t* source, uint32_t width, uint32_t height, uint8_t* destination,
+		uint32_t newWidth, uint32_t newHeight, TextureUsage usage) {
+		// Channel values in the space they are filtered in.
+		float decode[4][256];
+		for (int c = 0; c < 4; c++) {
+			for (int v = 0; v < 256; v++) {
+				decode[c][v] = usage == TextureUsage::Color && c < 3 ? srgbToLinear(v / 255.0f) : v / 255.0f;
+			}
+		}
+		auto columns = axisTaps(width, newWidth);
+		auto rows = axisTaps(height, newHeight);
+		std::vector<float> row(size_t(width) * 4);
+		for (uint32_t y = 0; y < newHeight; y++) {
+			std::fill(row.begin(), row.end(), 0.0f);
+			for (size_t t = 0; t < rows[y].indices.size(); t++) {
+				const uint8_t* sourceRow = source + size_t(rows[y].indices[t]) * width * 4;
+				float weight = rows[y].weights[t];
+				for (size_t i = 0; i < row.size(); i++) {
+					row[i] += weight * decode[i & 3][sourceRow[i]];
+				}
+			}
+			for (uint32_t x = 0; x < newWidth; x++) {
+				float texel[4] = {};
+				for (size_t t = 0; t < columns[x].indices.size(); t++) {
+					const float* sourceTexel = &row[size_t(columns[x].indices[t]) * 4];
+					for (int c = 0; c < 4; c++) {
+						texel[c] += columns[x].weights[t] * sourceTexel[c];
+					}
+				}
+				if (usage == TextureUsage::Color) {
+					for (int c = 0; c < 3; c++) {
+						texel[c] = linearToSrgb(std::max(texel[c], 0.0f));
+					}
+				}
+				else if (usage == TextureUsage::Normal) {
+					float n[3] = { texel[0] * 2 - 1, texel[1] * 2 - 1, texel[2] * 2 - 1 };
+					float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+					if (length > 1e-5f) {
+						for (int c = 0; c < 3; c++) {
+							texel[c] = n[c] / length * 0.5f + 0.5f;
+						}
+					}
+				}
+				uint8_t* out = destination + (size_t(y) * newWidth + x) * 4;
+				for (int c = 0; c < 4; c++) {
+					out[c] = quantize(texel[c]);
+				}
+			}
+		}
+	}
+}
+
+GpuTexture generateMipmaps(const uint8_t* rgba, uint32_t width, uint32_t height, TextureUsage usage) {
+	// Every level is laid out in one buffer, largest first.
+	std::vector<std::pair<uint32_t, uint32_t>> sizes;
+	size_t total = 0;
+	for (uint32_t w = width, h = height;; w = std::max(1u, w / 2), h = std::max(1u, h / 2)) {
+		sizes.emplace_back(w, h);
+		total += size_t(w) * h * 4;
+		if (w == 1 && h == 1) {
+			break;
+		}
+	}
+	auto storage = std::make_shared<std::vector<uint8_t>>(total);
+	GpuTexture texture;
+	texture.storage = storage;
+
+	uint8_t* level = storage->data();
+	memcpy(level, rgba, size_t(width) * height * 4);
+	for (size_t l = 0; l < sizes.size(); l++) {
+		uint32_t w = sizes[l].first, h = sizes[l].second;
+		texture.levels.push_back({ w, h, level, size_t(w) * h * 4 });
+		if (l + 1 < sizes.size()) {
+			uint8_t* next = level + size_t(w) * h * 4;
+			downsample(level, w, h, next, sizes[l + 1].first, sizes[l + 1].second, usage);
+			level = next;
+		}
+	}
+	return texture;
+}
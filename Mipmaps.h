@@ -0,0 +1,12 @@
+#pragma once
+#include <cstdint>
+#include "BlockCompression.h"
+
+/**
+ * @brief Builds the full mip chain of an RGBA image, down to 1x1, as an RGBA8 GpuTexture whose
+ * first level is a copy of the image. Each level is filtered from the one above with a separable
+ * Lanczos-3 kernel, wrapping around the edges as the renderer's GL_REPEAT sampling does. Colour
+ * textures are filtered in linear light, so they do not darken as they shrink; normal maps are
+ * renormalized; alpha and material maps are filtered as plain data.
+ */
+GpuTexture generateMipmaps(const uint8_t* rgba, uint32_t width, uint32_t height, TextureUsage usage);
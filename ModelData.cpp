@@ -0,0 +1,338 @@
+#include "ModelData.h"
+#include "MeshOptimizer.h"
+#include "TextureCache.h"
+#include "TextureLoader.h"
+#include "ThreadPool.h"
+#include "Hash.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <optional>
+
+std::string embeddedTexturePath(const std::filesystem::path& modelPath, uint32_t index) {
+	return (modelPath / ("*" + std::to_string(index))).string();
+}
+
+ModelView ModelData::view() const {
+	ModelView view;
+	view.nodes = nodes;
+	view.meshes.reserve(meshes.size());
+	for (auto& mesh : meshes) {
+		view.meshes.push_back({ mesh.vertices.data(), mesh.vertices.size(),
+			mesh.faces.data(), mesh.faces.size(), mesh.textures, mesh.lods, mesh.meshlets });
+	}
+	return view;
+}
+
+Object3D buildHierarchy(const ModelView& model, uint32_t nodeIndex, const MeshFactory& makeMesh) {
+	const NodeData& node = model.nodes[nodeIndex];
+	std::vector<Mesh3D> meshes;
+	for (auto meshIndex : node.meshes) {
+		meshes.push_back(makeMesh(meshIndex));
+	}
+
+	auto parent = Object3D(std::move(meshes), node.baseTransform);
+	parent.setName(node.name);
+	for (auto childIndex : node.children) {
+		parent.addChild(buildHierarchy(model, childIndex, makeMesh));
+	}
+	return parent;
+}
+
+namespace {
+	size_t countNodes(const std::vector<NodeData>& nodes, uint32_t nodeIndex) {
+		size_t count = 1;
+		for (auto childIndex : nodes[nodeIndex].children) {
+			count += countNodes(nodes, childIndex);
+		}
+		return count;
+	}
+
+	/**
+	 * @brief Whether the flattening and batching passes must keep a node at the given depth as it is.
+	 */
+	bool isKept(const NodeData& node, uint32_t depth, const HierarchyOptions& options) {
+		return depth <= options.keepDepth || node.animated
+			|| std::find(options.keepNodes.begin(), options.keepNodes.end(), node.name) != options.keepNodes.end();
+	}
+
+	/**
+	 * @brief Flattens the subtree below a node at the given depth. Children are flattened first, so a
+	 * folded child's own children are already final when they are hoisted.
+	 */
+	void flattenChildren(std::vector<NodeData>& nodes, uint32_t nodeIndex, uint32_t depth, const HierarchyOptions& options) {
+		std::vector<uint32_t> children;
+		for (auto childIndex : nodes[nodeIndex].children) {
+			flattenChildren(nodes, childIndex, depth + 1, options);
+			const NodeData& child = nodes[childIndex];
+			if (!child.meshes.empty() || isKept(child, depth + 1, options)) {
+				children.push_back(childIndex);
+				continue;
+			}
+			for (auto grandchildIndex : child.children) {
+				nodes[grandchildIndex].baseTransform = child.baseTransform * nodes[grandchildIndex].baseTransform;
+				children.push_back(grandchildIndex);
+			}
+		}
+		nodes[nodeIndex].children = std::move(children);
+	}
+
+	/**
+	 * @brief Counts the mesh references in the subtree rooted at the given node, and marks which
+	 * meshes are referenced at all.
+	 */
+	size_t countMeshReferences(const ModelView& model, uint32_t nodeIndex, std::vector<bool>& referenced) {
+		const NodeData& node = model.nodes[nodeIndex];
+		size_t count = node.meshes.size();
+		for (auto meshIndex : node.meshes) {
+			referenced[meshIndex] = true;
+		}
+		for (auto childIndex : node.children) {
+			count += countMeshReferences(model, childIndex, referenced);
+		}
+		return count;
+	}
+}
+
+uint32_t HierarchyOptions::registryKey() const {
+	if (!flatten && !batch) {
+		return 0;
+	}
+	uint64_t hash = fnv1a64(&keepDepth, sizeof(keepDepth));
+	for (auto& name : keepNodes) {
+		hash = fnv1a64(name.data(), name.size() + 1, hash);
+	}
+	// The low bits say which passes run, and are never all zero when one does.
+	return static_cast<uint32_t>(hash << 2) | (flatten ? 1 : 0) | (batch ? 2 : 0);
+}
+
+void flattenHierarchy(std::vector<NodeData>& nodes, uint32_t rootIndex, const HierarchyOptions& options) {
+	size_t before = countNodes(nodes, rootIndex);
+	flattenChildren(nodes, rootIndex, 0, options);
+	size_t after = countNodes(nodes, rootIndex);
+	std::cout << "Flattened hierarchy from " << before << " to " << after << " nodes" << std::endl;
+}
+
+namespace {
+	/**
+	 * @brief A mesh to be merged into a batch, and the transform from its node into the batch's node.
+	 */
+	struct BatchSource {
+		uint32_t mesh;
+		glm::mat4 transform;
+	};
+
+	/**
+	 * @brief A kept node below a batch's node, with the transforms of the static nodes folded above it.
+	 */
+	struct KeptNode {
+		uint32_t node;
+		glm::mat4 hoisted;
+		uint32_t depth;
+	};
+
+	/**
+	 * @brief Collects the meshes of a static subtree into a batch, stopping at kept nodes.
+	 */
+	void gatherStatic(const ModelView& model, uint32_t nodeIndex, const glm::mat4& parentTransform, uint32_t depth,
+		const HierarchyOptions& options, std::vector<BatchSource>& sources, std::vector<KeptNode>& kept) {
+		const NodeData& node = model.nodes[nodeIndex];
+		if (isKept(node, depth, options)) {
+			kept.push_back({ nodeIndex, parentTransform, depth });
+			return;
+		}
+		glm::mat4 transform = parentTransform * node.baseTransform;
+		for (auto meshIndex : node.meshes) {
+			sources.push_back({ meshIndex, transform });
+		}
+		for (auto childIndex : node.children) {
+			gatherStatic(model, childIndex, transform, depth + 1, options, sources, kept);
+		}
+	}
+
+	bool sameTextures(const std::vector<TextureRef>& a, const std::vector<TextureRef>& b) {
+		return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const TextureRef& x, const TextureRef& y) {
+			return x.path == y.path && x.samplerName == y.samplerName;
+		});
+	}
+
+	/**
+	 * @brief Concatenates meshes that share a texture set, transforming each into the batch's space.
+	 */
+	MeshData mergeMeshes(const ModelView& model, const std::vector<BatchSource>& sources) {
+		MeshData merged;
+		merged.textures = model.meshes[sources[0].mesh].textures;
+		size_t vertexCount = 0;
+		size_t faceCount = 0;
+		for (auto& source : sources) {
+			vertexCount += model.meshes[source.mesh].vertexCount;
+			faceCount += model.meshes[source.mesh].baseFaceCount();
+		}
+		merged.vertices.reserve(vertexCount);
+		merged.faces.reserve(faceCount);
+
+		for (auto& source : sources) {
+			const MeshView& mesh = model.meshes[source.mesh];
+			auto base = static_cast<uint32_t>(merged.vertices.size());
+			glm::mat3 linear(source.transform);
+			glm::mat3 normalMatrix = glm::transpose(glm::inverse(linear));
+			for (size_t i = 0; i < mesh.vertexCount; i++) {
+				const Vertex3D& v = mesh.vertices[i];
+				glm::vec4 position = source.transform * glm::vec4(v.x, v.y, v.z, 1);
+				glm::vec3 normal = normalMatrix * glm::vec3(v.nx, v.ny, v.nz);
+				float length = glm::length(normal);
+				if (length > 0) {
+					normal /= length;
+				}
+				merged.vertices.emplace_back(position.x, position.y, position.z, normal.x, normal.y, normal.z, v.u, v.v);
+			}
+			// A mirroring transform reverses the winding of every triangle, which is swapped back.
+			bool mirrored = glm::determinant(linear) < 0;
+			for (size_t f = 0; f + 2 < mesh.baseFaceCount(); f += 3) {
+				merged.faces.push_back(base + mesh.faces[f]);
+				merged.faces.push_back(base + mesh.faces[mirrored ? f + 2 : f + 1]);
+				merged.faces.push_back(base + mesh.faces[mirrored ? f + 1 : f + 2]);
+			}
+		}
+		return merged;
+	}
+
+	/**
+	 * @brief Appends a kept node and its batches to the result, then its kept descendants.
+	 * @return the node's index in the result.
+	 */
+	uint32_t batchNode(const ModelView& model, const KeptNode& keptNode, const HierarchyOptions& options, ModelData& result) {
+		const NodeData& node = model.nodes[keptNode.node];
+		auto index = static_cast<uint32_t>(result.nodes.size());
+		result.nodes.emplace_back();
+
+		NodeData batched;
+		batched.name = node.name;
+		batched.baseTransform = keptNode.hoisted * node.baseTransform;
+		batched.animated = node.animated;
+
+		std::vector<BatchSource> sources;
+		for (auto meshIndex : node.meshes) {
+			sources.push_back({ meshIndex, glm::mat4(1) });
+		}
+		std::vector<KeptNode> kept;
+		for (auto childIndex : node.children) {
+			gatherStatic(model, childIndex, glm::mat4(1), keptNode.depth + 1, options, sources, kept);
+		}
+
+		// One batch per distinct texture set, in the order the sets are first used.
+		std::vector<std::vector<BatchSource>> groups;
+		for (auto& source : sources) {
+			auto group = std::find_if(groups.begin(), groups.end(), [&](const std::vector<BatchSource>& g) {
+				return sameTextures(model.meshes[g[0].mesh].textures, model.meshes[source.mesh].textures);
+			});
+			if (group == groups.end()) {
+				groups.push_back({ source });
+			}
+			else {
+				group->push_back(source);
+			}
+		}
+		for (auto& group : groups) {
+			batched.meshes.push_back(static_cast<uint32_t>(result.meshes.size()));
+			result.meshes.push_back(mergeMeshes(model, group));
+		}
+
+		for (auto& child : kept) {
+			batched.children.push_back(batchNode(model, child, options, result));
+		}
+		result.nodes[index] = std::move(batched);
+		return index;
+	}
+}
+
+ImportedModel batchStaticMeshes(const ModelView& model, const HierarchyOptions& options) {
+	auto start = std::chrono::steady_clock::now();
+	auto result = std::make_shared<ModelData>();
+	batchNode(model, KeptNode{ 0, glm::mat4(1), 0 }, options, *result);
+	// Merging keeps only full-detail triangles in their old order, so batches of meshes that had
+	// meshlets or levels of detail are clustered and simplified again.
+	bool optimized = std::any_of(model.meshes.begin(), model.meshes.end(), [](const MeshView& mesh) {
+		return !mesh.lods.empty() || !mesh.meshlets.empty();
+	});
+	if (optimized) {
+		ThreadPool::shared().parallelFor(result->meshes.size(), [&](size_t i) {
+			buildMeshlets(result->meshes[i]);
+			optimizeVertexFetch(result->meshes[i]);
+			generateLods(result->meshes[i]);
+		});
+	}
+
+	std::vector<bool> referenced(model.meshes.size(), false);
+	size_t drawsBefore = countMeshReferences(model, 0, referenced);
+	ModelView batched = result->view();
+	referenced.assign(batched.meshes.size(), false);
+	size_t drawsAfter = countMeshReferences(batched, 0, referenced);
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	std::cout << "Batched " << drawsBefore << " draws into " << drawsAfter << " across "
+		<< batched.nodes.size() << " nodes in " << elapsed.count() << " ms" << std::endl;
+	return ImportedModel{ std::move(batched), result };
+}
+
+void simplifyHierarchy(ImportedModel& imported, const HierarchyOptions& options) {
+	if (options.flatten) {
+		flattenHierarchy(imported.model.nodes, 0, options);
+	}
+	if (options.batch) {
+		// The batched meshes still name the source model's embedded textures, which are served only
+		// while the source is alive.
+		auto source = imported.storage;
+		imported = batchStaticMeshes(imported.model, options);
+		imported.storage = std::make_shared<std::pair<std::shared_ptr<const void>, std::shared_ptr<const void>>>(
+			imported.storage, source);
+	}
+}
+
+Object3D buildObject3D(const ModelView& model, uint32_t nodeIndex,
+	std::unordered_map<std::filesystem::path, Texture, PathHash>& loadedTextures) {
+	// Several nodes may reference the same mesh (repeated wheels or bolts); each mesh is uploaded
+	// once, and every node referencing it shares the result.
+	std::vector<bool> referenced(model.meshes.size(), false);
+	size_t referenceCount = countMeshReferences(model, nodeIndex, referenced);
+	size_t meshCount = std::count(referenced.begin(), referenced.end(), true);
+	if (referenceCount > meshCount) {
+		std::cout << "Collapsed " << referenceCount - meshCount << " duplicate mesh references into "
+			<< meshCount << " meshes" << std::endl;
+	}
+
+	// Generate the names for every vertex array and buffer in the hierarchy with one call each, and
+	// hand them out in the order buildHierarchy first asks for each mesh.
+	std::vector<uint32_t> vaos(meshCount);
+	std::vector<uint32_t> buffers(2 * meshCount);
+	if (meshCount > 0) {
+		glGenVertexArrays(static_cast<GLsizei>(meshCount), vaos.data());
+		glGenBuffers(static_cast<GLsizei>(2 * meshCount), buffers.data());
+	}
+	size_t next = 0;
+	std::vector<std::optional<Mesh3D>> built(model.meshes.size());
+
+	return buildHierarchy(model, nodeIndex, [&](uint32_t meshIndex) {
+		if (built[meshIndex]) {
+			return *built[meshIndex];
+		}
+		// Textures are loaded at most once per path and usage.
+		const MeshView& mesh = model.meshes[meshIndex];
+		std::vector<Texture> textures;
+		for (auto& ref : mesh.textures) {
+			auto key = loadedTextureKey(ref);
+			auto existing = loadedTextures.find(key);
+			if (existing != loadedTextures.end()) {
+				textures.push_back(Texture{ existing->second.handle, ref.samplerName });
+			}
+			else {
+				Texture tex = TextureCache::load(ref.path, ref.samplerName);
+				textures.push_back(tex);
+				loadedTextures.insert(std::make_pair(key, tex));
+			}
+		}
+		size_t slot = next++;
+		built[meshIndex].emplace(vaos[slot], buffers[2 * slot], buffers[2 * slot + 1],
+			mesh.vertices, mesh.vertexCount, mesh.faces, mesh.faceCount, std::move(textures), mesh.lods, mesh.meshlets);
+		return *built[meshIndex];
+	});
+}
@@ -0,0 +1,178 @@
+#pragma once
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+#include "AssetPack.h"
+#include "Mesh3D.h"
+#include "Object3D.h"
+
+struct PathHash {
+	std::size_t operator()(const std::filesystem::path& p) const {
+		return std::hash<std::string>{}(p.string());
+	}
+};
+
+/**
+ * @brief Identifies a texture file used by a mesh, and the sampler it binds to.
+ */
+struct TextureRef {
+	std::string path;
+	std::string samplerName;
+};
+
+/**
+ * @brief An image file embedded in a model file, such as an FBX or GLB, or the recipe of a texture
+ * packed from other textures (see packMaterialMaps), which TextureRefs name by a virtual path (see
+ * embeddedTexturePath) that AssetPack serves from memory for as long as the bytes are held here.
+ */
+struct EmbeddedTexture {
+	std::string path;
+	AssetBytes bytes;
+	// The texture files a recipe names, which the mesh cache records as references of the import.
+	std::vector<std::string> sources;
+};
+
+/**
+ * @brief The virtual path of the model's embedded texture with the given index: the model's path
+ * followed by Assimp's "*index" name, which no file on disk can have.
+ */
+std::string embeddedTexturePath(const std::filesystem::path& modelPath, uint32_t index);
+
+/**
+ * @brief The CPU-side vertices, faces, and texture references of a single imported mesh.
+ */
+struct MeshData {
+	std::vector<Vertex3D> vertices;
+	// The full-detail indices, followed by those of any coarser levels of detail.
+	std::vector<uint32_t> faces;
+	std::vector<TextureRef> textures;
+	// The ranges of faces making up each level of detail, finest first; empty if faces is one level.
+	std::vector<MeshLod> lods;
+	// The full-detail faces in clusters for culling; empty if the mesh is drawn whole.
+	std::vector<Meshlet> meshlets;
+
+	size_t baseFaceCount() const { return lods.empty() ? faces.size() : lods[0].indexCount; }
+};
+
+/**
+ * @brief One node of an imported model's hierarchy. Meshes and children are indices into the
+ * owning model's mesh and node lists.
+ */
+struct NodeData {
+	std::string name;
+	glm::mat4 baseTransform;
+	std::vector<uint32_t> meshes;
+	std::vector<uint32_t> children;
+	// True for nodes that something moves at runtime, such as animation channels, bones, cameras,
+	// and lights; flattenHierarchy never folds these away.
+	bool animated = false;
+};
+
+/**
+ * @brief A non-owning view of a mesh's vertices and faces, which may live in a MeshData or in a
+ * memory-mapped cache file.
+ */
+struct MeshView {
+	const Vertex3D* vertices;
+	size_t vertexCount;
+	const uint32_t* faces;
+	size_t faceCount;
+	std::vector<TextureRef> textures;
+	std::vector<MeshLod> lods;
+	std::vector<Meshlet> meshlets;
+
+	size_t baseFaceCount() const { return lods.empty() ? faceCount : lods[0].indexCount; }
+};
+
+/**
+ * @brief A model's node hierarchy, with views of the meshes it references. Node 0 is the root.
+ */
+struct ModelView {
+	std::vector<NodeData> nodes;
+	std::vector<MeshView> meshes;
+};
+
+/**
+ * @brief A fully-converted model that lives in CPU memory, ready to be cached or sent to the GPU.
+ * Node 0 is the root.
+ */
+struct ModelData {
+	std::vector<NodeData> nodes;
+	std::vector<MeshData> meshes;
+	// Textures stored inside the model file, which its meshes' TextureRefs may name.
+	std::vector<EmbeddedTexture> embeddedTextures;
+
+	ModelView view() const;
+};
+
+/**
+ * @brief How a model's hierarchy is simplified when it is loaded: flattened (see flattenHierarchy),
+ * batched (see batchStaticMeshes), or left as imported.
+ */
+struct HierarchyOptions {
+	bool flatten = false;
+	bool batch = false;
+	// Nodes at this depth or shallower (the root's children are at depth 1) are kept, and keep
+	// their children in order, so getChild() paths up to this length find the same nodes.
+	uint32_t keepDepth = 1;
+	// Names of further nodes to keep, such as nodes the scene animates.
+	std::vector<std::string> keepNodes;
+
+	/**
+	 * @brief Distinguishes the registered instances of a model that were loaded with different options.
+	 */
+	uint32_t registryKey() const;
+};
+
+/**
+ * @brief Folds the mesh-less nodes that the options do not keep, those below keepDepth that are
+ * neither animated nor named in keepNodes, into their parents: each such node's transform is
+ * premultiplied into its children, which take its place in its parent's child list. Every folded
+ * node saves a matrix multiply and a uniform upload per frame. Folded nodes stay in the list,
+ * unreachable, so mesh and node indices are unchanged.
+ */
+void flattenHierarchy(std::vector<NodeData>& nodes, uint32_t rootIndex, const HierarchyOptions& options);
+
+/**
+ * @brief A model's views, together with the storage they point into (a mapped cache entry, or
+ * converted ModelData), which stays alive as long as any copy of this object does.
+ */
+struct ImportedModel {
+	ModelView model;
+	std::shared_ptr<const void> storage;
+};
+
+/**
+ * @brief Static batching: merges each kept node's meshes with the meshes of its static descendants,
+ * pre-transformed into the kept node's space, into one mesh per distinct texture set. Nodes are
+ * kept if they are animated, at or above the options' keepDepth, or named in its keepNodes; each
+ * keeps its kept descendants as children. Returns the batched model, which owns its meshes.
+ */
+ImportedModel batchStaticMeshes(const ModelView& model, const HierarchyOptions& options);
+
+/**
+ * @brief Runs the flattening and batching passes that the options ask for on an imported model.
+ */
+void simplifyHierarchy(ImportedModel& imported, const HierarchyOptions& options);
+
+/**
+ * @brief Creates the Mesh3D for one mesh reference of a model, given the mesh's index.
+ */
+using MeshFactory = std::function<Mesh3D(uint32_t meshIndex)>;
+
+/**
+ * @brief Builds the Object3D hierarchy of a model starting from the given node, calling makeMesh for
+ * each mesh reference in depth-first order.
+ */
+Object3D buildHierarchy(const ModelView& model, uint32_t nodeIndex, const MeshFactory& makeMesh);
+
+/**
+ * @brief Uploads the meshes of a model to the GPU and builds its Object3D hierarchy, starting
+ * from the given node. Textures are loaded once per path, using the given map.
+ */
+Object3D buildObject3D(const ModelView& model, uint32_t nodeIndex,
+	std::unordered_map<std::filesystem::path, Texture, PathHash>& loadedTextures);
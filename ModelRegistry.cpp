@@ -0,0 +1,48 @@
+#include "ModelRegistry.h"
+#include "TextureCache.h"
+#include <cstring>
+
+std::unordered_map<std::string, Object3D>& ModelRegistry::entries() {
+	static std::unordered_map<std::string, Object3D> registry;
+	return registry;
+}
+
+std::string ModelRegistry::key(const std::string& path, uint64_t importFlags, float weldEpsilon) {
+	std::string result = TextureCache::canonicalPath(path) + "|" + std::to_string(importFlags);
+	if (weldEpsilon != 0) {
+		// The epsilon's bits, since its decimal form would round small epsilons together.
+		uint32_t epsilonBits;
+		std::memcpy(&epsilonBits, &weldEpsilon, sizeof(epsilonBits));
+		result += "|w" + std::to_string(epsilonBits);
+	}
+	return result;
+}
+
+std::optional<Object3D> ModelRegistry::find(const std::string& path, uint64_t importFlags, float weldEpsilon) {
+	auto existing = entries().find(key(path, importFlags, weldEpsilon));
+	if (existing == entries().end()) {
+		return std::nullopt;
+	}
+	// Copying the hierarchy copies transformations, but Mesh3D copies share geometry and textures.
+	return existing->second;
+}
+
+void ModelRegistry::insert(const std::string& path, uint64_t importFlags, const Object3D& prototype, float weldEpsilon) {
+	entries().insert_or_assign(key(path, importFlags, weldEpsilon), prototype);
+}
+
+void ModelRegistry::release(const std::string& path) {
+	std::string prefix = TextureCache::canonicalPath(path) + "|";
+	for (auto it = entries().begin(); it != entries().end();) {
+		if (it->first.compare(0, prefix.size(), prefix) == 0) {
+			it = entries().erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+}
+
+void ModelRegistry::clear() {
+	entries().clear();
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include "Object3D.h"
+
+/**
+ * @brief A process-wide registry of loaded models, so that placing the same model in a scene several
+ * times imports it once. Each lookup returns a new copy of the model's hierarchy: the copy has its own
+ * transformations, but shares the first load's immutable meshes and textures on the GPU.
+ * The registry keeps every model it holds on the GPU until the model is released.
+ */
+class ModelRegistry {
+private:
+	static std::unordered_map<std::string, Object3D>& entries();
+	static std::string key(const std::string& path, uint64_t importFlags, float weldEpsilon);
+
+public:
+	/**
+	 * @brief Returns a new instance of a model that was loaded with the same path, import flags, and
+	 * weld epsilon. Loaders put the options that change a model's hierarchy, if any, in the upper 32
+	 * bits of the flags.
+	 * @return an empty optional if the model has not been registered.
+	 */
+	static std::optional<Object3D> find(const std::string& path, uint64_t importFlags, float weldEpsilon = 0);
+
+	/**
+	 * @brief Registers a freshly-loaded model, which future finds will copy. The model must not have
+	 * been moved, rotated, or scaled yet.
+	 */
+	static void insert(const std::string& path, uint64_t importFlags, const Object3D& prototype, float weldEpsilon = 0);
+
+	/**
+	 * @brief Forgets every registered import of the given path. GPU resources are freed once the
+	 * instances already handed out are destroyed too.
+	 */
+	static void release(const std::string& path);
+
+	/**
+	 * @brief Forgets every registered model.
+	 */
+	static void clear();
+};
@@ -0,0 +1,578 @@
+#include "ObjImport.h"
+#include "AssetPack.h"
+#include "MaterialPacker.h"
+#include "MeshOptimizer.h"
+#include "ModelRegistry.h"
+#include "TextureLoader.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <unordered_map>
+
+namespace {
+	// Chunks smaller than this are not worth handing to another thread.
+	const size_t MIN_CHUNK_BYTES = 1 << 20;
+	// Face corners with a relative index hold it as a signed offset from the start of their chunk's
+	// vertex list, added to this base, until the chunks are merged and the number of vertices before
+	// each chunk is known. The offset is negative for corners that refer back into earlier chunks.
+	// Global indices are never negative, and offsets are bounded by the file's size, so the two
+	// ranges cannot meet.
+	const int64_t LOCAL_INDEX_BASE = std::numeric_limits<int64_t>::min() / 2;
+	const int64_t NO_INDEX = -1;
+
+	/**
+	 * @brief A triangle corner's position, texture coordinate, and normal indices.
+	 */
+	struct FaceCorner {
+		int64_t v;
+		int64_t vt;
+		int64_t vn;
+	};
+
+	/**
+	 * @brief An "o"/"g" or "usemtl" statement, which takes effect from the given triangle on.
+	 */
+	struct GroupMarker {
+		size_t triangle;
+		bool isMaterial;
+		std::string name;
+	};
+
+	/**
+	 * @brief Everything parsed from one line-aligned chunk of the file.
+	 */
+	struct ObjChunk {
+		std::vector<float> positions;
+		std::vector<float> texCoords;
+		std::vector<float> normals;
+		std::vector<FaceCorner> corners;
+		std::vector<GroupMarker> markers;
+		std::vector<std::string> materialLibraries;
+	};
+
+	const double POWERS_OF_TEN[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	bool isSpace(char c) {
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	const char* skipSpaces(const char* p, const char* end) {
+		while (p < end && isSpace(*p)) {
+			p++;
+		}
+		return p;
+	}
+
+	/**
+	 * @brief Parses a decimal float without locale lookups or allocation. Mantissas of up to 19
+	 * digits with small exponents are converted exactly (Clinger's fast path); others fall back on pow.
+	 */
+	const char* parseFloat(const char* p, const char* end, float& out) {
+		p = skipSpaces(p, end);
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negative = *p == '-';
+			p++;
+		}
+		uint64_t mantissa = 0;
+		int digits = 0;
+		int exponent = 0;
+		while (p < end && *p >= '0' && *p <= '9') {
+			if (digits < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa != 0) { digits++; }
+			}
+			else {
+				exponent++;
+			}
+			p++;
+		}
+		if (p < end && *p == '.') {
+			p++;
+			while (p < end && *p >= '0' && *p <= '9') {
+				if (digits < 19) {
+					mantissa = mantissa * 10 + (*p - '0');
+					if (mantissa != 0) { digits++; }
+					exponent--;
+				}
+				p++;
+			}
+		}
+		if (p < end && (*p == 'e' || *p == 'E')) {
+			p++;
+			bool negativeExponent = false;
+			if (p < end && (*p == '-' || *p == '+')) {
+				negativeExponent = *p == '-';
+				p++;
+			}
+			int value = 0;
+			while (p < end && *p >= '0' && *p <= '9') {
+				if (value < 10000) { value = value * 10 + (*p - '0'); }
+				p++;
+			}
+			exponent += negativeExponent ? -value : value;
+		}
+
+		double result = static_cast<double>(mantissa);
+		if (mantissa < (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+			result = exponent < 0 ? result / POWERS_OF_TEN[-exponent] : result * POWERS_OF_TEN[exponent];
+		}
+		else {
+			result *= std::pow(10.0, exponent);
+		}
+		out = static_cast<float>(negative ? -result : result);
+		return p;
+	}
+
+	const char* parseInt(const char* p, const char* end, int64_t& out) {
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negative = *p == '-';
+			p++;
+		}
+		int64_t value = 0;
+		while (p < end && *p >= '0' && *p <= '9') {
+			value = value * 10 + (*p - '0');
+			p++;
+		}
+		out = negative ? -value : value;
+		return p;
+	}
+
+	/**
+	 * @brief Converts a 1-based (or negative, relative) OBJ index to a 0-based global index, or to a
+	 * chunk-local offset from LOCAL_INDEX_BASE.
+	 */
+	int64_t encodeIndex(int64_t index, size_t countSoFar) {
+		if (index > 0) {
+			return index - 1;
+		}
+		if (index < 0) {
+			return LOCAL_INDEX_BASE + static_cast<int64_t>(countSoFar) + index;
+		}
+		return NO_INDEX;
+	}
+
+	/**
+	 * @brief Converts an index from encodeIndex to a global one, given the number of vertices before
+	 * its chunk. Relative indices that reach back past the first vertex come out negative.
+	 */
+	int64_t resolveIndex(int64_t index, size_t base) {
+		if (index >= NO_INDEX) {
+			return index;
+		}
+		int64_t resolved = (index - LOCAL_INDEX_BASE) + static_cast<int64_t>(base);
+		// Negative results must not be mistaken for NO_INDEX when they are checked.
+		return resolved < 0 ? std::numeric_limits<int64_t>::min() : resolved;
+	}
+
+	std::string restOfLine(const char* p, const char* lineEnd) {
+		p = skipSpaces(p, lineEnd);
+		const char* last = lineEnd;
+		while (last > p && isSpace(last[-1])) {
+			last--;
+		}
+		return std::string(p, last);
+	}
+
+	bool startsWith(const char* p, const char* lineEnd, const char* keyword) {
+		size_t length = std::strlen(keyword);
+		return static_cast<size_t>(lineEnd - p) > length && std::memcmp(p, keyword, length) == 0 && isSpace(p[length]);
+	}
+
+	void parseChunk(const char* p, const char* end, ObjChunk& chunk) {
+		std::vector<FaceCorner> polygon;
+		while (p < end) {
+			const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', end - p));
+			if (lineEnd == nullptr) {
+				lineEnd = end;
+			}
+			p = skipSpaces(p, lineEnd);
+			if (p < lineEnd) {
+				if (p[0] == 'v' && p + 1 < lineEnd && isSpace(p[1])) {
+					float x, y, z;
+					const char* q = parseFloat(p + 1, lineEnd, x);
+					q = parseFloat(q, lineEnd, y);
+					parseFloat(q, lineEnd, z);
+					chunk.positions.insert(chunk.positions.end(), { x, y, z });
+				}
+				else if (startsWith(p, lineEnd, "vt")) {
+					float u, v = 0;
+					const char* q = parseFloat(p + 2, lineEnd, u);
+					if (skipSpaces(q, lineEnd) < lineEnd) {
+						parseFloat(q, lineEnd, v);
+					}
+					chunk.texCoords.insert(chunk.texCoords.end(), { u, v });
+				}
+				else if (startsWith(p, lineEnd, "vn")) {
+					float x, y, z;
+					const char* q = parseFloat(p + 2, lineEnd, x);
+					q = parseFloat(q, lineEnd, y);
+					parseFloat(q, lineEnd, z);
+					chunk.normals.insert(chunk.normals.end(), { x, y, z });
+				}
+				else if (p[0] == 'f' && p + 1 < lineEnd && isSpace(p[1])) {
+					polygon.clear();
+					const char* q = skipSpaces(p + 1, lineEnd);
+					while (q < lineEnd) {
+						int64_t v = 0, vt = 0, vn = 0;
+						q = parseInt(q, lineEnd, v);
+						if (q < lineEnd && *q == '/') {
+							q++;
+							if (q < lineEnd && *q != '/') {
+								q = parseInt(q, lineEnd, vt);
+							}
+							if (q < lineEnd && *q == '/') {
+								q = parseInt(q + 1, lineEnd, vn);
+							}
+						}
+						polygon.push_back({ encodeIndex(v, chunk.positions.size() / 3),
+							encodeIndex(vt, chunk.texCoords.size() / 2), encodeIndex(vn, chunk.normals.size() / 3) });
+						q = skipSpaces(q, lineEnd);
+					}
+					// Polygons are triangulated as fans, as Assimp's Triangulate step does for convex faces.
+					for (size_t i = 2; i < polygon.size(); i++) {
+						chunk.corners.push_back(polygon[0]);
+						chunk.corners.push_back(polygon[i - 1]);
+						chunk.corners.push_back(polygon[i]);
+					}
+				}
+				else if ((p[0] == 'o' || p[0] == 'g') && (p + 1 == lineEnd || isSpace(p[1]))) {
+					chunk.markers.push_back({ chunk.corners.size() / 3, false, restOfLine(p + 1, lineEnd) });
+				}
+				else if (startsWith(p, lineEnd, "usemtl")) {
+					chunk.markers.push_back({ chunk.corners.size() / 3, true, restOfLine(p + 6, lineEnd) });
+				}
+				else if (startsWith(p, lineEnd, "mtllib")) {
+					chunk.materialLibraries.push_back(restOfLine(p + 6, lineEnd));
+				}
+			}
+			p = lineEnd + 1;
+		}
+	}
+
+	/**
+	 * @brief The texture references of each material in an MTL file, with the same sampler names
+	 * that fromAssimpMesh gives Assimp's OBJ materials. The library is read like the OBJ file, from
+	 * the mounted AssetPack or else from disk.
+	 */
+	void parseMaterialLibrary(const std::filesystem::path& path,
+		std::unordered_map<std::string, std::vector<TextureRef>>& materials) {
+		auto bytes = AssetPack::open(path.string());
+		if (!bytes) {
+			std::cerr << "Could not open material library " << path << std::endl;
+			return;
+		}
+		std::istringstream file(std::string(reinterpret_cast<const char*>(bytes->data), bytes->size));
+		// Diffuse, specular, bump (height), and normal maps, then the PBR extension's roughness and
+		// metallic maps, in fromAssimpMesh's order.
+		const std::pair<const char*, const char*> SLOTS[] = {
+			{ "map_Kd", "baseTexture" }, { "map_Ks", "specMap" },
+			{ "map_Bump", "normalMap" }, { "map_bump", "normalMap" }, { "bump", "normalMap" }, { "norm", "normalMap" },
+			{ "map_Pr", "roughnessMap" }, { "map_Pm", "metallicMap" },
+		};
+		std::string line;
+		std::vector<TextureRef>* current = nullptr;
+		std::unordered_map<std::string, std::string> slots;
+		auto finish = [&]() {
+			if (current == nullptr) {
+				return;
+			}
+			for (auto sampler : { "baseTexture", "specMap", "normalMap", "roughnessMap", "metallicMap" }) {
+				auto slot = slots.find(sampler);
+				if (slot != slots.end()) {
+					current->push_back({ (path.parent_path() / slot->second).string(), sampler });
+				}
+			}
+			slots.clear();
+		};
+		while (std::getline(file, line)) {
+			std::istringstream tokens(line);
+			std::string keyword;
+			tokens >> keyword;
+			if (keyword == "newmtl") {
+				finish();
+				std::string name;
+				std::getline(tokens >> std::ws, name);
+				while (!name.empty() && isSpace(name.back())) { name.pop_back(); }
+				current = &materials[name];
+				continue;
+			}
+			for (auto& slot : SLOTS) {
+				if (keyword == slot.first && slots.find(slot.second) == slots.end()) {
+					// Texture options such as "-bm 1" come first; the file name is the last token.
+					std::string token, file;
+					while (tokens >> token) { file = token; }
+					if (!file.empty()) {
+						std::replace(file.begin(), file.end(), '\\', '/');
+						slots[slot.second] = file;
+					}
+				}
+			}
+		}
+		finish();
+	}
+
+	/**
+	 * @brief A run of triangles that belong to one mesh: an object's triangles with one material.
+	 */
+	struct MeshBuild {
+		std::string material;
+		std::vector<std::pair<size_t, size_t>> ranges;
+	};
+}
+
+ModelData objImport(const std::string& path, bool flipTextureCoords) {
+	auto start = std::chrono::steady_clock::now();
+	auto file = AssetPack::open(path);
+	if (!file) {
+		throw std::runtime_error("Could not open OBJ file " + path);
+	}
+	auto* text = reinterpret_cast<const char*>(file->data);
+	size_t size = file->size;
+
+	// Split the file into chunks that each end at a line break, and parse them in parallel.
+	ThreadPool& pool = ThreadPool::shared();
+	size_t chunkCount = std::max<size_t>(1, std::min(pool.size() * 4, size / MIN_CHUNK_BYTES));
+	std::vector<std::pair<size_t, size_t>> bounds;
+	size_t chunkStart = 0;
+	for (size_t i = 1; i <= chunkCount && chunkStart < size; i++) {
+		size_t chunkEnd = i == chunkCount ? size : std::max(chunkStart, size * i / chunkCount);
+		while (chunkEnd < size && text[chunkEnd - 1] != '\n') {
+			chunkEnd++;
+		}
+		bounds.push_back({ chunkStart, chunkEnd });
+		chunkStart = chunkEnd;
+	}
+	std::vector<ObjChunk> chunks(bounds.size());
+	pool.parallelFor(bounds.size(), [&](size_t i) {
+		parseChunk(text + bounds[i].first, text + bounds[i].second, chunks[i]);
+	});
+
+	// Concatenate the chunks' attributes, and resolve each chunk's local indices now that the number
+	// of attributes before it is known.
+	std::vector<size_t> positionBase(chunks.size()), texCoordBase(chunks.size()), normalBase(chunks.size()), cornerBase(chunks.size());
+	size_t positionCount = 0, texCoordCount = 0, normalCount = 0, cornerCount = 0;
+	for (size_t i = 0; i < chunks.size(); i++) {
+		positionBase[i] = positionCount;
+		texCoordBase[i] = texCoordCount;
+		normalBase[i] = normalCount;
+		cornerBase[i] = cornerCount;
+		positionCount += chunks[i].positions.size() / 3;
+		texCoordCount += chunks[i].texCoords.size() / 2;
+		normalCount += chunks[i].normals.size() / 3;
+		cornerCount += chunks[i].corners.size();
+	}
+	std::vector<float> positions(positionCount * 3), texCoords(texCoordCount * 2), normals(normalCount * 3);
+	std::vector<FaceCorner> corners(cornerCount);
+	pool.parallelFor(chunks.size(), [&](size_t i) {
+		ObjChunk& chunk = chunks[i];
+		std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + positionBase[i] * 3);
+		std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), texCoords.begin() + texCoordBase[i] * 2);
+		std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + normalBase[i] * 3);
+		for (size_t c = 0; c < chunk.corners.size(); c++) {
+			const FaceCorner& corner = chunk.corners[c];
+			corners[cornerBase[i] + c] = { resolveIndex(corner.v, positionBase[i]),
+				resolveIndex(corner.vt, texCoordBase[i]), resolveIndex(corner.vn, normalBase[i]) };
+		}
+	});
+	for (auto& corner : corners) {
+		if (corner.v < 0 || corner.v >= static_cast<int64_t>(positionCount) || corner.vt >= static_cast<int64_t>(texCoordCount)
+			|| corner.vn >= static_cast<int64_t>(normalCount) || (corner.vt < 0 && corner.vt != NO_INDEX)
+			|| (corner.vn < 0 && corner.vn != NO_INDEX)) {
+			throw std::runtime_error("OBJ face refers to a missing vertex in " + path);
+		}
+	}
+
+	// Walk the group markers in file order, splitting triangles into objects and, within each object,
+	// into one mesh per material, as Assimp does.
+	std::vector<std::pair<std::string, std::vector<MeshBuild>>> objects;
+	std::string material = "DefaultMaterial";
+	size_t triangleCount = cornerCount / 3;
+	size_t runStart = 0;
+	auto closeRun = [&](size_t runEnd) {
+		if (runEnd <= runStart) {
+			return;
+		}
+		if (objects.empty()) {
+			objects.push_back({ "defaultobject", {} });
+		}
+		auto& meshes = objects.back().second;
+		auto existing = std::find_if(meshes.begin(), meshes.end(), [&](const MeshBuild& m) { return m.material == material; });
+		if (existing == meshes.end()) {
+			meshes.push_back({ material, {} });
+			existing = meshes.end() - 1;
+		}
+		existing->ranges.push_back({ runStart, runEnd });
+		runStart = runEnd;
+	};
+	std::vector<std::string> materialLibraries;
+	for (size_t i = 0; i < chunks.size(); i++) {
+		size_t triangleBase = cornerBase[i] / 3;
+		for (auto& marker : chunks[i].markers) {
+			closeRun(triangleBase + marker.triangle);
+			if (marker.isMaterial) {
+				material = marker.name;
+			}
+			else {
+				objects.push_back({ marker.name, {} });
+			}
+		}
+		materialLibraries.insert(materialLibraries.end(), chunks[i].materialLibraries.begin(), chunks[i].materialLibraries.end());
+	}
+	closeRun(triangleCount);
+
+	std::filesystem::path modelPath(path);
+	std::unordered_map<std::string, std::vector<TextureRef>> materials;
+	for (auto& library : materialLibraries) {
+		parseMaterialLibrary(modelPath.parent_path() / library, materials);
+	}
+
+	// The root node is named for the file, with a child node per object holding its meshes.
+	ModelData model;
+	NodeData root;
+	root.name = modelPath.filename().string();
+	root.baseTransform = glm::mat4(1);
+	model.nodes.push_back(root);
+	std::vector<const MeshBuild*> builds;
+	for (auto& object : objects) {
+		if (object.second.empty()) {
+			continue;
+		}
+		NodeData node;
+		node.name = object.first;
+		node.baseTransform = glm::mat4(1);
+		for (auto& build : object.second) {
+			node.meshes.push_back(static_cast<uint32_t>(builds.size()));
+			builds.push_back(&build);
+		}
+		model.nodes[0].children.push_back(static_cast<uint32_t>(model.nodes.size()));
+		model.nodes.push_back(std::move(node));
+	}
+
+	// Build each mesh's vertices in parallel. Corners with the same position, texture, and normal
+	// indices become one vertex, in first-use order, like Assimp's JoinIdenticalVertices. Each mesh
+	// is then optimized for the vertex cache like an Assimp import.
+	model.meshes.resize(builds.size());
+	std::vector<std::pair<CacheStats, CacheStats>> caches(builds.size());
+	pool.parallelFor(builds.size(), [&](size_t m) {
+		const MeshBuild& build = *builds[m];
+		MeshData& mesh = model.meshes[m];
+		auto found = materials.find(build.material);
+		if (found != materials.end()) {
+			mesh.textures = found->second;
+		}
+
+		bool hasTexCoords = false;
+		bool hasNormals = true;
+		for (auto& range : build.ranges) {
+			for (size_t c = range.first * 3; c < range.second * 3; c++) {
+				hasTexCoords |= corners[c].vt != NO_INDEX;
+				hasNormals &= corners[c].vn != NO_INDEX;
+			}
+		}
+
+		// Like Assimp's GenSmoothNormals, meshes without normals average the normals of the faces
+		// around each position.
+		std::unordered_map<int64_t, glm::vec3> smoothNormals;
+		if (hasTexCoords && !hasNormals) {
+			for (auto& range : build.ranges) {
+				for (size_t t = range.first; t < range.second; t++) {
+					const float* a = &positions[corners[3 * t].v * 3];
+					const float* b = &positions[corners[3 * t + 1].v * 3];
+					const float* c = &positions[corners[3 * t + 2].v * 3];
+					glm::vec3 faceNormal = glm::cross(glm::vec3(b[0] - a[0], b[1] - a[1], b[2] - a[2]),
+						glm::vec3(c[0] - a[0], c[1] - a[1], c[2] - a[2]));
+					float length = glm::length(faceNormal);
+					if (length > 0) {
+						faceNormal = faceNormal / length;
+					}
+					for (auto k = 0; k < 3; k++) {
+						smoothNormals[corners[3 * t + k].v] += faceNormal;
+					}
+				}
+			}
+		}
+
+		struct CornerHash {
+			size_t operator()(const FaceCorner& c) const {
+				return std::hash<int64_t>{}(c.v) ^ (std::hash<int64_t>{}(c.vt) * 31) ^ (std::hash<int64_t>{}(c.vn) * 1031);
+			}
+		};
+		struct CornerEqual {
+			bool operator()(const FaceCorner& a, const FaceCorner& b) const {
+				return a.v == b.v && a.vt == b.vt && a.vn == b.vn;
+			}
+		};
+		std::unordered_map<FaceCorner, uint32_t, CornerHash, CornerEqual> welded;
+		for (auto& range : build.ranges) {
+			for (size_t c = range.first * 3; c < range.second * 3; c++) {
+				FaceCorner corner = corners[c];
+				if (!hasTexCoords) {
+					// fromAssimpMesh ignores the normals of meshes without texture coordinates.
+					corner.vt = NO_INDEX;
+					corner.vn = NO_INDEX;
+				}
+				auto inserted = welded.insert({ corner, static_cast<uint32_t>(mesh.vertices.size()) });
+				if (inserted.second) {
+					const float* p = &positions[corner.v * 3];
+					if (!hasTexCoords) {
+						mesh.vertices.emplace_back(p[0], p[1], p[2], 0, 0, 1, 0, 0);
+					}
+					else {
+						glm::vec3 n(0, 0, 1);
+						if (corner.vn != NO_INDEX) {
+							n = glm::vec3(normals[corner.vn * 3], normals[corner.vn * 3 + 1], normals[corner.vn * 3 + 2]);
+						}
+						else if (!hasNormals) {
+							n = glm::normalize(smoothNormals[corner.v]);
+						}
+						float u = 0, v = 0;
+						if (corner.vt != NO_INDEX) {
+							u = texCoords[corner.vt * 2];
+							v = texCoords[corner.vt * 2 + 1];
+						}
+						mesh.vertices.emplace_back(p[0], p[1], p[2], n.x, n.y, n.z, u, flipTextureCoords ? 1 - v : v);
+					}
+				}
+				mesh.faces.push_back(inserted.first->second);
+			}
+		}
+		caches[m] = optimizeMesh(mesh);
+	});
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	std::cout << "Parsed " << path << " (" << positionCount << " positions, " << triangleCount << " triangles) in "
+		<< elapsed.count() << " ms using " << chunks.size() << " chunks" << std::endl;
+	for (size_t m = 0; m < caches.size(); m++) {
+		std::cout << "Mesh " << m << " (" << builds[m]->material << "): ACMR " << caches[m].first.acmr << " -> "
+			<< caches[m].second.acmr << ", ATVR " << caches[m].first.atvr << " -> " << caches[m].second.atvr << std::endl;
+	}
+	packMaterialMaps(model, modelPath);
+	return model;
+}
+
+Object3D objLoad(const std::string& path, bool flipTextureCoords) {
+	// Natively-loaded OBJ models are registered apart from Assimp imports, whose flags are never 0 or 1.
+	uint32_t flags = flipTextureCoords ? 1 : 0;
+	auto instance = ModelRegistry::find(path, flags);
+	if (instance) {
+		return std::move(*instance);
+	}
+
+	ModelData data = objImport(path, flipTextureCoords);
+	ModelView view = data.view();
+	std::unordered_map<std::filesystem::path, Texture, PathHash> loadedTextures;
+	loadModelTextures(view, loadedTextures);
+	Object3D model = buildObject3D(view, 0, loadedTextures);
+	ModelRegistry::insert(path, flags, model);
+	return model;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <string>
+#include "ModelData.h"
+#include "Object3D.h"
+
+/**
+ * @brief Loads a Wavefront OBJ model (and its MTL materials) without going through Assimp, for
+ * scans too large for Assimp's single-threaded parser. The file is memory-mapped and parsed in
+ * line-aligned chunks on the shared ThreadPool. The result matches Assimp's import: one child
+ * node per object or group, one mesh per material in each object, and corners that share
+ * position, texture, and normal indices welded into one vertex. Each mesh is then reordered for
+ * the vertex cache, overdraw, and vertex fetch with optimizeMesh, as Assimp imports are.
+ */
+Object3D objLoad(const std::string& path, bool flipTextureCoords);
+
+/**
+ * @brief Parses an OBJ model into CPU-side ModelData, without touching the GPU.
+ * @throws std::runtime_error if the file cannot be read or refers to missing vertices.
+ */
+ModelData objImport(const std::string& path, bool flipTextureCoords);
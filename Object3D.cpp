@@ -113,20 +113,34 @@ void Object3D::render(sf::Window& window, ShaderProgram& shaderProgram) const {
 	renderRecursive(window, shaderProgram, glm::mat4(1));
 }
 
+/**
+ * @brief Renders the object and its children, each mesh culled and at the level of detail the view selects.
+ */
+void Object3D::render(sf::Window& window, ShaderProgram& shaderProgram, const ViewContext& view) const {
+	renderRecursive(window, shaderProgram, glm::mat4(1), &view);
+}
+
 /**
  * @brief Renders the object and its children, recursively.
  * @param parentMatrix the model matrix of this object's parent in the model hierarchy.
+ * @param view if given, culls meshes and chooses their levels of detail; otherwise meshes render whole.
  */
-void Object3D::renderRecursive(sf::Window& window, ShaderProgram& shaderProgram, const glm::mat4& parentMatrix) const {
+void Object3D::renderRecursive(sf::Window& window, ShaderProgram& shaderProgram, const glm::mat4& parentMatrix,
+	const ViewContext* view) const {
 	// This object's true model matrix is the combination of its parent's matrix and the object's matrix.
 	glm::mat4 trueModel = parentMatrix * m_modelMatrix;
 	shaderProgram.setUniform("model", trueModel);
 	// Render each mesh in the object.
 	for (auto& mesh : m_meshes) {
-		mesh.render(window, shaderProgram);
+		if (view) {
+			mesh.render(window, shaderProgram, trueModel, *view);
+		}
+		else {
+			mesh.render(window, shaderProgram);
+		}
 	}
 	// Render the children of the object.
 	for (auto& child : m_children) {
-		child.renderRecursive(window, shaderProgram, trueModel);
+		child.renderRecursive(window, shaderProgram, trueModel, view);
 	}
 }
@@ -64,6 +64,8 @@ public:
 
 	// Rendering.
 	void render(sf::Window& window, ShaderProgram& shaderProgram) const;
-	void renderRecursive(sf::Window& window, ShaderProgram& shaderProgram, const glm::mat4& parentMatrix) const;
+	void render(sf::Window& window, ShaderProgram& shaderProgram, const ViewContext& view) const;
+	void renderRecursive(sf::Window& window, ShaderProgram& shaderProgram, const glm::mat4& parentMatrix,
+		const ViewContext* view = nullptr) const;
 
 };
\ No newline at end of file
@@ -0,0 +1,173 @@
+#include "PagedMesh.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+	/**
+	 * @brief Tests a sphere against the view's frustum planes, which are in world space.
+	 */
+	bool outsideFrustum(const ViewContext& view, const glm::vec3& centre, float radius) {
+		for (auto& plane : view.frustum) {
+			if (glm::dot(glm::vec3(plane), centre) + plane.w < -radius) {
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+PagedMesh::PagedMesh(const std::string& path, std::vector<Texture>&& textures, const PageStreamingOptions& options)
+	: m_file(std::make_shared<MappedFile>()), m_textures(std::move(textures)), m_options(options), m_transform(1),
+	m_residentBytes(0), m_pendingBytes(0), m_frame(0), m_uploadedPages(0), m_reportedIdle(true) {
+	if (!m_file->open(path)) {
+		throw std::runtime_error("Could not open page file " + path);
+	}
+	try {
+		m_table = MeshPageTable::read(*m_file);
+	}
+	catch (const std::runtime_error& e) {
+		throw std::runtime_error(path + ": " + e.what());
+	}
+	m_keptFrame.resize(m_table.pages.size(), 0);
+	m_stats.pages = m_table.pages.size();
+	std::cout << "Opened " << path << ": " << m_table.triangleCount << " triangles in " << m_table.pages.size()
+		<< " pages, streamed within " << m_options.gpuBudget / (1024.0 * 1024.0) << " MB of VRAM" << std::endl;
+}
+
+const MeshPageTable& PagedMesh::table() const {
+	return m_table;
+}
+
+const glm::mat4& PagedMesh::getTransform() const {
+	return m_transform;
+}
+
+void PagedMesh::setTransform(const glm::mat4& transform) {
+	m_transform = transform;
+}
+
+const PagedMeshStats& PagedMesh::stats() const {
+	return m_stats;
+}
+
+bool PagedMesh::isKept(uint32_t page) const {
+	return m_keptFrame[page] == m_frame;
+}
+
+void PagedMesh::evictUnkept(size_t bytesNeeded) {
+	for (auto it = m_resident.begin(); it != m_resident.end()
+		&& m_residentBytes + m_pendingBytes + bytesNeeded > m_options.gpuBudget;) {
+		if (isKept(it->first)) {
+			++it;
+			continue;
+		}
+		m_residentBytes -= it->second.bytes;
+		it = m_resident.erase(it);
+	}
+}
+
+void PagedMesh::update(const ViewContext& view, std::chrono::microseconds budget) {
+	auto deadline = std::chrono::steady_clock::now() + budget;
+	m_frame++;
+
+	// Every page in or near the frustum is wanted. Pages in it come first, ordered by how much of
+	// the screen they cover; the prefetched ones near it follow, in the same order, by taking
+	// negative priorities that approach zero as they grow.
+	glm::vec3 axes[] = { glm::vec3(m_transform[0]), glm::vec3(m_transform[1]), glm::vec3(m_transform[2]) };
+	float scale = std::max({ glm::length(axes[0]), glm::length(axes[1]), glm::length(axes[2]) });
+	m_wanted.clear();
+	for (uint32_t p = 0; p < m_table.pages.size(); p++) {
+		const glm::vec4& bounds = m_table.pages[p].bounds;
+		glm::vec3 centre = glm::vec3(m_transform * glm::vec4(glm::vec3(bounds), 1));
+		float radius = bounds.w * scale;
+		if (outsideFrustum(view, centre, radius * (1 + m_options.prefetchMargin))) {
+			continue;
+		}
+		float distance = std::max(glm::length(view.cameraPosition - centre) - radius, radius * 0.01f);
+		float size = std::max(radius, 1e-6f) / std::max(distance, 1e-6f);
+		m_wanted.emplace_back(outsideFrustum(view, centre, radius) ? -1 / size : size, p);
+	}
+	std::sort(m_wanted.begin(), m_wanted.end(), [](auto& a, auto& b) { return a.first > b.first; });
+
+	// The budget keeps the most important wanted pages; the rest wait until more important ones leave.
+	size_t keptBytes = 0;
+	m_stats.wantedPages = m_wanted.size();
+	m_stats.keptPages = 0;
+	for (auto& wanted : m_wanted) {
+		size_t bytes = m_table.pages[wanted.second].gpuBytes();
+		if (keptBytes + bytes > m_options.gpuBudget) {
+			break;
+		}
+		keptBytes += bytes;
+		m_keptFrame[wanted.second] = m_frame;
+		m_stats.keptPages++;
+	}
+
+	// Kept pages that are not resident are read in priority order, making room for each by
+	// evicting pages that are no longer kept.
+	for (size_t w = 0; w < m_stats.keptPages && m_pending.size() < m_options.maxPendingLoads; w++) {
+		uint32_t page = m_wanted[w].second;
+		if (m_resident.count(page) != 0 || std::any_of(m_pending.begin(), m_pending.end(),
+			[page](const PendingPage& pending) { return pending.page == page; })) {
+			continue;
+		}
+		size_t bytes = m_table.pages[page].gpuBytes();
+		evictUnkept(bytes);
+		if (m_residentBytes + m_pendingBytes + bytes > m_options.gpuBudget) {
+			// Pages still being read hold the rest of the budget; try again once they arrive.
+			break;
+		}
+		m_pendingBytes += bytes;
+		auto file = m_file;
+		MeshPage entry = m_table.pages[page];
+		m_pending.push_back({ page, bytes, ThreadPool::shared().submit([file, entry]() {
+			const uint8_t* data = file->data() + entry.offset;
+			return std::vector<uint8_t>(data, data + entry.fileBytes());
+		}) });
+	}
+
+	// Pages are uploaded in whatever order their reads finish. Pages that stopped being kept while
+	// they were read are dropped.
+	bool uploadedAny = false;
+	for (auto it = m_pending.begin(); it != m_pending.end() && (!uploadedAny || std::chrono::steady_clock::now() < deadline);) {
+		if (it->data.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			++it;
+			continue;
+		}
+		std::vector<uint8_t> data = it->data.get();
+		m_pendingBytes -= it->bytes;
+		if (isKept(it->page)) {
+			const MeshPage& page = m_table.pages[it->page];
+			MeshPageView view = viewPage(page, data.data());
+			auto geometry = std::make_shared<MeshGeometry>();
+			geometry->upload(view.vertices, page.vertexCount, view.faces, page.faceCount,
+				std::vector<MeshLod>(view.lods, view.lods + page.lodCount),
+				std::vector<Meshlet>(view.meshlets, view.meshlets + page.meshletCount));
+			m_resident.emplace(it->page, ResidentPage{ Mesh3D(geometry, std::vector<Texture>(m_textures)), it->bytes });
+			m_residentBytes += it->bytes;
+			m_uploadedPages++;
+			m_reportedIdle = false;
+			uploadedAny = true;
+		}
+		it = m_pending.erase(it);
+	}
+
+	m_stats.residentPages = m_resident.size();
+	m_stats.residentBytes = m_residentBytes;
+	bool allResident = m_pending.empty() && std::all_of(m_wanted.begin(), m_wanted.begin() + m_stats.keptPages,
+		[this](const std::pair<float, uint32_t>& wanted) { return m_resident.count(wanted.second) != 0; });
+	if (allResident && !m_reportedIdle) {
+		m_reportedIdle = true;
+		std::cout << "Streamed " << m_uploadedPages << " pages; " << m_stats.residentPages << " resident in "
+			<< m_residentBytes / (1024.0 * 1024.0) << " MB of VRAM, for " << m_stats.wantedPages
+			<< " pages in or near view, of which the budget kept " << m_stats.keptPages << std::endl;
+	}
+}
+
+void PagedMesh::render(sf::Window& window, ShaderProgram& program, const ViewContext& view) const {
+	for (auto& resident : m_resident) {
+		resident.second.mesh.render(window, program, m_transform, view);
+	}
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <chrono>
+#include <deque>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "MappedFile.h"
+#include "Mesh3D.h"
+#include "MeshPages.h"
+
+struct PageStreamingOptions {
+	// The VRAM that resident pages may take in total.
+	size_t gpuBudget = size_t(512) << 20;
+	// Pages within this many of their own radii outside the frustum are streamed in too, so they
+	// are ready when the camera turns toward them.
+	float prefetchMargin = 1.0f;
+	// The most pages being read from disk at once.
+	size_t maxPendingLoads = 8;
+};
+
+struct PagedMeshStats {
+	size_t pages = 0;
+	// Pages in or near the frustum, and how many of those the budget has room for.
+	size_t wantedPages = 0;
+	size_t keptPages = 0;
+	size_t residentPages = 0;
+	size_t residentBytes = 0;
+};
+
+/**
+ * @brief A mesh too large to hold in memory, drawn from a page file written by buildMeshPages. Only
+ * the page table is read up front; each frame, update() picks the pages in or near the view
+ * frustum, reads them on the shared ThreadPool, and uploads them, keeping the pages it uploads
+ * within a fixed VRAM budget. When the pages in view need more than the budget, the ones covering
+ * the most of the screen win, and pages that are no longer wanted are evicted to make room.
+ * Resident pages are drawn as ordinary meshes, with their own levels of detail and meshlet culling.
+ */
+class PagedMesh {
+private:
+	/**
+	 * @brief A page being read on the ThreadPool, and its bytes in VRAM once uploaded.
+	 */
+	struct PendingPage {
+		uint32_t page;
+		size_t bytes;
+		std::future<std::vector<uint8_t>> data;
+	};
+
+	/**
+	 * @brief A page in VRAM, drawn as its own mesh.
+	 */
+	struct ResidentPage {
+		Mesh3D mesh;
+		size_t bytes;
+	};
+
+	std::shared_ptr<MappedFile> m_file;
+	MeshPageTable m_table;
+	std::vector<Texture> m_textures;
+	PageStreamingOptions m_options;
+	glm::mat4 m_transform;
+
+	std::unordered_map<uint32_t, ResidentPage> m_resident;
+	std::deque<PendingPage> m_pending;
+	size_t m_residentBytes;
+	size_t m_pendingBytes;
+	// The frame in which each page was last chosen to be resident, and the current frame.
+	std::vector<uint64_t> m_keptFrame;
+	uint64_t m_frame;
+	// Reused by every update, so choosing pages does not allocate each frame.
+	std::vector<std::pair<float, uint32_t>> m_wanted;
+	PagedMeshStats m_stats;
+	size_t m_uploadedPages;
+	bool m_reportedIdle;
+
+	bool isKept(uint32_t page) const;
+	void evictUnkept(size_t bytesNeeded);
+
+public:
+	/**
+	 * @brief Maps a page file and reads its page table. The given textures are bound for every page.
+	 * @throws std::runtime_error if the file cannot be opened or is not a valid page file.
+	 */
+	PagedMesh(const std::string& path, std::vector<Texture>&& textures, const PageStreamingOptions& options = {});
+
+	const MeshPageTable& table() const;
+	const glm::mat4& getTransform() const;
+	void setTransform(const glm::mat4& transform);
+
+	/**
+	 * @brief Chooses the pages to keep for the given view, starts reading the missing ones, and
+	 * uploads pages that have been read until the time budget is spent. Must be called on the
+	 * thread that owns the OpenGL context, once per frame before render(). At least one page is
+	 * uploaded per call when one is ready, so streaming always makes progress.
+	 */
+	void update(const ViewContext& view, std::chrono::microseconds budget);
+
+	/**
+	 * @brief Renders the resident pages; see Mesh3D::render.
+	 */
+	void render(sf::Window& window, ShaderProgram& program, const ViewContext& view) const;
+
+	/**
+	 * @brief The page counts and VRAM of the last update.
+	 */
+	const PagedMeshStats& stats() const;
+};
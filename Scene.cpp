@@ -1,12 +1,34 @@
 #include "Scene.h"
 #include "AssimpImport.h"
+#include "GltfImport.h"
+#include "ObjImport.h"
 #include "ShaderProgram.h"
 #include "Texture.h"
+#include "TextureCache.h"
 
+/**
+ * @brief Loads a model, or queues it on the streamer if there is one. glTF models take the native
+ * fast path; everything else goes through Assimp, which applies the hierarchy options.
+ */
+static Object3D loadModel(const std::string& path, bool flipTextureCoords, AssetStreamer* streamer,
+    const HierarchyOptions& hierarchy = {}) {
+    if (streamer != nullptr) {
+        return streamer->load(path, flipTextureCoords, ImportProfile::MaxQuality, hierarchy);
+    }
+    auto extension = std::filesystem::path(path).extension();
+    if (extension == ".gltf") {
+        return gltfLoad(path, flipTextureCoords);
+    }
+    if (extension == ".obj") {
+        return objLoad(path, flipTextureCoords);
+    }
+    return assimpLoad(path, flipTextureCoords, ImportProfile::MaxQuality, hierarchy);
+}
 
-
-Scene Scene::jeep() {
-    auto jeep = assimpLoad("../models/mil_jeep_fbx/mil_jeep.fbx", true);
+Scene Scene::jeep(LoadMode mode) {
+    auto streamer = mode == LoadMode::Streaming ? std::make_shared<AssetStreamer>() : nullptr;
+    // The jeep only ever moves as a whole, so all of its static parts are batched into the root.
+    auto jeep = loadModel("../models/mil_jeep_fbx/mil_jeep.fbx", true, streamer.get(), HierarchyOptions{ false, true, 0 });
     jeep.move(glm::vec3(0, -1.2, 0));
     jeep.grow(glm::vec3(0.004, 0.004, 0.004));
 
@@ -17,11 +39,13 @@ Scene Scene::jeep() {
     std::vector<Animator> animators;
     animators.push_back(std::move(animJeep));
 
-    return Scene {
+    Scene scene {
             ShaderProgram::phongLighting(),
             std::move(objects),
             std::move(animators)
     };
+    scene.streamer = streamer;
+    return scene;
 }
 
 /**
@@ -29,12 +53,15 @@ Scene Scene::jeep() {
  * of the boat.
  * @return
  */
-Scene Scene::lifeOfPi() {
+Scene Scene::lifeOfPi(LoadMode mode) {
     // This scene is more complicated; it has child objects, as well as animators.
-    auto boat = assimpLoad("../models/boat/boat.fbx", true);
+    auto streamer = mode == LoadMode::Streaming ? std::make_shared<AssetStreamer>() : nullptr;
+    // The boat's static parts are batched; its top-level children stay in place, since the tiger is
+    // found below as the boat's child at index 1.
+    auto boat = loadModel("../models/boat/boat.fbx", true, streamer.get(), HierarchyOptions{ false, true, 1 });
     boat.move(glm::vec3(0, -0.7, 0));
     boat.grow(glm::vec3(0.01, 0.01, 0.01));
-    auto tiger = assimpLoad("../models/tiger/scene.gltf", true);
+    auto tiger = loadModel("../models/tiger/scene.gltf", true, streamer.get());
     tiger.move(glm::vec3(0, -5, 10));
     boat.addChild(std::move(tiger));
 
@@ -59,18 +86,39 @@ Scene Scene::lifeOfPi() {
     animators.push_back(std::move(animTiger));
 
     // Transfer ownership of the objects and animators back to the main.
-    return Scene {
+    Scene scene {
             ShaderProgram::phongLighting(),
             std::move(objects),
             std::move(animators)
     };
+    scene.streamer = streamer;
+    return scene;
+}
+
+/**
+ * @brief Constructs a scene of a scan paged by mesh_pager, scaled and centred to fill the view.
+ */
+Scene Scene::scan(const std::string& pagesPath, const std::string& texturePath) {
+    std::vector<Texture> textures = { TextureCache::load(texturePath, "baseTexture") };
+    auto scan = std::make_shared<PagedMesh>(pagesPath, std::move(textures));
+    const glm::vec4& bounds = scan->table().bounds;
+    float scale = bounds.w > 0 ? 2 / bounds.w : 1;
+    scan->setTransform(glm::scale(glm::mat4(1), glm::vec3(scale)) * glm::translate(glm::mat4(1), -glm::vec3(bounds)));
+
+    Scene scene {
+            ShaderProgram::phongLighting(),
+            std::vector<Object3D>{},
+            std::vector<Animator>{}
+    };
+    scene.pagedMeshes.push_back(std::move(scan));
+    return scene;
 }
 
 /**
  * @brief Constructs a scene of the textured Stanford bunny.
  */
 Scene bunny() {
-    auto bunny = assimpLoad("../models/bunny_textured.obj", true);
+    auto bunny = loadModel("../models/bunny_textured.obj", true, nullptr);
     bunny.grow(glm::vec3(9, 9, 9));
     bunny.move(glm::vec3(0.2, -1, 0));
 
@@ -87,7 +135,7 @@ Scene bunny() {
  */
 Scene marbleSquare() {
     std::vector<Texture> textures = {
-            Texture::loadTexture("../models/White_marble_03/Textures_4K/white_marble_03_4k_baseColor.tga", "baseTexture"),
+            TextureCache::load("../models/White_marble_03/Textures_4K/white_marble_03_4k_baseColor.tga", "baseTexture"),
     };
 
     auto mesh = Mesh3D::square(textures);
@@ -2,24 +2,42 @@
 #define MATTSQUARED_GRAPHICS_SCENE_H
 
 
+#include <memory>
 #include <vector>
 #include "ShaderProgram.h"
 #include "Object3D.h"
 #include "Animator.h"
+#include "AssetStreamer.h"
+#include "PagedMesh.h"
+
+/**
+ * @brief How a scene's models are loaded. Blocking loads every mesh and texture before the scene is
+ * returned; Streaming returns the scene as soon as its hierarchy exists, and fills in meshes and textures
+ * over the following frames through the scene's streamer.
+ */
+enum class LoadMode {
+    Blocking,
+    Streaming
+};
 
 class Scene {
 public:
     ShaderProgram defaultShader;
     std::vector<Object3D> objects;
     std::vector<Animator> animators;
+    // Set only for scenes loaded in Streaming mode; must be updated once per frame.
+    std::shared_ptr<AssetStreamer> streamer;
+    // Meshes streamed in by page as the view moves; each must be updated once per frame.
+    std::vector<std::shared_ptr<PagedMesh>> pagedMeshes;
 
     Scene(ShaderProgram &&defaultShader, std::vector<Object3D> &&objects, std::vector<Animator> &&animators)
         : defaultShader(defaultShader), objects(std::move(objects)), animators(std::move(animators)) {}
     Scene(ShaderProgram &&shader, const Object3D& object)
         : defaultShader(shader), objects(std::vector<Object3D>{object}) {}
 
-    static Scene jeep();
-    static Scene lifeOfPi();
+    static Scene jeep(LoadMode mode = LoadMode::Blocking);
+    static Scene lifeOfPi(LoadMode mode = LoadMode::Blocking);
+    static Scene scan(const std::string& pagesPath, const std::string& texturePath = "../models/missing_texture.png");
     static Scene bunny();
     static Scene marbleSquare();
 };
@@ -4,6 +4,7 @@
 #include <iostream>
 #include "stb_image.h"
 #include "StbImage.h"
+#include "AssetPack.h"
 
 StbImage::StbImage()
 {
@@ -18,11 +19,53 @@ StbImage::~StbImage()
         stbi_image_free(data);
 }
 
-void StbImage::loadFromFile(const std::string& filepath)
+StbImage::StbImage(StbImage&& other) noexcept
+    : width(other.width), height(other.height), bpp(other.bpp), data(other.data)
 {
-    data = stbi_load(filepath.c_str(), &width, &height, &bpp, 4);
+    other.data = nullptr;
+}
+
+StbImage& StbImage::operator=(StbImage&& other) noexcept
+{
+    if (this != &other)
+    {
+        if (data != nullptr)
+            stbi_image_free(data);
+        width = other.width;
+        height = other.height;
+        bpp = other.bpp;
+        data = other.data;
+        other.data = nullptr;
+    }
+    return *this;
+}
+
+bool StbImage::loadFromFile(const std::string& filepath)
+{
+    // Decoding straight out of a mapping or the asset pack skips stdio's buffered copy of the file.
+    auto file = AssetPack::open(filepath);
+    if (!file)
+    {
+        if (data != nullptr)
+            stbi_image_free(data);
+        data = nullptr;
+        std::cerr << "Failed to load image " << filepath << "!\n";
+        return false;
+    }
+    return loadFromMemory(file->data, file->size, filepath);
+}
+
+bool StbImage::loadFromMemory(const unsigned char* bytes, size_t size, const std::string& name)
+{
+    if (data != nullptr)
+        stbi_image_free(data);
+    data = stbi_load_from_memory(bytes, static_cast<int>(size), &width, &height, &bpp, 4);
     if (data == nullptr)
-        std::cerr << "Failed to load image!\n";
+    {
+        std::cerr << "Failed to load image " << name << "!\n";
+        return false;
+    }
+    return true;
 }
 
 int StbImage::getWidth() const { return width; }
@@ -2,6 +2,7 @@
 #define STB_IMAGE_H
 
 #define STB_IMAGE_IMPLEMENTATION
+#include <cstddef>
 #include <string>
 
 class StbImage
@@ -14,7 +15,15 @@ public:
     StbImage();
     ~StbImage();
 
-    void loadFromFile(const std::string& filepath);
+    // Decoded images own their pixels, so they can be moved between threads but not copied.
+    StbImage(const StbImage&) = delete;
+    StbImage& operator=(const StbImage&) = delete;
+    StbImage(StbImage&& other) noexcept;
+    StbImage& operator=(StbImage&& other) noexcept;
+
+    bool loadFromFile(const std::string& filepath);
+    // Decodes an image file's contents that are already in memory; the name is only used in errors.
+    bool loadFromMemory(const unsigned char* bytes, size_t size, const std::string& name);
 
     int getWidth() const;
     int getHeight() const;
@@ -22,4 +31,4 @@ public:
     unsigned char* getData() const;
 };
 
-#endif // STB_IMAGE_H
\ No newline at end of file
+#endif // STB_IMAGE_H
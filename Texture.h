@@ -1,23 +1,156 @@
 #pragma once
+#include <memory>
 #include <string>
 #include <filesystem>
+#include <cstring>
 #include <glad/glad.h>
+#include "BlockCompression.h"
+#include "Mipmaps.h"
 #include "StbImage.h"
 
+// Block-compressed formats that the OpenGL 4.1 loader does not define: S3TC (BC1 and BC3) is an
+// extension everywhere, and BPTC (BC7) is only core from OpenGL 4.2.
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
+/**
+ * @brief Owns a texture object in VRAM, which is deleted when the last Texture sharing this handle is
+ * destroyed. Every copy of a Texture shares one handle, so the object it names can be replaced in place;
+ * for example, when a streamed texture finishes loading.
+ */
+struct TextureHandle {
+	// The texture object, or 0 if it has not been uploaded yet.
+	uint32_t id = 0;
+	// The approximate VRAM used by the texture object, including its mipmaps.
+	size_t bytes = 0;
+	// True for BC5 normal maps, which store only X and Y; the shader rebuilds Z.
+	bool twoChannel = false;
+	// A texture to bind in place of this one until it is uploaded, or for good if this image turned
+	// out to be identical to that texture's.
+	std::shared_ptr<TextureHandle> placeholder;
+
+	TextureHandle() = default;
+	TextureHandle(uint32_t textureId, size_t textureBytes, bool isTwoChannel = false)
+		: id(textureId), bytes(textureBytes), twoChannel(isTwoChannel) {}
+	TextureHandle(const TextureHandle&) = delete;
+	TextureHandle& operator=(const TextureHandle&) = delete;
+
+	~TextureHandle() {
+		if (id != 0) {
+			glDeleteTextures(1, &id);
+		}
+	}
+
+	/**
+	 * @brief The texture object to bind: this handle's own, or its placeholder's if not uploaded yet.
+	 */
+	uint32_t boundId() const {
+		if (id == 0 && placeholder != nullptr) {
+			return placeholder->boundId();
+		}
+		return id;
+	}
+
+	/**
+	 * @brief Whether the texture object that boundId() names is a two-channel normal map.
+	 */
+	bool boundTwoChannel() const {
+		if (id == 0 && placeholder != nullptr) {
+			return placeholder->boundTwoChannel();
+		}
+		return twoChannel;
+	}
+};
+
 /**
  * @brief Represents a texture that has been loaded into VRAM, and is expected to be bound
  * to a sampler2D with a given sampler name in the fragment shader.
  */
 struct Texture {
-	// The ID of the texture, to be bound with glBindTexture when drawing a mesh.
-	uint32_t textureId;
+	// The texture to be bound with glBindTexture when drawing a mesh.
+	std::shared_ptr<TextureHandle> handle;
 	// The name of the sampler2D uniform in the fragment shader that this texture will bind to.
 	std::string samplerName;
 
 	/**
-	 * @brief Loads an SFML Image into VRAM and returns a Texture object identifying it.
+	 * @brief The ID of the texture, to be bound with glBindTexture when drawing a mesh.
 	 */
-	static Texture loadImage(const StbImage& texture, const std::string& samplerName) {
+	uint32_t textureId() const {
+		return handle->boundId();
+	}
+
+	/**
+	 * @brief The approximate VRAM needed for a decoded RGBA image and its full mipmap chain.
+	 */
+	static size_t imageBytes(const StbImage& texture) {
+		return static_cast<size_t>(texture.getWidth()) * texture.getHeight() * 4 * 4 / 3;
+	}
+
+	/**
+	 * @brief Whether a texture stores only a normal's X and Y, as BC5 normal maps do.
+	 */
+	static bool isTwoChannel(const GpuTexture& texture) {
+		return texture.format == BlockFormat::BC5;
+	}
+
+	/**
+	 * @brief The VRAM used by an uploaded GpuTexture: the sum of its levels.
+	 */
+	static size_t textureBytes(const GpuTexture& texture) {
+		return texture.bytes();
+	}
+
+	/**
+	 * @brief The block-compressed formats the current OpenGL context can sample, queried once. Must
+	 * first be called on the thread that owns the context.
+	 */
+	static const BlockFormatSupport& blockFormatSupport() {
+		static const BlockFormatSupport support = []() {
+			// RGTC (BC4 and BC5) is core since OpenGL 3.0.
+			BlockFormatSupport result;
+			result.bc4 = result.bc5 = true;
+			result.bc7 = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 2);
+			GLint count = 0;
+			glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+			for (GLint i = 0; i < count; i++) {
+				auto name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+				if (strcmp(name, "GL_EXT_texture_compression_s3tc") == 0) {
+					result.bc1 = result.bc3 = true;
+				}
+				else if (strcmp(name, "GL_ARB_texture_compression_bptc") == 0) {
+					result.bc7 = true;
+				}
+			}
+			return result;
+		}();
+		return support;
+	}
+
+	/**
+	 * @brief The OpenGL internal format of a block-compressed format.
+	 */
+	static GLenum compressedFormat(BlockFormat format) {
+		switch (format) {
+		case BlockFormat::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		case BlockFormat::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		case BlockFormat::BC4: return GL_COMPRESSED_RED_RGTC1;
+		case BlockFormat::BC5: return GL_COMPRESSED_RG_RGTC2;
+		case BlockFormat::BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+		default: return GL_RGBA;
+		}
+	}
+
+	/**
+	 * @brief Creates a new texture object with the renderer's wrapping and filtering, and leaves it bound.
+	 */
+	static uint32_t createTexture() {
 		uint32_t texId;
 		glGenTextures(1, &texId);
 		glBindTexture(GL_TEXTURE_2D, texId);
@@ -25,12 +158,81 @@ struct Texture {
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texture.getWidth(), texture.getHeight(), 0, GL_RGBA,
-			GL_UNSIGNED_BYTE, texture.getData());
-		glGenerateMipmap(GL_TEXTURE_2D);
+		return texId;
+	}
+
+	/**
+	 * @brief Uploads a decoded image into a new texture object in VRAM, and returns its ID. Its
+	 * mipmaps are generated on the CPU, as a colour texture's.
+	 */
+	static uint32_t uploadImage(const StbImage& texture) {
+		if (texture.getData() == nullptr) {
+			return uploadTexture(GpuTexture{});
+		}
+		return uploadTexture(generateMipmaps(texture.getData(), texture.getWidth(), texture.getHeight(), TextureUsage::Color));
+	}
+
+	/**
+	 * @brief Uploads a texture in its own format, with every mip level it has, into a new texture
+	 * object in VRAM, and returns its ID. The mip levels come from the texture, never from
+	 * glGenerateMipmap. Where the context supports it, storage for every level is allocated once,
+	 * immutably, and each level is copied into it; otherwise each level is specified in turn.
+	 * Compressed levels go up as they are, with no decoding. BC4 textures are grey colour
+	 * textures, so their one channel is swizzled into red, green, and blue. BC5 normal maps keep
+	 * their two channels; their handles are marked twoChannel, so the shader rebuilds Z.
+	 * An invalid texture gets a texture object with no storage, which samples as black.
+	 */
+	static uint32_t uploadTexture(const GpuTexture& texture) {
+		uint32_t texId = createTexture();
+		if (!texture.valid()) {
+			glBindTexture(GL_TEXTURE_2D, 0);
+			return texId;
+		}
+		bool compressed = texture.format != BlockFormat::RGBA8;
+		GLenum internalFormat = compressed ? compressedFormat(texture.format) : GL_RGBA8;
+		auto levels = static_cast<GLsizei>(texture.levels.size());
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+		if (GLAD_GL_ARB_texture_storage) {
+			glTexStorage2D(GL_TEXTURE_2D, levels, internalFormat, texture.width(), texture.height());
+		}
+		for (GLint l = 0; l < levels; l++) {
+			const GpuTextureLevel& level = texture.levels[l];
+			auto size = static_cast<GLsizei>(level.size);
+			if (GLAD_GL_ARB_texture_storage && compressed) {
+				glCompressedTexSubImage2D(GL_TEXTURE_2D, l, 0, 0, level.width, level.height, internalFormat, size, level.data);
+			}
+			else if (GLAD_GL_ARB_texture_storage) {
+				glTexSubImage2D(GL_TEXTURE_2D, l, 0, 0, level.width, level.height, GL_RGBA, GL_UNSIGNED_BYTE, level.data);
+			}
+			else if (compressed) {
+				glCompressedTexImage2D(GL_TEXTURE_2D, l, internalFormat, level.width, level.height, 0, size, level.data);
+			}
+			else {
+				glTexImage2D(GL_TEXTURE_2D, l, internalFormat, level.width, level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+					level.data);
+			}
+		}
+		if (texture.format == BlockFormat::BC4) {
+			GLint swizzle[] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+			glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+		}
 		glBindTexture(GL_TEXTURE_2D, 0);
+		return texId;
+	}
+
+	/**
+	 * @brief Loads an SFML Image into VRAM and returns a Texture object identifying it.
+	 */
+	static Texture loadImage(const StbImage& texture, const std::string& samplerName) {
+		return Texture{ std::make_shared<TextureHandle>(uploadImage(texture), imageBytes(texture)), samplerName };
+	}
 
-		return Texture{ texId, samplerName };
+	/**
+	 * @brief Uploads a texture prepared for the GPU and returns a Texture object identifying it.
+	 */
+	static Texture loadImage(const GpuTexture& texture, const std::string& samplerName) {
+		return Texture{ std::make_shared<TextureHandle>(uploadTexture(texture), textureBytes(texture), isTwoChannel(texture)),
+			samplerName };
 	}
 
     /**
@@ -41,4 +243,4 @@ struct Texture {
         i.loadFromFile(path.string());
         return Texture::loadImage(i, samplerName);
     }
-};
\ No newline at end of file
+};
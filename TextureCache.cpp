@@ -0,0 +1,110 @@
+#include "TextureCache.h"
+#include "AssetPack.h"
+#include "Hash.h"
+#include "TextureLoader.h"
+#include <unordered_set>
+
+std::unordered_map<std::string, std::weak_ptr<TextureHandle>>& TextureCache::entries() {
+	static std::unordered_map<std::string, std::weak_ptr<TextureHandle>> cache;
+	return cache;
+}
+
+std::unordered_map<uint64_t, std::weak_ptr<TextureHandle>>& TextureCache::contents() {
+	static std::unordered_map<uint64_t, std::weak_ptr<TextureHandle>> cache;
+	return cache;
+}
+
+TextureCacheStats& TextureCache::counters() {
+	static TextureCacheStats stats{};
+	return stats;
+}
+
+std::string TextureCache::canonicalPath(const std::filesystem::path& path) {
+	std::error_code error;
+	auto canonical = std::filesystem::weakly_canonical(path, error);
+	if (error) {
+		return path.lexically_normal().string();
+	}
+	return canonical.string();
+}
+
+std::string TextureCache::pathKey(const std::filesystem::path& path, TextureUsage usage) {
+	return canonicalPath(path) + "|" + textureUsageName(usage);
+}
+
+uint64_t TextureCache::contentKey(uint64_t contentHash, TextureUsage usage) {
+	return fnv1a64(&usage, sizeof(usage), contentHash);
+}
+
+std::shared_ptr<TextureHandle> TextureCache::find(const std::filesystem::path& path, TextureUsage usage) {
+	auto existing = entries().find(pathKey(path, usage));
+	if (existing != entries().end()) {
+		auto handle = existing->second.lock();
+		if (handle != nullptr) {
+			counters().hits++;
+			return handle;
+		}
+		// The texture was released after its last user went away.
+		entries().erase(existing);
+	}
+	counters().misses++;
+	return nullptr;
+}
+
+void TextureCache::insert(const std::filesystem::path& path, TextureUsage usage, const std::shared_ptr<TextureHandle>& handle) {
+	entries()[pathKey(path, usage)] = handle;
+}
+
+std::shared_ptr<TextureHandle> TextureCache::findContent(uint64_t contentHash, TextureUsage usage) {
+	auto existing = contents().find(contentKey(contentHash, usage));
+	if (existing == contents().end()) {
+		return nullptr;
+	}
+	auto handle = existing->second.lock();
+	if (handle == nullptr) {
+		contents().erase(existing);
+		return nullptr;
+	}
+	counters().contentHits++;
+	return handle;
+}
+
+void TextureCache::insertContent(uint64_t contentHash, TextureUsage usage, const std::shared_ptr<TextureHandle>& handle) {
+	contents()[contentKey(contentHash, usage)] = handle;
+}
+
+Texture TextureCache::load(const std::filesystem::path& path, const std::string& samplerName) {
+	TextureUsage usage = textureUsage(samplerName);
+	auto handle = find(path, usage);
+	if (handle == nullptr) {
+		// Single textures are compressed and cached like a model's (see prepareTexture).
+		auto file = AssetPack::open(path);
+		uint64_t fileHash = file ? fileContentHash(file->data, file->size) : 0;
+		Texture tex = Texture::loadImage(prepareTexture(path.string(), file, fileHash, usage,
+			Texture::blockFormatSupport()), samplerName);
+		insert(path, usage, tex.handle);
+		return tex;
+	}
+	return Texture{ handle, samplerName };
+}
+
+TextureCacheStats TextureCache::stats() {
+	TextureCacheStats stats = counters();
+	stats.residentTextures = 0;
+	stats.residentBytes = 0;
+	// Paths with identical contents share a handle, which is only counted once.
+	std::unordered_set<const TextureHandle*> counted;
+	for (auto it = entries().begin(); it != entries().end();) {
+		auto handle = it->second.lock();
+		if (handle == nullptr) {
+			it = entries().erase(it);
+			continue;
+		}
+		if (counted.insert(handle.get()).second) {
+			stats.residentTextures++;
+			stats.residentBytes += handle->bytes;
+		}
+		++it;
+	}
+	return stats;
+}
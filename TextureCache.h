@@ -0,0 +1,77 @@
+#pragma once
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include "Texture.h"
+
+/**
+ * @brief Counters describing the effectiveness of the TextureCache.
+ */
+struct TextureCacheStats {
+	// Lookups that found a live texture, and lookups that did not.
+	size_t hits;
+	size_t misses;
+	// Lookups by content hash that found a live texture holding an identical image.
+	size_t contentHits;
+	// Distinct textures that are still referenced by at least one Texture, and their approximate VRAM.
+	size_t residentTextures;
+	size_t residentBytes;
+};
+
+/**
+ * @brief A process-wide cache of texture objects, keyed by the canonical path of their image files, so
+ * that every import referencing the same image shares one texture in VRAM. Textures are also indexed
+ * by content hash, so that identical images stored under different names share one texture too. The cache holds only weak
+ * references: a texture is deleted when the last Texture (and so the last Mesh3D) using it is gone.
+ * Both keys include the texture's usage, since an image is compressed differently for each usage
+ * (see chooseBlockFormat), so a normal map is never handed out as a colour texture or the reverse.
+ * The cache must only be used from the thread that owns the OpenGL context.
+ */
+class TextureCache {
+private:
+	static std::unordered_map<std::string, std::weak_ptr<TextureHandle>>& entries();
+	static std::unordered_map<uint64_t, std::weak_ptr<TextureHandle>>& contents();
+	static TextureCacheStats& counters();
+	static std::string pathKey(const std::filesystem::path& path, TextureUsage usage);
+	static uint64_t contentKey(uint64_t contentHash, TextureUsage usage);
+
+public:
+	/**
+	 * @brief The key under which the image at the given path is cached.
+	 */
+	static std::string canonicalPath(const std::filesystem::path& path);
+
+	/**
+	 * @brief Finds the live texture for an image path prepared for the given usage, counting a hit or a miss.
+	 * @return nullptr if the image is not resident.
+	 */
+	static std::shared_ptr<TextureHandle> find(const std::filesystem::path& path, TextureUsage usage);
+
+	/**
+	 * @brief Records the texture for an image path prepared for the given usage, so later lookups share it.
+	 */
+	static void insert(const std::filesystem::path& path, TextureUsage usage, const std::shared_ptr<TextureHandle>& handle);
+
+	/**
+	 * @brief Finds the live texture prepared for the given usage whose image file bytes or decoded
+	 * pixels have the given hash (see fileContentHash and textureContentHash).
+	 * @return nullptr if no resident texture has that content.
+	 */
+	static std::shared_ptr<TextureHandle> findContent(uint64_t contentHash, TextureUsage usage);
+
+	/**
+	 * @brief Records the texture prepared for the given usage holding content with the given hash.
+	 */
+	static void insertContent(uint64_t contentHash, TextureUsage usage, const std::shared_ptr<TextureHandle>& handle);
+
+	/**
+	 * @brief Returns the cached texture for an image path, preparing and uploading it on a miss.
+	 */
+	static Texture load(const std::filesystem::path& path, const std::string& samplerName);
+
+	/**
+	 * @brief The cache's hit and miss counts, and the textures currently resident.
+	 */
+	static TextureCacheStats stats();
+};
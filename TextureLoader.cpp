@@ -0,0 +1,266 @@
+#include "TextureLoader.h"
+#include "AssetPack.h"
+#include "GpuTextureCache.h"
+#include "Hash.h"
+#include "MaterialPacker.h"
+#include "Mipmaps.h"
+#include "TextureCache.h"
+#include "ThreadPool.h"
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <unordered_set>
+
+namespace {
+	/**
+	 * @brief The result of preparing one image on a worker thread.
+	 */
+	struct DecodedImage {
+		GpuTexture texture;
+		uint64_t pixelHash;
+		bool fromCache;
+		std::chrono::duration<double, std::milli> decodeTime;
+	};
+}
+
+uint64_t fileContentHash(const uint8_t* bytes, size_t size) {
+	return fnv1a64(bytes, size);
+}
+
+uint64_t imageContentHash(const StbImage& image) {
+	// The dimensions seed the hash, and a distinct seed keeps pixel hashes apart from file hashes.
+	int dimensions[] = { image.getWidth(), image.getHeight() };
+	uint64_t seed = fnv1a64(dimensions, sizeof(dimensions), fnv1a64("pixels", 6));
+	if (image.getData() == nullptr) {
+		return seed;
+	}
+	return fnv1a64(image.getData(), static_cast<size_t>(image.getWidth()) * image.getHeight() * 4, seed);
+}
+
+uint64_t textureContentHash(const GpuTexture& texture) {
+	if (texture.format == BlockFormat::RGBA8) {
+		int dimensions[] = { static_cast<int>(texture.width()), static_cast<int>(texture.height()) };
+		uint64_t seed = fnv1a64(dimensions, sizeof(dimensions), fnv1a64("pixels", 6));
+		return texture.valid() ? fnv1a64(texture.levels[0].data, texture.levels[0].size, seed) : seed;
+	}
+	// Compressed textures are seeded by their format too, and never match an uncompressed one.
+	uint32_t header[] = { static_cast<uint32_t>(texture.format), texture.width(), texture.height() };
+	uint64_t seed = fnv1a64(header, sizeof(header), fnv1a64("blocks", 6));
+	return fnv1a64(texture.levels[0].data, texture.levels[0].size, seed);
+}
+
+std::filesystem::path loadedTextureKey(const TextureRef& ref) {
+	return ref.path + "|" + textureUsageName(textureUsage(ref.samplerName));
+}
+
+TextureUsage textureUsage(const std::string& samplerName) {
+	if (samplerName == "normalMap") {
+		return TextureUsage::Normal;
+	}
+	if (samplerName == MATERIAL_MAP_SAMPLER) {
+		return TextureUsage::Material;
+	}
+	return TextureUsage::Color;
+}
+
+GpuTexture prepareTexture(const std::string& path, const std::optional<AssetBytes>& file, uint64_t fileHash,
+	TextureUsage usage, const BlockFormatSupport& support, bool* fromCache) {
+	if (fromCache) { *fromCache = false; }
+	// A packed material map's file is its recipe, and its texture is cached under the hash of the
+	// maps it names, so editing one of them packs the texture again.
+	auto recipe = file && usage == TextureUsage::Material ? readMaterialRecipe(*file) : std::nullopt;
+	if (recipe) {
+		fileHash = materialRecipeHash(*recipe);
+	}
+	if (file) {
+		auto cached = GpuTextureCache::load(fileHash, usage, support);
+		if (cached) {
+			if (fromCache) { *fromCache = true; }
+			return std::move(*cached);
+		}
+	}
+
+	StbImage image;
+	std::vector<uint8_t> packed;
+	const uint8_t* pixels;
+	uint32_t width, height;
+	if (recipe) {
+		packed = packMaterialTexels(*recipe, width, height);
+		pixels = packed.data();
+	}
+	else {
+		if (file) {
+			image.loadFromMemory(file->data, file->size, path);
+		}
+		else {
+			image.loadFromFile(path);
+		}
+		pixels = image.getData();
+		width = image.getWidth();
+		height = image.getHeight();
+	}
+	GpuTexture texture;
+	if (pixels == nullptr) {
+		return texture;
+	}
+	GpuTexture mipmaps = generateMipmaps(pixels, width, height, usage);
+	BlockFormat format = chooseBlockFormat(usage, pixels, width, height, support);
+	texture = compressTexture(mipmaps, format);
+	if (file) {
+		GpuTextureCache::store(fileHash, usage, support, texture);
+	}
+	return texture;
+}
+
+void loadModelTextures(const ModelView& model,
+	std::unordered_map<std::filesystem::path, Texture, PathHash>& loadedTextures) {
+	std::vector<TextureRef> refs;
+	for (auto& mesh : model.meshes) {
+		refs.insert(refs.end(), mesh.textures.begin(), mesh.textures.end());
+	}
+	loadTextures(refs, loadedTextures);
+}
+
+void loadTextures(const std::vector<TextureRef>& refs,
+	std::unordered_map<std::filesystem::path, Texture, PathHash>& loadedTextures) {
+	// Gather each texture path once per usage, in the order the meshes reference them. The first
+	// reference decides the sampler name, as it does when textures are loaded one mesh at a time.
+	// Images that an earlier import already put in VRAM are shared through the TextureCache.
+	std::vector<TextureRef> pending;
+	std::unordered_set<std::string> seen;
+	for (auto& ref : refs) {
+		auto key = loadedTextureKey(ref);
+		if (loadedTextures.find(key) != loadedTextures.end() || !seen.insert(key.string()).second) {
+			continue;
+		}
+		auto cached = TextureCache::find(ref.path, textureUsage(ref.samplerName));
+		if (cached != nullptr) {
+			loadedTextures.insert(std::make_pair(key, Texture{ cached, ref.samplerName }));
+		}
+		else {
+			pending.push_back(ref);
+		}
+	}
+	if (pending.empty()) {
+		return;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	ThreadPool& pool = ThreadPool::shared();
+	BlockFormatSupport support = Texture::blockFormatSupport();
+
+	// First pass: read and hash every file, so files with identical bytes are only decoded once.
+	std::vector<std::optional<AssetBytes>> files(pending.size());
+	std::vector<uint64_t> fileHashes(pending.size());
+	pool.parallelFor(pending.size(), [&](size_t i) {
+		files[i] = AssetPack::open(pending[i].path);
+		if (files[i]) {
+			fileHashes[i] = fileContentHash(files[i]->data, files[i]->size);
+		}
+	});
+
+	// Each image is either shared with a resident texture, a copy of an earlier pending file, or
+	// decoded. Only textures prepared for the same usage are shared, since usage decides the format.
+	std::vector<TextureUsage> usages(pending.size());
+	std::vector<std::shared_ptr<TextureHandle>> handles(pending.size());
+	std::vector<size_t> sameFileAs(pending.size());
+	std::map<std::pair<uint64_t, TextureUsage>, size_t> firstWithFile;
+	std::vector<std::future<DecodedImage>> decoded(pending.size());
+	for (size_t i = 0; i < pending.size(); i++) {
+		usages[i] = textureUsage(pending[i].samplerName);
+		sameFileAs[i] = i;
+		if (files[i]) {
+			handles[i] = TextureCache::findContent(fileHashes[i], usages[i]);
+			if (handles[i] != nullptr) {
+				continue;
+			}
+			sameFileAs[i] = firstWithFile.insert(std::make_pair(std::make_pair(fileHashes[i], usages[i]), i)).first->second;
+			if (sameFileAs[i] != i) {
+				continue;
+			}
+		}
+		auto file = files[i];
+		uint64_t fileHash = fileHashes[i];
+		std::string path = pending[i].path;
+		TextureUsage usage = usages[i];
+		decoded[i] = pool.submit([file, fileHash, path, usage, support]() {
+			auto decodeStart = std::chrono::steady_clock::now();
+			DecodedImage result;
+			result.texture = prepareTexture(path, file, fileHash, usage, support, &result.fromCache);
+			result.pixelHash = textureContentHash(result.texture);
+			result.decodeTime = std::chrono::steady_clock::now() - decodeStart;
+			return result;
+		});
+	}
+
+	// Upload in reference order as each decode finishes; later images keep decoding meanwhile.
+	// Decoded images with the same pixels as a resident texture share it instead.
+	std::chrono::duration<double, std::milli> serialDecodeTime(0);
+	size_t shared = 0;
+	size_t savedBytes = 0;
+	// Textures read from the GpuTextureCache rather than decoded; and textures uploaded compressed,
+	// with their VRAM against what they would take as RGBA8 with mipmaps.
+	size_t fromCache = 0;
+	size_t compressed = 0;
+	size_t compressedBytes = 0;
+	size_t uncompressedBytes = 0;
+	for (size_t i = 0; i < pending.size(); i++) {
+		bool isShared = true;
+		if (handles[i] == nullptr && sameFileAs[i] != i) {
+			handles[i] = handles[sameFileAs[i]];
+		}
+		else if (handles[i] == nullptr) {
+			DecodedImage result = decoded[i].get();
+			serialDecodeTime += result.decodeTime;
+			bool valid = result.texture.valid();
+			if (valid) {
+				handles[i] = TextureCache::findContent(result.pixelHash, usages[i]);
+			}
+			if (handles[i] == nullptr) {
+				handles[i] = Texture::loadImage(result.texture, pending[i].samplerName).handle;
+				isShared = false;
+				if (valid) {
+					TextureCache::insertContent(result.pixelHash, usages[i], handles[i]);
+				}
+				fromCache += result.fromCache ? 1 : 0;
+				if (result.texture.format != BlockFormat::RGBA8) {
+					compressed++;
+					compressedBytes += handles[i]->bytes;
+					uncompressedBytes += size_t(result.texture.width()) * result.texture.height() * 4 * 4 / 3;
+				}
+			}
+			if (files[i]) {
+				TextureCache::insertContent(fileHashes[i], usages[i], handles[i]);
+			}
+		}
+		if (isShared) {
+			shared++;
+			savedBytes += handles[i]->bytes;
+		}
+		loadedTextures.insert(std::make_pair(loadedTextureKey(pending[i]), Texture{ handles[i], pending[i].samplerName }));
+		TextureCache::insert(pending[i].path, usages[i], handles[i]);
+	}
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+	std::cout << "Loaded " << pending.size() << " textures in " << elapsed.count() << " ms on "
+		<< pool.size() << " threads (" << serialDecodeTime.count() << " ms of decoding, "
+		<< serialDecodeTime.count() / elapsed.count() << "x faster than decoding serially)" << std::endl;
+	if (compressed > 0) {
+		std::cout << "Uploaded " << compressed << " block-compressed textures in " << compressedBytes / (1024.0 * 1024.0) << " MB of VRAM instead of "
+			<< uncompressedBytes / (1024.0 * 1024.0) << " MB" << std::endl;
+	}
+	if (fromCache > 0) {
+		std::cout << "Read " << fromCache << " textures with their mipmaps from the texture cache" << std::endl;
+	}
+	if (shared > 0) {
+		std::cout << "Shared " << shared << " textures with identical images, saving "
+			<< savedBytes / (1024.0 * 1024.0) << " MB of VRAM" << std::endl;
+	}
+
+	TextureCacheStats stats = TextureCache::stats();
+	std::cout << "Texture cache: " << stats.hits << " hits, " << stats.misses << " misses, "
+		<< stats.residentTextures << " textures resident in " << stats.residentBytes / (1024.0 * 1024.0)
+		<< " MB" << std::endl;
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <filesystem>
+#include <optional>
+#include <unordered_map>
+#include "BlockCompression.h"
+#include "ModelData.h"
+#include "Texture.h"
+
+/**
+ * @brief Collects the unique texture paths referenced by a model, decodes them concurrently on the
+ * shared ThreadPool, and uploads each one to VRAM on the calling thread, which must own the OpenGL
+ * context. References that are already in loadedTextures are skipped; new textures are added to it,
+ * under their loadedTextureKey.
+ *
+ * Images are deduplicated by content: files with identical bytes are decoded once, and decoded
+ * images with identical pixels are uploaded once, even when they are stored under different names
+ * or were loaded by an earlier import. The VRAM this saves is reported per call.
+ *
+ * Each image is block-compressed for its usage (see prepareTexture) and uploaded compressed.
+ */
+void loadModelTextures(const ModelView& model,
+	std::unordered_map<std::filesystem::path, Texture, PathHash>& loadedTextures);
+
+/**
+ * @brief The key of a reference's texture in the maps that loadModelTextures fills: its path,
+ * qualified by the usage of its sampler, since an image is compressed differently for each usage.
+ */
+std::filesystem::path loadedTextureKey(const TextureRef& ref);
+
+/**
+ * @brief The content hash of an image file's bytes, for TextureCache::findContent.
+ */
+uint64_t fileContentHash(const uint8_t* bytes, size_t size);
+
+/**
+ * @brief The content hash of a decoded image's dimensions and pixels, for TextureCache::findContent.
+ */
+uint64_t imageContentHash(const StbImage& image);
+
+/**
+ * @brief The content hash of a prepared texture's format, dimensions, and first level, for
+ * TextureCache::findContent. RGBA8 textures hash like imageContentHash.
+ */
+uint64_t textureContentHash(const GpuTexture& texture);
+
+/**
+ * @brief What a texture bound to the given sampler is used for: "normalMap" is a normal map,
+ * "materialMap" a packed material map (see packMaterialMaps), and anything else is colour.
+ */
+TextureUsage textureUsage(const std::string& samplerName);
+
+/**
+ * @brief Prepares an image file for upload; safe to call from any thread. A texture compressed
+ * from the same file for the same usage before is read from the GpuTextureCache. Otherwise the
+ * image is decoded, its mip chain is built by generateMipmaps, and every level is compressed in the
+ * format chosen by chooseBlockFormat and cached. Images that stay RGBA8 are cached with their mip
+ * chain too, so no texture needs its mipmaps generated on the GPU. A packed material map's file is
+ * the recipe packMaterialMaps wrote; its maps are packed here, and cached under their contents' hash.
+ * @param file the file's bytes, if they were read already, and their fileContentHash. Without
+ * them the image is decoded from the path and not cached.
+ * @param fromCache if given, set to whether the texture came from the GpuTextureCache.
+ * @return an invalid texture if the image could not be read.
+ */
+GpuTexture prepareTexture(const std::string& path, const std::optional<AssetBytes>& file, uint64_t fileHash,
+	TextureUsage usage, const BlockFormatSupport& support, bool* fromCache = nullptr);
+
+/**
+ * @brief Loads the given texture references the same way as loadModelTextures, for importers that
+ * do not produce a ModelView.
+ */
+void loadTextures(const std::vector<TextureRef>& refs,
+	std::unordered_map<std::filesystem::path, Texture, PathHash>& loadedTextures);
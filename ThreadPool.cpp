@@ -0,0 +1,48 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(size_t threadCount) : m_stopping(false) {
+	if (threadCount == 0) {
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+	m_workers.reserve(threadCount);
+	for (size_t i = 0; i < threadCount; i++) {
+		m_workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_condition.notify_all();
+	for (auto& worker : m_workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::workerLoop() {
+	while (true) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+			// Drain the queue before stopping, so no submitted future is left unsatisfied.
+			if (m_tasks.empty()) {
+				return;
+			}
+			task = std::move(m_tasks.front());
+			m_tasks.pop();
+		}
+		task();
+	}
+}
+
+size_t ThreadPool::size() const {
+	return m_workers.size();
+}
+
+ThreadPool& ThreadPool::shared() {
+	static ThreadPool pool;
+	return pool;
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief A fixed set of worker threads that run submitted tasks in FIFO order. Used by the importers
+ * for CPU-only work such as image decoding; tasks must never call OpenGL.
+ */
+class ThreadPool {
+private:
+	std::vector<std::thread> m_workers;
+	std::queue<std::function<void()>> m_tasks;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	bool m_stopping;
+
+	void workerLoop();
+
+public:
+	/**
+	 * @brief Starts the given number of worker threads, or one per hardware thread if 0.
+	 */
+	explicit ThreadPool(size_t threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/**
+	 * @brief Queues a task, returning a future for its result. Exceptions thrown by the task are
+	 * rethrown from the future's get().
+	 */
+	template <typename F>
+	auto submit(F&& task) -> std::future<decltype(task())> {
+		using Result = decltype(task());
+		auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+		std::future<Result> result = packaged->get_future();
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_tasks.emplace([packaged]() { (*packaged)(); });
+		}
+		m_condition.notify_one();
+		return result;
+	}
+
+	/**
+	 * @brief Calls body(i) for every i in [0, count), spread across the pool in contiguous chunks,
+	 * and waits for all of them. Must not be called from inside one of the pool's own tasks.
+	 */
+	template <typename F>
+	void parallelFor(size_t count, F&& body) {
+		if (count == 0) {
+			return;
+		}
+		size_t chunkCount = std::min(count, size());
+		size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+		std::vector<std::future<void>> chunks;
+		for (size_t begin = 0; begin < count; begin += chunkSize) {
+			size_t end = std::min(count, begin + chunkSize);
+			chunks.push_back(submit([&body, begin, end]() {
+				for (size_t i = begin; i < end; i++) {
+					body(i);
+				}
+			}));
+		}
+		for (auto& chunk : chunks) {
+			chunk.get();
+		}
+	}
+
+	/**
+	 * @brief The number of worker threads in the pool.
+	 */
+	size_t size() const;
+
+	/**
+	 * @brief The process-wide pool shared by all importers.
+	 */
+	static ThreadPool& shared();
+};
@@ -7,16 +7,16 @@
     APIs: gl=4.1
     Profile: core
     Extensions:
-        
+        GL_ARB_texture_storage
     Loader: True
     Local files: False
     Omit khrplatform: False
     Reproducible: False
 
     Commandline:
-        --profile="core" --api="gl=4.1" --generator="c" --spec="gl" --extensions=""
+        --profile="core" --api="gl=4.1" --generator="c" --spec="gl" --extensions="GL_ARB_texture_storage"
     Online:
-        https://glad.dav1d.de/#profile=core&language=c&specification=gl&loader=on&api=gl%3D4.1
+        https://glad.dav1d.de/#profile=core&language=c&specification=gl&loader=on&api=gl%3D4.1&extensions=GL_ARB_texture_storage
 */
 
 #include <stdio.h>
@@ -777,6 +777,10 @@ PFNGLVIEWPORTARRAYVPROC glad_glViewportArrayv = NULL;
 PFNGLVIEWPORTINDEXEDFPROC glad_glViewportIndexedf = NULL;
 PFNGLVIEWPORTINDEXEDFVPROC glad_glViewportIndexedfv = NULL;
 PFNGLWAITSYNCPROC glad_glWaitSync = NULL;
+int GLAD_GL_ARB_texture_storage = 0;
+PFNGLTEXSTORAGE1DPROC glad_glTexStorage1D = NULL;
+PFNGLTEXSTORAGE2DPROC glad_glTexStorage2D = NULL;
+PFNGLTEXSTORAGE3DPROC glad_glTexStorage3D = NULL;
 static void load_GL_VERSION_1_0(GLADloadproc load) {
 	if(!GLAD_GL_VERSION_1_0) return;
 	glad_glCullFace = (PFNGLCULLFACEPROC)load("glCullFace");
@@ -1331,9 +1335,15 @@ static void load_GL_VERSION_4_1(GLADloadproc load) {
 	glad_glGetFloati_v = (PFNGLGETFLOATI_VPROC)load("glGetFloati_v");
 	glad_glGetDoublei_v = (PFNGLGETDOUBLEI_VPROC)load("glGetDoublei_v");
 }
+static void load_GL_ARB_texture_storage(GLADloadproc load) {
+	if(!GLAD_GL_ARB_texture_storage) return;
+	glad_glTexStorage1D = (PFNGLTEXSTORAGE1DPROC)load("glTexStorage1D");
+	glad_glTexStorage2D = (PFNGLTEXSTORAGE2DPROC)load("glTexStorage2D");
+	glad_glTexStorage3D = (PFNGLTEXSTORAGE3DPROC)load("glTexStorage3D");
+}
 static int find_extensionsGL(void) {
 	if (!get_exts()) return 0;
-	(void)&has_ext;
+	GLAD_GL_ARB_texture_storage = has_ext("GL_ARB_texture_storage");
 	free_exts();
 	return 1;
 }
@@ -1416,6 +1426,7 @@ int gladLoadGLLoader(GLADloadproc load) {
 	load_GL_VERSION_4_1(load);
 
 	if (!find_extensionsGL()) return 0;
+	load_GL_ARB_texture_storage(load);
 	return GLVersion.major != 0 || GLVersion.minor != 0;
 }
 
@@ -7,8 +7,12 @@ This application renders a textured mesh that was loaded with Assimp.
 #include "Mesh3D.h"
 #include "ShaderProgram.h"
 #include "Scene.h"
+#include "ModelRegistry.h"
+#include "Benchmark.h"
+#include "AssetPack.h"
+#include <string>
 
-int main() {
+int main(int argc, char* argv[]) {
 	// Initialize the window and OpenGL.
 	sf::ContextSettings Settings;
 	Settings.depthBits = 24; // Request a 24 bits depth buffer
@@ -21,12 +25,29 @@ int main() {
 	gladLoadGL();
 	glEnable(GL_DEPTH_TEST);
 
+	// A models.pack built by the pack_models target replaces the loose files under models/.
+	AssetPack::mount("../models.pack", "../models");
+
+	// "--benchmark-gltf <model.gltf>" compares the glTF loaders and exits.
+	if (argc == 3 && std::string(argv[1]) == "--benchmark-gltf") {
+		benchmarkGltf(argv[2]);
+		ModelRegistry::clear();
+		return 0;
+	}
+
 	// Initialize scene objects.
-	auto scene = Scene::jeep();
+	// The scene's hierarchy is ready immediately; its meshes and textures stream in while it renders.
+	// "--scan <page file> [texture]" instead shows a scan paged by mesh_pager, streamed in by page.
+	bool scanning = argc >= 3 && std::string(argv[1]) == "--scan";
+	auto scene = !scanning ? Scene::jeep(LoadMode::Streaming)
+		: argc >= 4 ? Scene::scan(argv[2], argv[3]) : Scene::scan(argv[2]);
 
 	auto cameraPosition = glm::vec3(0, 0, 5);
 	auto camera = glm::lookAt(cameraPosition, glm::vec3(0, 0, -1), glm::vec3(0, 1, 0));
 	auto perspective = glm::perspective(glm::radians(45.0), static_cast<double>(window.getSize().x) / window.getSize().y, 0.1, 100.0);
+	// Meshes draw their coarsest level of detail that is off by no more than a pixel on screen, and
+	// skip the parts outside the frustum.
+	auto view = ViewContext::fromCamera(camera, perspective, static_cast<float>(window.getSize().y));
 
 	ShaderProgram& mainShader = scene.defaultShader;
 	mainShader.activate();
@@ -60,6 +81,12 @@ int main() {
 		for (auto& animator : scene.animators) {
 			animator.tick(diffSeconds);
 		}
+		if (scene.streamer != nullptr) {
+			scene.streamer->update(std::chrono::milliseconds(4));
+		}
+		for (auto& paged : scene.pagedMeshes) {
+			paged->update(view, std::chrono::milliseconds(4));
+		}
 
         counter += diff.asSeconds();
 
@@ -69,11 +96,16 @@ int main() {
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		// Render each object in the scene.
 		for (auto& o : scene.objects) {
-			o.render(window, mainShader);
+			o.render(window, mainShader, view);
+		}
+		for (auto& paged : scene.pagedMeshes) {
+			paged->render(window, mainShader, view);
 		}
 		window.display();
 	}
 
+	// Registered models own GPU resources, which must be freed while the OpenGL context still exists.
+	ModelRegistry::clear();
 	return 0;
 }
 
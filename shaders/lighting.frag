@@ -13,8 +13,12 @@ in vec3 RelativeCamera;
 
 // The mesh's base (diffuse) texture.
 uniform sampler2D baseTexture;
-uniform sampler2D specMap;
+// The mesh's material maps, packed when its textures load: the specular colour in RGB, and the
+// gloss (one minus roughness) in alpha.
+uniform sampler2D materialMap;
 uniform sampler2D normalMap;
+// True if normalMap holds only X and Y, as BC5 normal maps do; Z is rebuilt from them.
+uniform bool normalMapIsTwoChannel;
 
 // Material parameters for the whole mesh: k_a, k_d, k_s, shininess.
 uniform vec4 material;
@@ -45,7 +49,13 @@ vec3 newNormal;
 void main() {
     // TODO: using the lecture notes, compute ambientIntensity, diffuseIntensity, 
     // and specularIntensity.
-    vec3 sampledNormal = texture(normalMap, TexCoord).rgb;
+    vec4 normalSample = texture(normalMap, TexCoord);
+    vec3 sampledNormal = normalSample.rgb;
+    if (normalMapIsTwoChannel) {
+        vec2 xy = normalSample.rg * 2.0 - 1.0;
+        sampledNormal.b = sqrt(max(1.0 - dot(xy, xy), 0.0)) * 0.5 + 0.5;
+    }
+    vec4 materialSample = texture(materialMap, TexCoord);
 
     // Convert the sampled color from [0, 1] to [-1, 1].
     sampledNormal = sampledNormal * 2.0 - 1.0;
@@ -61,9 +71,11 @@ void main() {
 
     vec3 reflect_vector = reflect(directionalLight, normalize(newNormal));
     cosine = dot(normalize(reflect_vector), normalize(-RelativeCamera));
-    vec3 spec_factor = vec3(pow(max(cosine, 0), 1));
+    // Fully rough surfaces keep an exponent of 1; glossier ones tighten the highlight up to 128.
+    float shininess = exp2(materialSample.a * 7.0);
+    vec3 spec_factor = vec3(pow(max(cosine, 0), shininess));
 
-    vec3 specularIntensity = vec3(vec4(spec_factor,1) * texture(specMap, TexCoord) * (vec4(1)-texNormalFader));
+    vec3 specularIntensity = vec3(vec4(spec_factor,1) * vec4(materialSample.rgb, 1) * (vec4(1)-texNormalFader));
 
     vec3 lightIntensity = ambientIntensity * 0 + diffuseIntensity * 1 + specularIntensity * 1;
     FragColor = vec4(lightIntensity, 1)  * (texture(baseTexture, TexCoord) * texNormalFader + (vec4(1)-texNormalFader));
@@ -0,0 +1,61 @@
+/**
+Loads an OBJ model whose faces use relative (negative) indices, large enough to be parsed in several
+chunks, and checks that every triangle refers to the vertices written just before it.
+*/
+
+#include "ObjImport.h"
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+int main() {
+	// Each quad is four vertices at height q, then a face that refers back to them. About 6 MB of
+	// text, so chunk boundaries fall between vertices and the faces that use them.
+	const size_t QUADS = 60000;
+	auto path = std::filesystem::temp_directory_path() / "relative_indices.obj";
+	{
+		std::ofstream out(path);
+		out << "o quads\n";
+		for (size_t q = 0; q < QUADS; q++) {
+			out << "v 0 " << q << " 0\nv 1 " << q << " 0\nv 1 " << q << " 1\nv 0 " << q << " 1\n";
+			out << "vn 0 1 0\nf -4//-1 -3//-1 -2//-1 -1//-1\n";
+		}
+	}
+	if (std::filesystem::file_size(path) < 4 << 20) {
+		std::cerr << "The test model is too small to span several chunks" << std::endl;
+		return 1;
+	}
+
+	int failures = 0;
+	try {
+		ModelData model = objImport(path.string(), false);
+		size_t triangles = 0;
+		for (auto& mesh : model.meshes) {
+			for (size_t f = 0; f < mesh.baseFaceCount(); f += 3) {
+				float y = mesh.vertices[mesh.faces[f]].y;
+				for (int k = 1; k < 3; k++) {
+					if (mesh.vertices[mesh.faces[f + k]].y != y) {
+						failures++;
+					}
+				}
+				triangles++;
+			}
+		}
+		if (triangles != QUADS * 2) {
+			std::cerr << "Expected " << QUADS * 2 << " triangles, got " << triangles << std::endl;
+			failures++;
+		}
+		if (failures > 0) {
+			std::cerr << failures << " triangle corners refer to the wrong quad" << std::endl;
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		failures++;
+	}
+	std::filesystem::remove(path);
+	return failures == 0 ? 0 : 1;
+}